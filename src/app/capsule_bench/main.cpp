@@ -0,0 +1,363 @@
+/*
+ *  Capsule decoder benchmark
+ *  Checks the express and dense capsule decoding of the driver bit for bit against
+ *  a copy of the per-sample code it replaced, with each engine of the vectorized
+ *  decoder forced in turn. Every engine is also checked against the per-sample
+ *  decoder on express, dense and ultra shaped capsules and on odd sample counts
+ *  that exercise the tails, then timed.
+ *  The split of the nodes into separate arrays is checked and timed the same way.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkcommon.h"
+#include "hal/abs_rxtx.h"
+#include "hal/thread.h"
+#include "hal/locker.h"
+#include "hal/atomic.h"
+#include "hal/event.h"
+#include "rplidar_cartesian.h"
+#include "rplidar_scan_pool.h"
+#include "rplidar_node_ring.h"
+#include "rplidar_point_history.h"
+#include "rplidar_byte_ring.h"
+#include "rplidar_driver_impl.h"
+#include "rplidar_driver_serial.h"
+#include "rplidar_capsule_decode.h"
+
+#define CAPSULE_COUNT       4096
+#define RAW_CAPSULE_COUNT   8192
+#define ROUND_COUNT         100
+#define MAX_SAMPLES         96
+
+using namespace rp::standalone::rplidar;
+
+static const char * engines[] = { "scalar", "sse2", "avx2", "neon" };
+
+/* The capsule decoding of the driver before the vectorized decoder, kept as it was */
+class BaselineDecoder {
+public:
+    BaselineDecoder() : _is_previous_capsuledataRdy(false) {}
+
+    void     _capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
+    {
+        nodeCount = 0;
+        if (_is_previous_capsuledataRdy) {
+            int diffAngle_q8;
+            int currentStartAngle_q8 = ((capsule.start_angle_sync_q6 & 0x7FFF)<< 2);
+            int prevStartAngle_q8 = ((_cached_previous_capsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
+
+            diffAngle_q8 = (currentStartAngle_q8) - (prevStartAngle_q8);
+            if (prevStartAngle_q8 >  currentStartAngle_q8) {
+                diffAngle_q8 += (360<<8);
+            }
+
+            int angleInc_q16 = (diffAngle_q8 << 3);
+            int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
+            for (size_t pos = 0; pos < _countof(_cached_previous_capsuledata.cabins); ++pos)
+            {
+                int dist_q2[2];
+                int angle_q6[2];
+                int syncBit[2];
+
+                dist_q2[0] = (_cached_previous_capsuledata.cabins[pos].distance_angle_1 & 0xFFFC);
+                dist_q2[1] = (_cached_previous_capsuledata.cabins[pos].distance_angle_2 & 0xFFFC);
+
+                int angle_offset1_q3 = ( (_cached_previous_capsuledata.cabins[pos].offset_angles_q3 & 0xF) | ((_cached_previous_capsuledata.cabins[pos].distance_angle_1 & 0x3)<<4));
+                int angle_offset2_q3 = ( (_cached_previous_capsuledata.cabins[pos].offset_angles_q3 >> 4) | ((_cached_previous_capsuledata.cabins[pos].distance_angle_2 & 0x3)<<4));
+
+                angle_q6[0] = ((currentAngle_raw_q16 - (angle_offset1_q3<<13))>>10);
+                syncBit[0] =  (( (currentAngle_raw_q16 + angleInc_q16) % (360<<16)) < angleInc_q16 )?1:0;
+                currentAngle_raw_q16 += angleInc_q16;
+
+
+                angle_q6[1] = ((currentAngle_raw_q16 - (angle_offset2_q3<<13))>>10);
+                syncBit[1] =  (( (currentAngle_raw_q16 + angleInc_q16) % (360<<16)) < angleInc_q16 )?1:0;
+                currentAngle_raw_q16 += angleInc_q16;
+
+                for (int cpos = 0; cpos < 2; ++cpos) {
+
+                    if (angle_q6[cpos] < 0) angle_q6[cpos] += (360<<6);
+                    if (angle_q6[cpos] >= (360<<6)) angle_q6[cpos] -= (360<<6);
+
+                    rplidar_response_measurement_node_hq_t node;
+
+                    node.angle_z_q14 = _u16((angle_q6[cpos] << 8) / 90);
+                    node.flag = (syncBit[cpos] | ((!syncBit[cpos]) << 1));
+                    node.quality = dist_q2[cpos] ? (0x2f << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
+                    node.dist_mm_q2 = dist_q2[cpos];
+
+                    nodebuffer[nodeCount++] = node;
+                 }
+
+            }
+        }
+
+        _cached_previous_capsuledata = capsule;
+        _is_previous_capsuledataRdy = true;
+    }
+
+    void     _dense_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
+    {
+        const rplidar_response_dense_capsule_measurement_nodes_t *dense_capsule = reinterpret_cast<const rplidar_response_dense_capsule_measurement_nodes_t*>(&capsule);
+        nodeCount = 0;
+        if (_is_previous_capsuledataRdy) {
+            int diffAngle_q8;
+            int currentStartAngle_q8 = ((dense_capsule->start_angle_sync_q6 & 0x7FFF) << 2);
+            int prevStartAngle_q8 = ((_cached_previous_dense_capsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
+
+            diffAngle_q8 = (currentStartAngle_q8)-(prevStartAngle_q8);
+            if (prevStartAngle_q8 >  currentStartAngle_q8) {
+                diffAngle_q8 += (360 << 8);
+            }
+
+            int angleInc_q16 = (diffAngle_q8 << 8)/40;
+            int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
+            for (size_t pos = 0; pos < _countof(_cached_previous_dense_capsuledata.cabins); ++pos)
+            {
+                int dist_q2;
+                int angle_q6;
+                int syncBit;
+                const int dist = static_cast<const int>(_cached_previous_dense_capsuledata.cabins[pos].distance);
+                dist_q2 = dist << 2;
+                angle_q6 = (currentAngle_raw_q16 >> 10);
+                syncBit = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
+                currentAngle_raw_q16 += angleInc_q16;
+
+                if (angle_q6 < 0) angle_q6 += (360 << 6);
+                if (angle_q6 >= (360 << 6)) angle_q6 -= (360 << 6);
+
+                rplidar_response_measurement_node_hq_t node;
+
+                node.angle_z_q14 = _u16((angle_q6 << 8) / 90);
+                node.flag = (syncBit | ((!syncBit) << 1));
+                node.quality = dist_q2 ? (0x2f << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
+                node.dist_mm_q2 = dist_q2;
+
+                nodebuffer[nodeCount++] = node;
+            }
+        }
+
+        _cached_previous_dense_capsuledata = *dense_capsule;
+        _is_previous_capsuledataRdy = true;
+    }
+
+protected:
+    rplidar_response_capsule_measurement_nodes_t _cached_previous_capsuledata;
+    rplidar_response_dense_capsule_measurement_nodes_t _cached_previous_dense_capsuledata;
+    bool                                         _is_previous_capsuledataRdy;
+};
+
+/* Opens the capsule decoding of the driver, no device is ever connected */
+class CapsuleProbe : public RPlidarDriverSerial {
+public:
+    /* the driver clears it when a scan starts */
+    CapsuleProbe() { _is_previous_capsuledataRdy = false; }
+
+    using RPlidarDriverImplCommon::_capsuleToNormal;
+    using RPlidarDriverImplCommon::_dense_capsuleToNormal;
+};
+
+/* Random raw capsules, one out of 16 carries a start angle beyond 360 degree */
+static void build_raw_capsules(rplidar_response_capsule_measurement_nodes_t * capsules)
+{
+    for (int i = 0; i < RAW_CAPSULE_COUNT; ++i) {
+        _u8 * bytes = reinterpret_cast<_u8 *>(capsules + i);
+        for (size_t pos = 0; pos < sizeof(capsules[i]); ++pos) {
+            bytes[pos] = (_u8)rand();
+        }
+        int startAngle_q6 = (i % 16) ? rand() % (360 << 6) : rand() % 0x8000;
+        capsules[i].start_angle_sync_q6 = (_u16)(startAngle_q6 | ((rand() & 1) << 15));
+    }
+}
+
+typedef void (CapsuleProbe::*probe_func_t)(const rplidar_response_capsule_measurement_nodes_t &, rplidar_response_measurement_node_hq_t *, size_t &);
+typedef void (BaselineDecoder::*baseline_func_t)(const rplidar_response_capsule_measurement_nodes_t &, rplidar_response_measurement_node_hq_t *, size_t &);
+
+/* Feed the same capsule stream to the driver and to the baseline code */
+static bool check_driver(probe_func_t probeFunc, baseline_func_t baselineFunc, const rplidar_response_capsule_measurement_nodes_t * capsules, const char * name)
+{
+    CapsuleProbe probe;
+    BaselineDecoder baseline;
+    for (int i = 0; i < RAW_CAPSULE_COUNT; ++i) {
+        rplidar_response_measurement_node_hq_t expected[MAX_SAMPLES], actual[MAX_SAMPLES];
+        size_t expectedCount, actualCount;
+
+        (baseline.*baselineFunc)(capsules[i], expected, expectedCount);
+        (probe.*probeFunc)(capsules[i], actual, actualCount);
+        if (expectedCount != actualCount || memcmp(expected, actual, actualCount * sizeof(actual[0]))) {
+            fprintf(stderr, "Error, %s capsule %d decoded by the driver differently from the baseline with the %s engine.\n",
+                name, i, capsule_decoder::getEngineName());
+            return false;
+        }
+    }
+    return true;
+}
+
+struct TestCapsule {
+    int  startAngle_raw_q16;
+    int  angleInc_q16;
+    int  angleOffset_q16[MAX_SAMPLES];
+    _u32 dist_q2[MAX_SAMPLES];
+};
+
+/* Build capsules the way the driver does: express (32 samples), dense (40) or ultra (96 and other counts) */
+static void build_capsules(TestCapsule * capsules, size_t sampleCount)
+{
+    for (int i = 0; i < CAPSULE_COUNT; ++i) {
+        TestCapsule & capsule = capsules[i];
+        /* one capsule out of 16 carries a start angle beyond 360 degree */
+        int startAngle_q6 = (i % 16) ? rand() % (360 << 6) : rand() % 0x8000;
+        int diffAngle_q8 = rand() % (360 << 8);
+
+        capsule.startAngle_raw_q16 = (startAngle_q6 << 2) << 8;
+        switch (sampleCount) {
+        case 32: capsule.angleInc_q16 = (diffAngle_q8 << 3); break;
+        case 40: capsule.angleInc_q16 = (diffAngle_q8 << 8) / 40; break;
+        default: capsule.angleInc_q16 = (diffAngle_q8 << 3) / 3; break;
+        }
+
+        for (size_t pos = 0; pos < sampleCount; ++pos) {
+            switch (sampleCount) {
+            case 32: capsule.angleOffset_q16[pos] = (rand() & 0x3F) << 13; break;
+            case 40: capsule.angleOffset_q16[pos] = 0; break;
+            default: capsule.angleOffset_q16[pos] = (rand() % 1870000) - 1345190; break;
+            }
+            capsule.dist_q2[pos] = (rand() % 8) ? (_u32)rand() : 0;
+        }
+    }
+}
+
+typedef void (*decode_func_t)(int, int, const int *, const _u32 *, size_t, rplidar_response_measurement_node_hq_t *);
+
+static double bench(decode_func_t func, const TestCapsule * capsules, size_t sampleCount)
+{
+    rplidar_response_measurement_node_hq_t nodes[MAX_SAMPLES];
+    volatile _u32 sink = 0;
+    _u64 startTs = rp::arch::rp_getus();
+    for (int round = 0; round < ROUND_COUNT; ++round) {
+        for (int i = 0; i < CAPSULE_COUNT; ++i) {
+            const TestCapsule & capsule = capsules[i];
+            func(capsule.startAngle_raw_q16, capsule.angleInc_q16, capsule.angleOffset_q16, capsule.dist_q2, sampleCount, nodes);
+            sink ^= nodes[sampleCount - 1].angle_z_q14;
+        }
+    }
+    return (rp::arch::rp_getus() - startTs) * 1000.0 / (ROUND_COUNT * CAPSULE_COUNT);
+}
+
+typedef void (*unpack_func_t)(const rplidar_response_measurement_node_hq_t *, size_t, float *, float *, _u8 *, _u8 *);
+
+struct UnpackedNodes {
+    float angle_deg[MAX_SAMPLES];
+    float dist_mm[MAX_SAMPLES];
+    _u8   quality[MAX_SAMPLES];
+    _u8   flag[MAX_SAMPLES];
+};
+
+static double bench_unpack(unpack_func_t func, const rplidar_response_measurement_node_hq_t * nodes, size_t sampleCount)
+{
+    UnpackedNodes out;
+    volatile float sink = 0;
+    _u64 startTs = rp::arch::rp_getus();
+    for (int round = 0; round < ROUND_COUNT; ++round) {
+        for (int i = 0; i < CAPSULE_COUNT; ++i) {
+            func(nodes + i * sampleCount, sampleCount, out.angle_deg, out.dist_mm, out.quality, out.flag);
+            sink = sink + out.dist_mm[sampleCount - 1];
+        }
+    }
+    return (rp::arch::rp_getus() - startTs) * 1000.0 / (ROUND_COUNT * CAPSULE_COUNT);
+}
+
+int main(int argc, char** argv) {
+    static const size_t sampleCounts[] = { 32, 40, 96, 1, 7, 9, 15, 33 };
+    static const char * names[] = { "express", "dense", "ultra", "1", "7", "9", "15", "33" };
+    const char * defaultEngine = capsule_decoder::getEngineName();
+    TestCapsule * capsules = new TestCapsule[CAPSULE_COUNT];
+    rplidar_response_measurement_node_hq_t * decoded = new rplidar_response_measurement_node_hq_t[CAPSULE_COUNT * MAX_SAMPLES];
+    rplidar_response_capsule_measurement_nodes_t * rawCapsules = new rplidar_response_capsule_measurement_nodes_t[RAW_CAPSULE_COUNT];
+    int ans = 0;
+
+    srand(1);
+    printf("engine: %s\n", defaultEngine);
+    build_raw_capsules(rawCapsules);
+    for (size_t engine = 0; engine < _countof(engines); ++engine) {
+        if (!capsule_decoder::selectEngine(engines[engine])) continue;
+        if (!check_driver(&CapsuleProbe::_capsuleToNormal, &BaselineDecoder::_capsuleToNormal, rawCapsules, "express")
+            || !check_driver(&CapsuleProbe::_dense_capsuleToNormal, &BaselineDecoder::_dense_capsuleToNormal, rawCapsules, "dense")) {
+            ans = -1;
+            goto _final;
+        }
+        printf("%-8s driver matches the baseline on %d express and dense capsules\n", engines[engine], RAW_CAPSULE_COUNT);
+    }
+
+    for (size_t type = 0; type < _countof(sampleCounts); ++type) {
+        const size_t sampleCount = sampleCounts[type];
+        build_capsules(capsules, sampleCount);
+
+        for (size_t engine = 0; engine < _countof(engines); ++engine) {
+            if (!capsule_decoder::selectEngine(engines[engine])) continue;
+
+            for (int i = 0; i < CAPSULE_COUNT; ++i) {
+                const TestCapsule & capsule = capsules[i];
+                rplidar_response_measurement_node_hq_t expected[MAX_SAMPLES], actual[MAX_SAMPLES];
+
+                capsule_decoder::decodeScalar(capsule.startAngle_raw_q16, capsule.angleInc_q16, capsule.angleOffset_q16, capsule.dist_q2, sampleCount, expected);
+                capsule_decoder::decode(capsule.startAngle_raw_q16, capsule.angleInc_q16, capsule.angleOffset_q16, capsule.dist_q2, sampleCount, actual);
+                if (memcmp(expected, actual, sampleCount * sizeof(expected[0]))) {
+                    fprintf(stderr, "Error, %s capsule %d decoded differently by the %s engine.\n", names[type], i, engines[engine]);
+                    ans = -1;
+                    goto _final;
+                }
+            }
+        }
+
+        capsule_decoder::selectEngine(defaultEngine);
+        for (int i = 0; i < CAPSULE_COUNT; ++i) {
+            const TestCapsule & capsule = capsules[i];
+            rplidar_response_measurement_node_hq_t actual[MAX_SAMPLES];
+
+            capsule_decoder::decode(capsule.startAngle_raw_q16, capsule.angleInc_q16, capsule.angleOffset_q16, capsule.dist_q2, sampleCount, actual);
+
+            /* random quality and flag bytes, the decoders only produce a few values */
+            for (size_t pos = 0; pos < sampleCount; ++pos) {
+                actual[pos].quality = (_u8)rand();
+                actual[pos].flag = (_u8)rand();
+            }
+            memcpy(decoded + i * sampleCount, actual, sampleCount * sizeof(actual[0]));
+
+            /* every length, to cover the tails */
+            UnpackedNodes expectedSoA, actualSoA;
+            size_t unpackCount = 1 + i % sampleCount;
+            capsule_decoder::unpackScalar(actual, unpackCount, expectedSoA.angle_deg, expectedSoA.dist_mm, expectedSoA.quality, expectedSoA.flag);
+            capsule_decoder::unpack(actual, unpackCount, actualSoA.angle_deg, actualSoA.dist_mm, actualSoA.quality, actualSoA.flag);
+            if (memcmp(expectedSoA.angle_deg, actualSoA.angle_deg, unpackCount * sizeof(float))
+                || memcmp(expectedSoA.dist_mm, actualSoA.dist_mm, unpackCount * sizeof(float))
+                || memcmp(expectedSoA.quality, actualSoA.quality, unpackCount)
+                || memcmp(expectedSoA.flag, actualSoA.flag, unpackCount)) {
+                fprintf(stderr, "Error, %s capsule %d unpacked differently.\n", names[type], i);
+                ans = -1;
+                goto _final;
+            }
+        }
+
+        printf("%-8s", names[type]);
+        for (size_t engine = 0; engine < _countof(engines); ++engine) {
+            if (!capsule_decoder::selectEngine(engines[engine])) continue;
+            printf("%s %s %7.1f ns/capsule", engine ? "," : "", engines[engine], bench(capsule_decoder::decode, capsules, sampleCount));
+        }
+        printf("\n");
+        printf("%-8s unpack scalar %7.1f ns/capsule, unpack %7.1f ns/capsule\n", names[type],
+            bench_unpack(capsule_decoder::unpackScalar, decoded, sampleCount),
+            bench_unpack(capsule_decoder::unpack, decoded, sampleCount));
+    }
+
+_final:
+    capsule_decoder::selectEngine(defaultEngine);
+    delete [] rawCapsules;
+    delete [] decoded;
+    delete [] capsules;
+    return ans;
+}
@@ -0,0 +1,132 @@
+/*
+ *  Cartesian conversion benchmark
+ *  Checks the table based x/y conversion of the SDK against libm sin/cos on
+ *  revolutions of random nodes, with and without a mount transform, then times both
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sdkcommon.h"
+#include "rplidar_cartesian.h"
+
+#define NODE_COUNT          4096     /* a revolution of a fast scan mode */
+#define ROUND_COUNT         1000
+#define MAX_ERROR           1e-6f    /* relative to the distance, a few float roundings */
+
+using namespace rp::standalone::rplidar;
+
+typedef void (*convert_func_t)(const rplidar_response_measurement_node_hq_t *, size_t, const cartesian::Transform &, float *, float *);
+
+/* Reference: what every consumer used to do with the nodes */
+static void libm_convert(const rplidar_response_measurement_node_hq_t * nodes, size_t count, const cartesian::Transform & transform, float * x_mm, float * y_mm)
+{
+    for (size_t pos = 0; pos < count; ++pos) {
+        float angle_rad = nodes[pos].angle_z_q14 * 90.f / 16384.0f * (float)(M_PI / 180.0);
+        float dist_mm = nodes[pos].dist_mm_q2 / 4.0f;
+        float local_x = dist_mm * cosf(angle_rad);
+        float local_y = -dist_mm * sinf(angle_rad);
+        x_mm[pos] = transform.cos_yaw * local_x - transform.sin_yaw * local_y + transform.x_mm;
+        y_mm[pos] = transform.sin_yaw * local_x + transform.cos_yaw * local_y + transform.y_mm;
+    }
+}
+
+static double bench(convert_func_t func, const rplidar_response_measurement_node_hq_t * nodes, const cartesian::Transform & transform, float * x_mm, float * y_mm)
+{
+    volatile float sink = 0;
+    _u64 startTs = rp::arch::rp_getus();
+    for (int round = 0; round < ROUND_COUNT; ++round) {
+        func(nodes, NODE_COUNT, transform, x_mm, y_mm);
+        sink = sink + x_mm[NODE_COUNT - 1];
+    }
+    return (rp::arch::rp_getus() - startTs) * 1000.0 / ROUND_COUNT;
+}
+
+/* largest difference on x or y, relative to the distance */
+static float max_error(const rplidar_response_measurement_node_hq_t * nodes, size_t count, const float * expected_x, const float * expected_y, const float * actual_x, const float * actual_y)
+{
+    float error = 0;
+    for (size_t pos = 0; pos < count; ++pos) {
+        float dist_mm = nodes[pos].dist_mm_q2 / 4.0f;
+        float scale = dist_mm > 1.f ? dist_mm : 1.f;
+        float dx = fabsf(expected_x[pos] - actual_x[pos]) / scale;
+        float dy = fabsf(expected_y[pos] - actual_y[pos]) / scale;
+        if (dx > error) error = dx;
+        if (dy > error) error = dy;
+    }
+    return error;
+}
+
+int main(int argc, char** argv) {
+    rplidar_response_measurement_node_hq_t * nodes = new rplidar_response_measurement_node_hq_t[NODE_COUNT];
+    float * ref_x = new float[NODE_COUNT];
+    float * ref_y = new float[NODE_COUNT];
+    float * x = new float[NODE_COUNT];
+    float * y = new float[NODE_COUNT];
+    int ret = 0;
+
+    srand(1);
+    for (size_t pos = 0; pos < NODE_COUNT; ++pos) {
+        nodes[pos].angle_z_q14 = (_u16)rand();
+        /* up to 16m mostly, the whole range now and then */
+        nodes[pos].dist_mm_q2 = (pos % 64) ? (_u32)(rand() % (16000 * 4)) : ((_u32)rand() << 1);
+        nodes[pos].quality = (_u8)rand();
+        nodes[pos].flag = 0;
+    }
+
+    cartesian::Transform transforms[2];
+    static const char * names[] = { "sensor frame", "mounted" };
+    cartesian::makeIdentity(transforms[0]);
+    cartesian::makeTransform(120.f, -35.5f, 93.f, transforms[1]);
+
+    printf("engine: %s\n", cartesian::getEngineName());
+    for (int type = 0; type < 2; ++type) {
+        libm_convert(nodes, NODE_COUNT, transforms[type], ref_x, ref_y);
+        cartesian::convertScalar(nodes, NODE_COUNT, transforms[type], x, y);
+
+        /* the libm angle goes through degree and float radians, the table does not */
+        float table_error = max_error(nodes, NODE_COUNT, ref_x, ref_y, x, y);
+        if (table_error > MAX_ERROR) {
+            fprintf(stderr, "Error, %s: the table is off libm by %g of the distance.\n", names[type], table_error);
+            ret = -1;
+            break;
+        }
+
+        float * scalar_x = new float[NODE_COUNT];
+        float * scalar_y = new float[NODE_COUNT];
+        memcpy(scalar_x, x, NODE_COUNT * sizeof(float));
+        memcpy(scalar_y, y, NODE_COUNT * sizeof(float));
+        /* every length, to cover the tails */
+        for (size_t count = 1; count <= 64; ++count) {
+            cartesian::convert(nodes, count, transforms[type], x, y);
+            if (memcmp(scalar_x, x, count * sizeof(float)) || memcmp(scalar_y, y, count * sizeof(float))) {
+                /* only a compiler contracting the scalar code into FMAs can make them differ */
+                float error = max_error(nodes, count, scalar_x, scalar_y, x, y);
+                if (error > MAX_ERROR) {
+                    fprintf(stderr, "Error, %s: %s differs from the scalar code by %g of the distance.\n", names[type], cartesian::getEngineName(), error);
+                    ret = -1;
+                }
+            }
+        }
+        delete [] scalar_x;
+        delete [] scalar_y;
+        if (ret) break;
+
+        printf("%-12s max error %.2g of the distance\n", names[type], table_error);
+        printf("%-12s libm %8.1f ns/revolution, scalar %8.1f ns/revolution, %s %8.1f ns/revolution\n", names[type],
+            bench(libm_convert, nodes, transforms[type], ref_x, ref_y),
+            bench(cartesian::convertScalar, nodes, transforms[type], x, y),
+            cartesian::getEngineName(),
+            bench(cartesian::convert, nodes, transforms[type], x, y));
+    }
+
+    delete [] nodes;
+    delete [] ref_x;
+    delete [] ref_y;
+    delete [] x;
+    delete [] y;
+    return ret;
+}
@@ -25,6 +25,7 @@
 #define MAX_FAILURE_COUNT   0       // maximum consecutive scan failures allowed before restarting the lidar
 #define SORT_OUTPUT_DATA    1       // 1 => output data will be sorted by angle; 0 => output unsorted
 #define OUTPUT_BUFFER_SIZE  100
+#define RECOVERY_DELAY_MS   50      // before starting the scan again, stop() returns once the driver is idle
 
 /*
     Mode 0 (Standard) 3.96825 kHz
@@ -189,9 +190,8 @@ int main(int argc, char** argv) {
 		op_result = drv->startScanExpress(false, LIDAR_SCAN_MODE, 0, &scanmode);
 		if (IS_FAIL(op_result)) {
 			drv->stop();
-			drv->stopMotor();
 			fprintf(stderr, "Failed to start scan\n");
-			delay((unsigned long long)1000);
+			delay((unsigned long long)RECOVERY_DELAY_MS);
 			continue;
 		}
 		printf("Scan mode: %u (%s) at %g kHz\n", scanmode.id, scanmode.scan_mode,
@@ -241,9 +241,10 @@ int main(int argc, char** argv) {
 			fail_count = 0;
 		}
 		if (!ctrl_c_pressed) {
+			// the motor keeps spinning, the next round restarts the scan only
 			drv->stop();
-			drv->stopMotor();
 			fprintf(stderr, "Lidar disconnected\n");
+			delay((unsigned long long)RECOVERY_DELAY_MS);
 		}
 	}
 	printf("End of program\n");
@@ -0,0 +1,94 @@
+/*
+ *  CRC32 benchmark
+ *  Compares the CRC engines of the SDK against the original byte-wise
+ *  implementation on HQ capsule sized frames and checks they agree
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkcommon.h"
+#include "rplidar_crc32.h"
+
+#define FRAME_COUNT         1024
+#define ROUND_COUNT         200
+
+using namespace rp::standalone::rplidar;
+
+/* Reference: the byte-wise CRC32 the driver used to run */
+static _u32 ref_table[256];
+
+static void ref_init()
+{
+    for (_u32 i = 0; i < 256; i++) {
+        _u32 c = i;
+        for (int j = 0; j < 8; j++) {
+            c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+        }
+        ref_table[i] = c;
+    }
+}
+
+static _u32 ref_crc32(const _u8 * pch, _u16 len)
+{
+    _u32 crc = 0xFFFFFFFF;
+    _u8 leftBytes = (4 - len) & 0x3;
+
+    for (_u16 i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ ref_table[(crc ^ pch[i]) & 0xFF];
+    }
+    for (_u8 i = 0; i < leftBytes; i++) {
+        crc = (crc >> 8) ^ ref_table[crc & 0xFF];
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+typedef _u32 (*crc_func_t)(const _u8 *, size_t);
+
+static _u32 run_ref(const _u8 * data, size_t len)      { return ref_crc32(data, (_u16)len); }
+static _u32 run_sw(const _u8 * data, size_t len)       { return crc32::computeSoftware(data, len); }
+static _u32 run_default(const _u8 * data, size_t len)  { return crc32::compute(data, len); }
+
+static void bench(const char * name, crc_func_t func, const _u8 * frames, size_t frameSize)
+{
+    volatile _u32 sink = 0;
+    _u64 startTs = rp::arch::rp_getus();
+    for (int round = 0; round < ROUND_COUNT; ++round) {
+        for (int i = 0; i < FRAME_COUNT; ++i) {
+            sink ^= func(frames + i * frameSize, frameSize);
+        }
+    }
+    _u64 elapsed = rp::arch::rp_getus() - startTs;
+    printf("%-24s %8.1f ns/frame\n", name, elapsed * 1000.0 / (ROUND_COUNT * FRAME_COUNT));
+}
+
+int main(int argc, char** argv) {
+    const size_t frameSize = sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - sizeof(_u32);
+    _u8 * frames = new _u8[FRAME_COUNT * frameSize];
+
+    ref_init();
+    srand(1);
+    for (size_t i = 0; i < FRAME_COUNT * frameSize; ++i) {
+        frames[i] = (_u8)rand();
+    }
+
+    /* every length up to a frame, to cover all the padding and tail cases */
+    for (size_t len = 0; len <= frameSize; ++len) {
+        _u32 expected = ref_crc32(frames, (_u16)len);
+        if (crc32::computeSoftware(frames, len) != expected || crc32::compute(frames, len) != expected) {
+            fprintf(stderr, "Error, checksum mismatch for a %d byte input.\n", (int)len);
+            delete [] frames;
+            return -1;
+        }
+    }
+
+    printf("frame size: %d bytes, engine: %s\n", (int)frameSize, crc32::getEngineName());
+    bench("byte-wise (original)", run_ref, frames, frameSize);
+    bench("slicing-by-8", run_sw, frames, frameSize);
+    bench(crc32::getEngineName(), run_default, frames, frameSize);
+
+    delete [] frames;
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ *  Event wake-up latency benchmark (Linux)
+ *  Compares rp::hal::Event against the mutex and condition variable event it
+ *  replaced: the cost of waiting on an event already signalled, the way a
+ *  consumer finds a scan ready, and the delay between set() in a thread playing
+ *  the cache thread and the return of wait() in the consumer.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+
+#include "sdkcommon.h"
+#include "hal/atomic.h"
+#include "hal/event.h"
+
+#define SIGNALLED_ROUNDS    1000000
+#define WAKE_COUNT          2000
+#define WAKE_GAP_US         500
+
+/* Reference: the event as it used to be, with its deadline on the wall clock */
+class CondEvent
+{
+public:
+    enum { EVENT_OK = 1, EVENT_TIMEOUT = -1, EVENT_FAILED = 0 };
+
+    CondEvent() : _is_signalled(false)
+    {
+        pthread_mutex_init(&_cond_locker, NULL);
+        pthread_cond_init(&_cond_var, NULL);
+    }
+    ~CondEvent()
+    {
+        pthread_mutex_destroy(&_cond_locker);
+        pthread_cond_destroy(&_cond_var);
+    }
+
+    void set()
+    {
+        pthread_mutex_lock(&_cond_locker);
+        if (!_is_signalled) {
+            _is_signalled = true;
+            pthread_cond_signal(&_cond_var);
+        }
+        pthread_mutex_unlock(&_cond_locker);
+    }
+
+    unsigned long wait(unsigned long timeout)
+    {
+        unsigned long ans = EVENT_OK;
+        pthread_mutex_lock(&_cond_locker);
+        while (!_is_signalled) {
+            timespec wait_time;
+            timeval now;
+            gettimeofday(&now, NULL);
+            wait_time.tv_sec = timeout / 1000 + now.tv_sec;
+            wait_time.tv_nsec = (timeout % 1000) * 1000000ULL + now.tv_usec * 1000;
+            if (wait_time.tv_nsec >= 1000000000) {
+                ++wait_time.tv_sec;
+                wait_time.tv_nsec -= 1000000000;
+            }
+            if (pthread_cond_timedwait(&_cond_var, &_cond_locker, &wait_time)) {
+                ans = EVENT_TIMEOUT;
+                break;
+            }
+        }
+        if (ans == EVENT_OK) _is_signalled = false;
+        pthread_mutex_unlock(&_cond_locker);
+        return ans;
+    }
+
+protected:
+    pthread_cond_t  _cond_var;
+    pthread_mutex_t _cond_locker;
+    bool            _is_signalled;
+};
+
+template <class TEvent>
+static double bench_signalled(TEvent & event)
+{
+    _u64 startTs = rp::arch::rp_getus();
+    for (int round = 0; round < SIGNALLED_ROUNDS; ++round) {
+        event.set();
+        event.wait(1000);
+    }
+    return (rp::arch::rp_getus() - startTs) * 1000.0 / SIGNALLED_ROUNDS;
+}
+
+template <class TEvent>
+struct WakeTest {
+    TEvent               event;
+    volatile _u64        setTs;
+    volatile _u32        taken;
+};
+
+template <class TEvent>
+static void * setter_proc(void * param)
+{
+    WakeTest<TEvent> * test = reinterpret_cast<WakeTest<TEvent> *>(param);
+    for (int i = 0; i < WAKE_COUNT; ++i) {
+        usleep(WAKE_GAP_US);
+        test->setTs = rp::arch::rp_getus();
+        test->event.set();
+        while (!rp::hal::atomic_exchange(&test->taken, 0)) usleep(10);
+    }
+    return NULL;
+}
+
+template <class TEvent>
+static void bench_wake(const char * name)
+{
+    WakeTest<TEvent> test;
+    test.setTs = 0;
+    test.taken = 0;
+
+    pthread_t setter;
+    pthread_create(&setter, NULL, setter_proc<TEvent>, &test);
+
+    std::vector<_u64> latencies;
+    while ((int)latencies.size() < WAKE_COUNT) {
+        if (test.event.wait(1000) != TEvent::EVENT_OK) continue;
+        latencies.push_back(rp::arch::rp_getus() - test.setTs);
+        rp::hal::atomic_store(&test.taken, 1);
+    }
+    pthread_join(setter, NULL);
+
+    std::sort(latencies.begin(), latencies.end());
+    _u64 total = 0;
+    for (size_t pos = 0; pos < latencies.size(); ++pos) total += latencies[pos];
+    printf("%-16s wake-up after set (us): mean %.1f, p50 %d, p99 %d, max %d\n", name,
+        (double)total / latencies.size(),
+        (int)latencies[latencies.size() / 2], (int)latencies[latencies.size() * 99 / 100], (int)latencies.back());
+}
+
+int main(int argc, char** argv) {
+    CondEvent condEvent;
+    rp::hal::Event event;
+
+    printf("%-16s set and wait, signalled: %6.1f ns\n", "condvar (old)", bench_signalled(condEvent));
+    printf("%-16s set and wait, signalled: %6.1f ns\n", "rp::hal::Event", bench_signalled(event));
+
+    /* a wait on an event never set must come back on time */
+    _u64 startTs = rp::arch::rp_getus();
+    if (event.waitUntil(startTs + 2500) != (unsigned long)rp::hal::Event::EVENT_TIMEOUT) {
+        fprintf(stderr, "Error, a wait on an event never set did not time out.\n");
+        return -1;
+    }
+    _u64 elapsed = rp::arch::rp_getus() - startTs;
+    if (elapsed < 2500) {
+        fprintf(stderr, "Error, a 2500us wait returned after %dus.\n", (int)elapsed);
+        return -1;
+    }
+    printf("%-16s 2500us timeout returned after %d us\n", "rp::hal::Event", (int)elapsed);
+
+    bench_wake<CondEvent>("condvar (old)");
+    bench_wake<rp::hal::Event>("rp::hal::Event");
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ *  HQ capsule replayer (Linux)
+ *  Plays an RPLIDAR in HQ scan mode on a pseudo terminal: each capsule carries a
+ *  device timestamp known in advance and its index in the distance of its nodes.
+ *  Checks every node of the scans comes with the device timestamp of its own
+ *  capsule, and the host timestamp of the last node of each capsule with the time
+ *  the capsule was written.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "sdkcommon.h"
+#include "rplidar_crc32.h"
+
+#define BAUDRATE            256000
+#define CAPSULES_PER_REV    12
+#define CAPSULE_GAP_US      2000
+#define US_PER_SAMPLE       125     /* 16 samples a capsule */
+#define DEVICE_TS_BASE      1000000000ULL
+#define DEVICE_TS_STEP      2000
+#define MAX_CAPSULES        65536
+#define SCAN_COUNT          20
+
+using namespace rp::standalone::rplidar;
+
+static int           master_fd = -1;
+static volatile bool device_running = true;
+static _u64          sent_ts[MAX_CAPSULES];
+
+static void send_answer(_u8 type, _u32 answerSize, const void * payload, size_t size)
+{
+    _u8 answer[sizeof(rplidar_ans_header_t) + sizeof(rplidar_response_device_info_t)];
+    rplidar_ans_header_t * header = reinterpret_cast<rplidar_ans_header_t *>(answer);
+    header->syncByte1 = RPLIDAR_ANS_SYNC_BYTE1;
+    header->syncByte2 = RPLIDAR_ANS_SYNC_BYTE2;
+    header->size_q30_subtype = answerSize;
+    header->type = type;
+    memcpy(answer + sizeof(*header), payload, size);
+    if (write(master_fd, answer, sizeof(*header) + size) < 0) return;
+}
+
+static void build_capsule(_u32 index, rplidar_response_hq_capsule_measurement_nodes_t & capsule)
+{
+    const size_t nodeCount = sizeof(capsule.node_hq) / sizeof(capsule.node_hq[0]);
+    memset(&capsule, 0, sizeof(capsule));
+    capsule.sync_byte = RPLIDAR_RESP_MEASUREMENT_HQ_SYNC;
+    capsule.time_stamp = DEVICE_TS_BASE + (_u64)index * DEVICE_TS_STEP;
+    for (size_t pos = 0; pos < nodeCount; ++pos) {
+        size_t sample = (index % CAPSULES_PER_REV) * nodeCount + pos;
+        capsule.node_hq[pos].angle_z_q14 = (_u16)(sample * 65536 / (CAPSULES_PER_REV * nodeCount));
+        capsule.node_hq[pos].dist_mm_q2 = index;
+        capsule.node_hq[pos].quality = 47 << 2;
+    }
+    if (index % CAPSULES_PER_REV == 0) capsule.node_hq[0].flag = RPLIDAR_RESP_HQ_FLAG_SYNCBIT;
+    capsule.crc32 = crc32::compute(&capsule, sizeof(capsule) - sizeof(capsule.crc32));
+}
+
+/* the next command from the driver, false when none came in */
+static bool read_command(_u8 & cmd, _u8 * payload, size_t & size)
+{
+    _u8 byte;
+    size = 0;
+    while (read(master_fd, &byte, 1) == 1) {
+        if (byte != RPLIDAR_CMD_SYNC_BYTE) continue;
+        while (read(master_fd, &cmd, 1) != 1) usleep(10);
+        if (cmd & RPLIDAR_CMDFLAG_HAS_PAYLOAD) {
+            /* size, payload and checksum */
+            _u8 payloadSize;
+            while (read(master_fd, &payloadSize, 1) != 1) usleep(10);
+            for (int pos = 0; pos <= payloadSize; ++pos) {
+                while (read(master_fd, &byte, 1) != 1) usleep(10);
+                if (pos < payloadSize && pos < 64) payload[size++] = byte;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+static void answer_conf(const _u8 * payload, size_t size)
+{
+    _u32 type;
+    if (size < sizeof(type)) return;
+    memcpy(&type, payload, sizeof(type));
+
+    _u8 answer[sizeof(type) + sizeof(_u32)];
+    memcpy(answer, &type, sizeof(type));
+    if (type == RPLIDAR_CONF_SCAN_MODE_US_PER_SAMPLE) {
+        _u32 value = US_PER_SAMPLE << 8;
+        memcpy(answer + sizeof(type), &value, sizeof(value));
+        send_answer(RPLIDAR_ANS_TYPE_GET_LIDAR_CONF, sizeof(answer), answer, sizeof(answer));
+    } else if (type == RPLIDAR_CONF_SCAN_MODE_ANS_TYPE) {
+        answer[sizeof(type)] = RPLIDAR_ANS_TYPE_MEASUREMENT_HQ;
+        send_answer(RPLIDAR_ANS_TYPE_GET_LIDAR_CONF, sizeof(type) + 1, answer, sizeof(type) + 1);
+    }
+}
+
+static void * device_proc(void *)
+{
+    bool streaming = false;
+    _u32 capsule_index = 0;
+
+    while (device_running) {
+        pollfd pfd = { master_fd, POLLIN, 0 };
+        _u8 cmd;
+        _u8 payload[64];
+        size_t payloadSize;
+        if (poll(&pfd, 1, streaming ? 0 : 10) > 0 && read_command(cmd, payload, payloadSize)) {
+            switch (cmd) {
+            case RPLIDAR_CMD_GET_ACC_BOARD_FLAG: {
+                _u32 flag = 0;
+                send_answer(RPLIDAR_ANS_TYPE_ACC_BOARD_FLAG, sizeof(flag), &flag, sizeof(flag));
+                break;
+            }
+            case RPLIDAR_CMD_GET_DEVICE_INFO: {
+                /* firmware 1.24: scan modes described by the configuration commands */
+                rplidar_response_device_info_t info;
+                memset(&info, 0, sizeof(info));
+                info.model = 0x41;
+                info.firmware_version = (1 << 8) | 24;
+                info.hardware_version = 6;
+                send_answer(RPLIDAR_ANS_TYPE_DEVINFO, sizeof(info), &info, sizeof(info));
+                break;
+            }
+            case RPLIDAR_CMD_GET_LIDAR_CONF:
+                answer_conf(payload, payloadSize);
+                break;
+            case RPLIDAR_CMD_EXPRESS_SCAN:
+                send_answer(RPLIDAR_ANS_TYPE_MEASUREMENT_HQ,
+                    sizeof(rplidar_response_hq_capsule_measurement_nodes_t) | (RPLIDAR_ANS_PKTFLAG_LOOP << RPLIDAR_ANS_HEADER_SUBTYPE_SHIFT), NULL, 0);
+                streaming = true;
+                capsule_index = 0;
+                break;
+            case RPLIDAR_CMD_STOP:
+                streaming = false;
+                break;
+            }
+            continue;
+        }
+
+        if (!streaming || capsule_index == MAX_CAPSULES) continue;
+        rplidar_response_hq_capsule_measurement_nodes_t capsule;
+        build_capsule(capsule_index, capsule);
+        sent_ts[capsule_index++] = rp::arch::rp_getus();
+        if (write(master_fd, &capsule, sizeof(capsule)) < 0) break;
+        usleep(CAPSULE_GAP_US);
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd == -1 || grantpt(master_fd) || unlockpt(master_fd)) {
+        fprintf(stderr, "Error, cannot create a pseudo terminal.\n");
+        return -1;
+    }
+    struct termios raw;
+    tcgetattr(master_fd, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(master_fd, TCSANOW, &raw);
+    fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+
+    pthread_t deviceThread;
+    pthread_create(&deviceThread, NULL, device_proc, NULL);
+
+    int ret = 0;
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    if (IS_FAIL(drv->connect(ptsname(master_fd), BAUDRATE, RPlidarDriver::CONNECT_FLAG_READER_THREAD))
+        || IS_FAIL(drv->startScanExpress(false, RPLIDAR_CONF_SCAN_COMMAND_HQ))) {
+        fprintf(stderr, "Error, cannot start the HQ scan.\n");
+        ret = -1;
+    }
+
+    static RplidarTimestampedNode nodes[8192];
+    int wrongDevice = 0, capsules = 0;
+    _s64 offsetSum = 0;
+    for (int scan = 0; scan < SCAN_COUNT && !ret; ++scan) {
+        size_t count = sizeof(nodes) / sizeof(nodes[0]);
+        if (IS_FAIL(drv->grabScanDataTimestamped(nodes, count))) {
+            fprintf(stderr, "Error, no scan.\n");
+            ret = -1;
+            break;
+        }
+
+        for (size_t pos = 0; pos < count; ++pos) {
+            _u32 index = nodes[pos].node.dist_mm_q2;
+            if (index >= MAX_CAPSULES || nodes[pos].device_timestamp != DEVICE_TS_BASE + (_u64)index * DEVICE_TS_STEP) ++wrongDevice;
+            /* the last sample of a capsule is taken right before the capsule is sent */
+            if (index < MAX_CAPSULES && (pos + 1 == count || nodes[pos + 1].node.dist_mm_q2 != index)) {
+                offsetSum += (_s64)(nodes[pos].host_timestamp_us - sent_ts[index]);
+                ++capsules;
+            }
+        }
+    }
+    drv->stop();
+
+    if (!ret) {
+        int meanOffset = capsules ? (int)(offsetSum / capsules) : 0;
+        printf("%d scans, %d capsules, %d nodes with another device timestamp, last sample of a capsule %dus after it was written\n",
+            SCAN_COUNT, capsules, wrongDevice, meanOffset);
+        /* a capsule late, the host timestamps end one CAPSULE_GAP_US early */
+        if (wrongDevice || !capsules || meanOffset < 0 || meanOffset > CAPSULE_GAP_US / 2) {
+            fprintf(stderr, "Error, the nodes do not carry the timestamps of their capsule.\n");
+            ret = -1;
+        }
+    }
+
+    drv->disconnect();
+    RPlidarDriver::DisposeDriver(drv);
+    device_running = false;
+    pthread_join(deviceThread, NULL);
+    close(master_fd);
+    return ret;
+}
@@ -0,0 +1,239 @@
+/*
+ *  Cache thread jitter benchmark (Linux)
+ *  Plays an express scan capable RPLIDAR on a pseudo terminal read by the reader
+ *  thread of the driver, loads every core with busy threads standing for a vision
+ *  workload, and reports how late the cache thread decodes the capsules, first
+ *  with the default scheduling, then with a SCHED_FIFO profile pinned to the last
+ *  core. Run it as root (or with CAP_SYS_NICE and CAP_IPC_LOCK) for the profile
+ *  to be applied.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "sdkcommon.h"
+
+#define BAUDRATE            256000
+#define CAPSULES_PER_REV    12      /* 30 degree a capsule */
+#define CAPSULE_GAP_US      1000
+#define RUN_TIME_US         3000000
+#define RT_PRIORITY         80
+#define STACK_PREFAULT_SIZE (64 * 1024)
+
+using namespace rp::standalone::rplidar;
+
+static int           master_fd = -1;
+static volatile bool device_running = true;
+static volatile bool load_running = true;
+
+static void send_answer(_u8 type, _u32 answerSize, const void * payload, size_t size)
+{
+    _u8 answer[sizeof(rplidar_ans_header_t) + sizeof(rplidar_response_device_info_t)];
+    rplidar_ans_header_t * header = reinterpret_cast<rplidar_ans_header_t *>(answer);
+    header->syncByte1 = RPLIDAR_ANS_SYNC_BYTE1;
+    header->syncByte2 = RPLIDAR_ANS_SYNC_BYTE2;
+    header->size_q30_subtype = answerSize;
+    header->type = type;
+    memcpy(answer + sizeof(*header), payload, size);
+    if (write(master_fd, answer, sizeof(*header) + size) < 0) return;
+}
+
+/* capsule index of the stream, the start angle goes round every CAPSULES_PER_REV */
+static void build_capsule(_u32 index, rplidar_response_capsule_measurement_nodes_t & capsule)
+{
+    const size_t cabinCount = sizeof(capsule.cabins) / sizeof(capsule.cabins[0]);
+    memset(&capsule, 0, sizeof(capsule));
+    capsule.start_angle_sync_q6 = (_u16)((index % CAPSULES_PER_REV) * (360 / CAPSULES_PER_REV) * 64);
+    if (!index) capsule.start_angle_sync_q6 |= RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT;
+    for (size_t pos = 0; pos < cabinCount; ++pos) {
+        capsule.cabins[pos].distance_angle_1 = (_u16)((1000 + pos) << 2);
+        capsule.cabins[pos].distance_angle_2 = (_u16)((2000 + pos) << 2);
+    }
+
+    const _u8 * bytes = reinterpret_cast<const _u8 *>(&capsule);
+    _u8 checksum = 0;
+    for (size_t pos = offsetof(rplidar_response_capsule_measurement_nodes_t, start_angle_sync_q6); pos < sizeof(capsule); ++pos) {
+        checksum ^= bytes[pos];
+    }
+    capsule.s_checksum_1 = (RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 << 4) | (checksum & 0xF);
+    capsule.s_checksum_2 = (RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2 << 4) | (checksum >> 4);
+}
+
+/* the next command from the driver, false when none came in */
+static bool read_command(_u8 & cmd)
+{
+    _u8 byte;
+    while (read(master_fd, &byte, 1) == 1) {
+        if (byte != RPLIDAR_CMD_SYNC_BYTE) continue;
+        while (read(master_fd, &cmd, 1) != 1) usleep(10);
+        if (cmd & RPLIDAR_CMDFLAG_HAS_PAYLOAD) {
+            /* size, payload and checksum */
+            _u8 size;
+            while (read(master_fd, &size, 1) != 1) usleep(10);
+            for (int pos = 0; pos <= size; ++pos) {
+                while (read(master_fd, &byte, 1) != 1) usleep(10);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+static void * device_proc(void *)
+{
+    bool streaming = false;
+    _u32 capsule_index = 0;
+
+    while (device_running) {
+        pollfd pfd = { master_fd, POLLIN, 0 };
+        _u8 cmd;
+        if (poll(&pfd, 1, streaming ? 0 : 10) > 0 && read_command(cmd)) {
+            switch (cmd) {
+            case RPLIDAR_CMD_GET_ACC_BOARD_FLAG: {
+                _u32 flag = 0;
+                send_answer(RPLIDAR_ANS_TYPE_ACC_BOARD_FLAG, sizeof(flag), &flag, sizeof(flag));
+                break;
+            }
+            case RPLIDAR_CMD_GET_DEVICE_INFO: {
+                /* firmware 1.20: express scan, no scan mode configuration */
+                rplidar_response_device_info_t info;
+                memset(&info, 0, sizeof(info));
+                info.model = 0x18;
+                info.firmware_version = (1 << 8) | 20;
+                info.hardware_version = 5;
+                send_answer(RPLIDAR_ANS_TYPE_DEVINFO, sizeof(info), &info, sizeof(info));
+                break;
+            }
+            case RPLIDAR_CMD_GET_DEVICE_HEALTH: {
+                rplidar_response_device_health_t health;
+                memset(&health, 0, sizeof(health));
+                send_answer(RPLIDAR_ANS_TYPE_DEVHEALTH, sizeof(health), &health, sizeof(health));
+                break;
+            }
+            case RPLIDAR_CMD_EXPRESS_SCAN:
+                send_answer(RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED,
+                    sizeof(rplidar_response_capsule_measurement_nodes_t) | (RPLIDAR_ANS_PKTFLAG_LOOP << RPLIDAR_ANS_HEADER_SUBTYPE_SHIFT), NULL, 0);
+                streaming = true;
+                capsule_index = 0;
+                break;
+            case RPLIDAR_CMD_STOP:
+                streaming = false;
+                break;
+            }
+            continue;
+        }
+
+        if (!streaming) continue;
+        rplidar_response_capsule_measurement_nodes_t capsule;
+        build_capsule(capsule_index++, capsule);
+        if (write(master_fd, &capsule, sizeof(capsule)) < 0) break;
+        usleep(CAPSULE_GAP_US);
+    }
+    return NULL;
+}
+
+static void * load_proc(void *)
+{
+    volatile _u32 sink = 0;
+    while (load_running) ++sink;
+    return NULL;
+}
+
+/* one scan under load, false if it could not be run */
+static bool run_scan(RPlidarDriver * drv, const char * name)
+{
+    if (IS_FAIL(drv->startScanExpress(false, RPLIDAR_CONF_SCAN_COMMAND_EXPRESS))) {
+        fprintf(stderr, "Error, cannot start the scan.\n");
+        return false;
+    }
+
+    rplidar_response_measurement_node_hq_t nodes[8192];
+    int scanCount = 0;
+    _u64 startTs = rp::arch::rp_getus();
+    while (rp::arch::rp_getus() - startTs < RUN_TIME_US) {
+        size_t count = sizeof(nodes) / sizeof(nodes[0]);
+        if (IS_OK(drv->grabScanDataHq(nodes, count))) ++scanCount;
+    }
+
+    RplidarRealtimeStats stats;
+    drv->getRealtimeStats(stats);
+    drv->stop();
+
+    printf("%-10s applied:%s%s%s%s\n", name,
+        (stats.applied & RPlidarDriver::RT_PROFILE_SCHED) ? " sched" : "",
+        (stats.applied & RPlidarDriver::RT_PROFILE_AFFINITY) ? " affinity" : "",
+        (stats.applied & RPlidarDriver::RT_PROFILE_MEMLOCK) ? " memlock" : "",
+        (stats.applied & RPlidarDriver::RT_PROFILE_STACK) ? " stack" : "");
+    printf("%-10s %d scans, %d capsules, latency from the last byte (us): min %d, mean %d, max %d, %d over 100us, %d over 1ms\n", name,
+        scanCount, (int)stats.frame_count, (int)stats.min_latency_us, (int)stats.mean_latency_us, (int)stats.max_latency_us,
+        (int)stats.over_100us_count, (int)stats.over_1ms_count);
+    return stats.frame_count != 0;
+}
+
+int main(int argc, char** argv) {
+    master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd == -1 || grantpt(master_fd) || unlockpt(master_fd)) {
+        fprintf(stderr, "Error, cannot create a pseudo terminal.\n");
+        return -1;
+    }
+    struct termios raw;
+    tcgetattr(master_fd, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(master_fd, TCSANOW, &raw);
+    fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+
+    pthread_t deviceThread;
+    pthread_create(&deviceThread, NULL, device_proc, NULL);
+
+    int ret = 0;
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    if (IS_FAIL(drv->connect(ptsname(master_fd), BAUDRATE, RPlidarDriver::CONNECT_FLAG_READER_THREAD))) {
+        fprintf(stderr, "Error, cannot open %s.\n", ptsname(master_fd));
+        ret = -1;
+    }
+
+    /* a priority out of the range of the policy is refused up front */
+    RplidarRealtimeProfile profile;
+    memset(&profile, 0, sizeof(profile));
+    profile.sched_policy = RPlidarDriver::RT_SCHED_FIFO;
+    profile.sched_priority = 0;
+    profile.cpu_core = -1;
+    if (!ret && drv->setRealtimeProfile(profile) != RESULT_INVALID_DATA) {
+        fprintf(stderr, "Error, SCHED_FIFO priority 0 was accepted.\n");
+        ret = -1;
+    }
+
+    int coreCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_t * loadThreads = new pthread_t[coreCount];
+    for (int core = 0; core < coreCount; ++core) pthread_create(&loadThreads[core], NULL, load_proc, NULL);
+    printf("%d busy threads\n", coreCount);
+
+    if (!ret && !run_scan(drv, "default")) ret = -1;
+
+    profile.sched_priority = RT_PRIORITY;
+    profile.cpu_core = coreCount - 1;
+    profile.lock_memory = true;
+    profile.prefault_stack_size = STACK_PREFAULT_SIZE;
+    if (!ret && IS_FAIL(drv->setRealtimeProfile(profile))) {
+        fprintf(stderr, "Error, the SCHED_FIFO profile was refused.\n");
+        ret = -1;
+    }
+    if (!ret && !run_scan(drv, "SCHED_FIFO")) ret = -1;
+
+    load_running = false;
+    for (int core = 0; core < coreCount; ++core) pthread_join(loadThreads[core], NULL);
+    delete [] loadThreads;
+
+    drv->disconnect();
+    RPlidarDriver::DisposeDriver(drv);
+    device_running = false;
+    pthread_join(deviceThread, NULL);
+    close(master_fd);
+    return ret;
+}
@@ -0,0 +1,102 @@
+/*
+ *  Serial wake-up latency benchmark (Linux)
+ *  Feeds HQ capsule sized frames through a pseudo terminal, in a few chunks like
+ *  a USB serial adapter does, and measures how long after the last byte of a
+ *  frame was written waitfordata() returns for that frame
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+
+#include "sdkcommon.h"
+#include "hal/abs_rxtx.h"
+
+#define FRAME_SIZE          132     /* an HQ capsule */
+#define CHUNK_COUNT         4
+#define CHUNK_GAP_US        250
+#define FRAME_GAP_US        2000
+#define FRAME_COUNT         1000
+#define BAUDRATE            256000
+
+static int           master_fd = -1;
+static volatile _u64 last_byte_ts = 0;
+static volatile bool frame_taken = false;
+
+static void * writer_proc(void *)
+{
+    _u8 frame[FRAME_SIZE];
+    for (size_t pos = 0; pos < sizeof(frame); ++pos) frame[pos] = (_u8)pos;
+
+    for (int i = 0; i < FRAME_COUNT; ++i) {
+        frame_taken = false;
+        for (int chunk = 0; chunk < CHUNK_COUNT; ++chunk) {
+            size_t begin = chunk * FRAME_SIZE / CHUNK_COUNT;
+            size_t end = (chunk + 1) * FRAME_SIZE / CHUNK_COUNT;
+            if (chunk) usleep(CHUNK_GAP_US);
+            if (chunk == CHUNK_COUNT - 1) last_byte_ts = rp::arch::rp_getus();
+            if (write(master_fd, frame + begin, end - begin) != (ssize_t)(end - begin)) return NULL;
+        }
+        while (!frame_taken) usleep(100);
+        usleep(FRAME_GAP_US);
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd == -1 || grantpt(master_fd) || unlockpt(master_fd)) {
+        fprintf(stderr, "Error, cannot create a pseudo terminal.\n");
+        return -1;
+    }
+    struct termios raw;
+    tcgetattr(master_fd, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(master_fd, TCSANOW, &raw);
+
+    rp::hal::serial_rxtx * serial = rp::hal::serial_rxtx::CreateRxTx();
+    if (!serial->bind(ptsname(master_fd), BAUDRATE) || !serial->open()) {
+        fprintf(stderr, "Error, cannot open %s.\n", ptsname(master_fd));
+        return -1;
+    }
+
+    pthread_t writer;
+    pthread_create(&writer, NULL, writer_proc, NULL);
+
+    std::vector<_u64> latencies;
+    _u8 frame[FRAME_SIZE];
+    while ((int)latencies.size() < FRAME_COUNT) {
+        size_t available = 0;
+        int ans = serial->waitfordata(FRAME_SIZE, 1000, &available);
+        _u64 wakeTs = rp::arch::rp_getus();
+        if (ans == rp::hal::serial_rxtx::ANS_TIMEOUT) continue;
+        if (ans != rp::hal::serial_rxtx::ANS_OK) {
+            fprintf(stderr, "Error, waitfordata failed.\n");
+            return -1;
+        }
+        latencies.push_back(wakeTs - last_byte_ts);
+        for (size_t received = 0; received < FRAME_SIZE; ) {
+            received += serial->recvdata(frame + received, FRAME_SIZE - received);
+        }
+        frame_taken = true;
+    }
+    pthread_join(writer, NULL);
+
+    std::sort(latencies.begin(), latencies.end());
+    _u64 total = 0;
+    for (size_t pos = 0; pos < latencies.size(); ++pos) total += latencies[pos];
+    printf("%d frames of %d bytes in %d chunks, latency from the last byte (us): mean %.1f, p50 %d, p99 %d, max %d\n",
+        FRAME_COUNT, FRAME_SIZE, CHUNK_COUNT, (double)total / latencies.size(),
+        (int)latencies[latencies.size() / 2], (int)latencies[latencies.size() * 99 / 100], (int)latencies.back());
+
+    serial->close();
+    rp::hal::serial_rxtx::ReleaseRxTx(serial);
+    close(master_fd);
+    return 0;
+}
@@ -0,0 +1,226 @@
+/*
+ *  Stop and restart benchmark (Linux)
+ *  Plays an express scan capable RPLIDAR on a pseudo terminal that goes quiet in
+ *  the middle of each scan, so that the cache thread sits in its wait when stop()
+ *  is called, then measures how long stop(), startScanExpress() and the first
+ *  scan after it take, with and without the reader thread of the driver.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <poll.h>
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+
+#include "sdkcommon.h"
+
+#define BAUDRATE            256000
+#define CAPSULES_PER_REV    12      /* 30 degree a capsule */
+#define CAPSULE_GAP_US      1000
+#define QUIET_US            20000   /* of the device before stop(), the cache thread waits for data */
+#define CYCLE_COUNT         50
+#define STOP_BUDGET_US      100000  /* a stop() over this waited for a timeout */
+
+using namespace rp::standalone::rplidar;
+
+static int           master_fd = -1;
+static volatile bool device_running = true;
+static volatile bool device_quiet = false;
+
+static void send_answer(_u8 type, _u32 answerSize, const void * payload, size_t size)
+{
+    _u8 answer[sizeof(rplidar_ans_header_t) + sizeof(rplidar_response_device_info_t)];
+    rplidar_ans_header_t * header = reinterpret_cast<rplidar_ans_header_t *>(answer);
+    header->syncByte1 = RPLIDAR_ANS_SYNC_BYTE1;
+    header->syncByte2 = RPLIDAR_ANS_SYNC_BYTE2;
+    header->size_q30_subtype = answerSize;
+    header->type = type;
+    memcpy(answer + sizeof(*header), payload, size);
+    if (write(master_fd, answer, sizeof(*header) + size) < 0) return;
+}
+
+/* capsule index of the stream, the start angle goes round every CAPSULES_PER_REV */
+static void build_capsule(_u32 index, rplidar_response_capsule_measurement_nodes_t & capsule)
+{
+    const size_t cabinCount = sizeof(capsule.cabins) / sizeof(capsule.cabins[0]);
+    memset(&capsule, 0, sizeof(capsule));
+    capsule.start_angle_sync_q6 = (_u16)((index % CAPSULES_PER_REV) * (360 / CAPSULES_PER_REV) * 64);
+    if (!index) capsule.start_angle_sync_q6 |= RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT;
+    for (size_t pos = 0; pos < cabinCount; ++pos) {
+        capsule.cabins[pos].distance_angle_1 = (_u16)((1000 + pos) << 2);
+        capsule.cabins[pos].distance_angle_2 = (_u16)((2000 + pos) << 2);
+    }
+
+    const _u8 * bytes = reinterpret_cast<const _u8 *>(&capsule);
+    _u8 checksum = 0;
+    for (size_t pos = offsetof(rplidar_response_capsule_measurement_nodes_t, start_angle_sync_q6); pos < sizeof(capsule); ++pos) {
+        checksum ^= bytes[pos];
+    }
+    capsule.s_checksum_1 = (RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 << 4) | (checksum & 0xF);
+    capsule.s_checksum_2 = (RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2 << 4) | (checksum >> 4);
+}
+
+/* the next command from the driver, false when none came in */
+static bool read_command(_u8 & cmd)
+{
+    _u8 byte;
+    while (read(master_fd, &byte, 1) == 1) {
+        if (byte != RPLIDAR_CMD_SYNC_BYTE) continue;
+        while (read(master_fd, &cmd, 1) != 1) usleep(10);
+        if (cmd & RPLIDAR_CMDFLAG_HAS_PAYLOAD) {
+            /* size, payload and checksum */
+            _u8 size;
+            while (read(master_fd, &size, 1) != 1) usleep(10);
+            for (int pos = 0; pos <= size; ++pos) {
+                while (read(master_fd, &byte, 1) != 1) usleep(10);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+static void * device_proc(void *)
+{
+    bool streaming = false;
+    _u32 capsule_index = 0;
+
+    while (device_running) {
+        pollfd pfd = { master_fd, POLLIN, 0 };
+        _u8 cmd;
+        if (poll(&pfd, 1, streaming && !device_quiet ? 0 : 1) > 0 && read_command(cmd)) {
+            switch (cmd) {
+            case RPLIDAR_CMD_GET_ACC_BOARD_FLAG: {
+                _u32 flag = 0;
+                send_answer(RPLIDAR_ANS_TYPE_ACC_BOARD_FLAG, sizeof(flag), &flag, sizeof(flag));
+                break;
+            }
+            case RPLIDAR_CMD_GET_DEVICE_INFO: {
+                /* firmware 1.20: express scan, no scan mode configuration */
+                rplidar_response_device_info_t info;
+                memset(&info, 0, sizeof(info));
+                info.model = 0x18;
+                info.firmware_version = (1 << 8) | 20;
+                info.hardware_version = 5;
+                send_answer(RPLIDAR_ANS_TYPE_DEVINFO, sizeof(info), &info, sizeof(info));
+                break;
+            }
+            case RPLIDAR_CMD_EXPRESS_SCAN:
+                send_answer(RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED,
+                    sizeof(rplidar_response_capsule_measurement_nodes_t) | (RPLIDAR_ANS_PKTFLAG_LOOP << RPLIDAR_ANS_HEADER_SUBTYPE_SHIFT), NULL, 0);
+                streaming = true;
+                device_quiet = false;
+                capsule_index = 0;
+                break;
+            case RPLIDAR_CMD_STOP:
+                streaming = false;
+                break;
+            }
+            continue;
+        }
+
+        if (!streaming || device_quiet) continue;
+        rplidar_response_capsule_measurement_nodes_t capsule;
+        build_capsule(capsule_index++, capsule);
+        if (write(master_fd, &capsule, sizeof(capsule)) < 0) break;
+        usleep(CAPSULE_GAP_US);
+    }
+    return NULL;
+}
+
+static void print_times(const char * name, std::vector<_u64> & times)
+{
+    std::sort(times.begin(), times.end());
+    _u64 total = 0;
+    for (size_t pos = 0; pos < times.size(); ++pos) total += times[pos];
+    printf("  %-18s (us): mean %d, p50 %d, max %d\n", name,
+        (int)(total / times.size()), (int)times[times.size() / 2], (int)times.back());
+}
+
+/* CYCLE_COUNT stops and restarts, false if one failed or a stop() ran into a timeout */
+static bool run_cycles(const char * name, _u32 flag)
+{
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    if (IS_FAIL(drv->connect(ptsname(master_fd), BAUDRATE, flag))) {
+        fprintf(stderr, "Error, cannot open %s.\n", ptsname(master_fd));
+        RPlidarDriver::DisposeDriver(drv);
+        return false;
+    }
+
+    bool ok = true;
+    std::vector<_u64> stopTimes, startTimes, scanTimes;
+    rplidar_response_measurement_node_hq_t nodes[8192];
+    for (int cycle = 0; cycle < CYCLE_COUNT && ok; ++cycle) {
+        if (cycle) {
+            device_quiet = true;
+            usleep(QUIET_US);
+        }
+
+        _u64 startTs = rp::arch::rp_getus();
+        drv->stop();
+        _u64 stopTs = rp::arch::rp_getus();
+        if (IS_FAIL(drv->startScanExpress(false, RPLIDAR_CONF_SCAN_COMMAND_EXPRESS))) {
+            fprintf(stderr, "Error, cannot restart the scan.\n");
+            ok = false;
+            break;
+        }
+        _u64 restartTs = rp::arch::rp_getus();
+        size_t count = sizeof(nodes) / sizeof(nodes[0]);
+        if (IS_FAIL(drv->grabScanDataHq(nodes, count))) {
+            fprintf(stderr, "Error, no scan after the restart.\n");
+            ok = false;
+            break;
+        }
+        _u64 scanTs = rp::arch::rp_getus();
+
+        /* the first cycle stops a driver not scanning yet */
+        if (!cycle) continue;
+        stopTimes.push_back(stopTs - startTs);
+        startTimes.push_back(restartTs - stopTs);
+        scanTimes.push_back(scanTs - startTs);
+    }
+    drv->stop();
+    drv->disconnect();
+    RPlidarDriver::DisposeDriver(drv);
+    if (!ok) return false;
+
+    printf("%s, %d cycles:\n", name, CYCLE_COUNT - 1);
+    print_times("stop()", stopTimes);
+    print_times("startScanExpress()", startTimes);
+    print_times("stop to scan", scanTimes);
+    if (stopTimes.back() > STOP_BUDGET_US) {
+        fprintf(stderr, "Error, stop() took %dus.\n", (int)stopTimes.back());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_fd == -1 || grantpt(master_fd) || unlockpt(master_fd)) {
+        fprintf(stderr, "Error, cannot create a pseudo terminal.\n");
+        return -1;
+    }
+    struct termios raw;
+    tcgetattr(master_fd, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(master_fd, TCSANOW, &raw);
+    fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+
+    pthread_t deviceThread;
+    pthread_create(&deviceThread, NULL, device_proc, NULL);
+
+    int ret = 0;
+    if (!run_cycles("on demand reads", 0)) ret = -1;
+    if (!ret && !run_cycles("reader thread", RPlidarDriver::CONNECT_FLAG_READER_THREAD)) ret = -1;
+
+    device_running = false;
+    pthread_join(deviceThread, NULL);
+    close(master_fd);
+    return ret;
+}
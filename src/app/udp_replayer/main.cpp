@@ -0,0 +1,214 @@
+/*
+ *  UDP bridge replayer (Linux)
+ *  Plays a serial bridge on the loopback: answers the commands of the UDP driver
+ *  like an express scan capable RPLIDAR, then streams express capsules a few to a
+ *  datagram, in bursts the driver receives together, and drops one datagram in
+ *  DROP_EVERY. Checks the driver counts the drops and never decodes a capsule
+ *  across one, then prints the link counters.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "sdkcommon.h"
+#include "hal/socket.h"
+
+#define BRIDGE_PORT         20108
+#define HEADER_SIZE         4       /* sequence number of the datagram */
+#define CAPSULES_PER_REV    12      /* 30 degree a capsule, 384 samples a revolution */
+#define CAPSULES_PER_DGRAM  4
+#define BURST_SIZE          8       /* datagrams sent back to back, the driver receives them in one batch */
+#define BURST_GAP_US        4000
+#define DROP_EVERY          50
+#define SCAN_COUNT          200
+#define SAMPLE_STEP_DEG     (360.f / (CAPSULES_PER_REV * 32))
+
+using namespace rp::standalone::rplidar;
+
+static rp::net::DGramSocket * bridge = NULL;
+static rp::net::SocketAddress client;
+static volatile bool         bridge_running = true;
+static _u32                  tx_sequence = 0;
+static volatile _u32         dropped_count = 0;
+
+static void send_datagram(const void * payload, size_t size, bool drop)
+{
+    _u8 datagram[HEADER_SIZE + CAPSULES_PER_DGRAM * sizeof(rplidar_response_capsule_measurement_nodes_t)];
+    memcpy(datagram, &tx_sequence, HEADER_SIZE);
+    ++tx_sequence;
+    if (drop) {
+        ++dropped_count;
+        return;
+    }
+    memcpy(datagram + HEADER_SIZE, payload, size);
+    bridge->sendTo(client, datagram, HEADER_SIZE + size);
+}
+
+static void send_answer(_u8 type, _u32 answerSize, const void * payload, size_t size)
+{
+    _u8 answer[sizeof(rplidar_ans_header_t) + sizeof(rplidar_response_device_info_t)];
+    rplidar_ans_header_t * header = reinterpret_cast<rplidar_ans_header_t *>(answer);
+    header->syncByte1 = RPLIDAR_ANS_SYNC_BYTE1;
+    header->syncByte2 = RPLIDAR_ANS_SYNC_BYTE2;
+    header->size_q30_subtype = answerSize;
+    header->type = type;
+    memcpy(answer + sizeof(*header), payload, size);
+    send_datagram(answer, sizeof(*header) + size, false);
+}
+
+/* capsule index of the stream, the start angle goes round every CAPSULES_PER_REV */
+static void build_capsule(_u32 index, rplidar_response_capsule_measurement_nodes_t & capsule)
+{
+    const size_t cabinCount = sizeof(capsule.cabins) / sizeof(capsule.cabins[0]);
+    memset(&capsule, 0, sizeof(capsule));
+    capsule.start_angle_sync_q6 = (_u16)((index % CAPSULES_PER_REV) * (360 / CAPSULES_PER_REV) * 64);
+    if (!index) capsule.start_angle_sync_q6 |= RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT;
+    for (size_t pos = 0; pos < cabinCount; ++pos) {
+        capsule.cabins[pos].distance_angle_1 = (_u16)((1000 + pos) << 2);
+        capsule.cabins[pos].distance_angle_2 = (_u16)((2000 + pos) << 2);
+    }
+
+    const _u8 * bytes = reinterpret_cast<const _u8 *>(&capsule);
+    _u8 checksum = 0;
+    for (size_t pos = offsetof(rplidar_response_capsule_measurement_nodes_t, start_angle_sync_q6); pos < sizeof(capsule); ++pos) {
+        checksum ^= bytes[pos];
+    }
+    capsule.s_checksum_1 = (RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 << 4) | (checksum & 0xF);
+    capsule.s_checksum_2 = (RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2 << 4) | (checksum >> 4);
+}
+
+static void * bridge_proc(void *)
+{
+    bool streaming = false;
+    _u32 capsule_index = 0;
+    _u32 datagram_count = 0;
+    _u8 request[512];
+
+    while (bridge_running) {
+        if (bridge->waitforData(streaming ? 0 : 10) == RESULT_OK) {
+            size_t size = 0;
+            rp::net::SocketAddress source;
+            if (IS_FAIL(bridge->recvFrom(request, sizeof(request), size, &source)) || size < HEADER_SIZE + 2) continue;
+            /* the driver sends each command in a datagram of its own */
+            const _u8 * cmd = request + HEADER_SIZE;
+            if (cmd[0] != RPLIDAR_CMD_SYNC_BYTE) continue;
+            client = source;
+
+            switch (cmd[1]) {
+            case RPLIDAR_CMD_GET_ACC_BOARD_FLAG: {
+                _u32 flag = 0;
+                send_answer(RPLIDAR_ANS_TYPE_ACC_BOARD_FLAG, sizeof(flag), &flag, sizeof(flag));
+                break;
+            }
+            case RPLIDAR_CMD_GET_DEVICE_INFO: {
+                /* firmware 1.20: express scan, no scan mode configuration */
+                rplidar_response_device_info_t info;
+                memset(&info, 0, sizeof(info));
+                info.model = 0x18;
+                info.firmware_version = (1 << 8) | 20;
+                info.hardware_version = 5;
+                send_answer(RPLIDAR_ANS_TYPE_DEVINFO, sizeof(info), &info, sizeof(info));
+                break;
+            }
+            case RPLIDAR_CMD_GET_DEVICE_HEALTH: {
+                rplidar_response_device_health_t health;
+                memset(&health, 0, sizeof(health));
+                send_answer(RPLIDAR_ANS_TYPE_DEVHEALTH, sizeof(health), &health, sizeof(health));
+                break;
+            }
+            case RPLIDAR_CMD_EXPRESS_SCAN:
+                send_answer(RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED,
+                    sizeof(rplidar_response_capsule_measurement_nodes_t) | (RPLIDAR_ANS_PKTFLAG_LOOP << RPLIDAR_ANS_HEADER_SUBTYPE_SHIFT), NULL, 0);
+                streaming = true;
+                capsule_index = 0;
+                break;
+            case RPLIDAR_CMD_STOP:
+                streaming = false;
+                break;
+            }
+            continue;
+        }
+
+        if (!streaming) continue;
+        for (int burst = 0; burst < BURST_SIZE; ++burst) {
+            rplidar_response_capsule_measurement_nodes_t capsules[CAPSULES_PER_DGRAM];
+            for (int pos = 0; pos < CAPSULES_PER_DGRAM; ++pos) {
+                build_capsule(capsule_index++, capsules[pos]);
+            }
+            send_datagram(capsules, sizeof(capsules), ++datagram_count % DROP_EVERY == 0);
+        }
+        usleep(BURST_GAP_US);
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    bridge = rp::net::DGramSocket::CreateSocket();
+    rp::net::SocketAddress bridgeAddress("127.0.0.1", BRIDGE_PORT);
+    if (!bridge || IS_FAIL(bridge->bind(bridgeAddress))) {
+        fprintf(stderr, "Error, cannot bind the bridge to port %d.\n", BRIDGE_PORT);
+        return -1;
+    }
+
+    pthread_t bridgeThread;
+    pthread_create(&bridgeThread, NULL, bridge_proc, NULL);
+
+    int ret = 0;
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_UDP);
+    if (IS_FAIL(drv->connect("127.0.0.1", BRIDGE_PORT)) || IS_FAIL(drv->startScanExpress(false, RPLIDAR_CONF_SCAN_COMMAND_EXPRESS))) {
+        fprintf(stderr, "Error, cannot start the scan through the bridge.\n");
+        ret = -1;
+    }
+
+    rplidar_response_measurement_node_hq_t nodes[8192];
+    size_t minCount = (size_t)-1, maxCount = 0;
+    int misplaced = 0;
+    for (int scan = 0; scan < SCAN_COUNT && !ret; ++scan) {
+        size_t count = sizeof(nodes) / sizeof(nodes[0]);
+        if (IS_FAIL(drv->grabScanDataHq(nodes, count))) {
+            fprintf(stderr, "Error, no scan.\n");
+            ret = -1;
+            break;
+        }
+        if (count < minCount) minCount = count;
+        if (count > maxCount) maxCount = count;
+
+        /* samples one step apart, a whole capsule missing at least, or going round: a capsule decoded
+           against one from the far side of a drop spreads its samples over several capsules */
+        for (size_t pos = 1; pos < count; ++pos) {
+            float step = (nodes[pos].angle_z_q14 - nodes[pos - 1].angle_z_q14) * 90.f / 16384.f;
+            if (step > 0 && (step < SAMPLE_STEP_DEG * 0.9f || step > SAMPLE_STEP_DEG * 1.1f) && step < 360.f / CAPSULES_PER_REV) ++misplaced;
+        }
+    }
+    drv->stop();
+
+    RplidarLinkStats stats;
+    drv->getLinkStats(stats);
+    bridge_running = false;
+    pthread_join(bridgeThread, NULL);
+
+    if (!ret) {
+        printf("%d scans of %d to %d nodes, %d misplaced\n", SCAN_COUNT, (int)minCount, (int)maxCount, misplaced);
+        printf("datagrams: %d sent, %d dropped by the bridge, %d lost for the driver, %d batches received\n",
+            (int)tx_sequence, (int)dropped_count, (int)stats.lost_datagram_count, (int)stats.read_count);
+        printf("capsules: %d received, %d checksum errors, %d resyncs\n",
+            (int)stats.capsule_frame_count, (int)stats.checksum_error_count, (int)stats.resync_count);
+        /* the last drop shows up with the next datagram only */
+        if (misplaced || stats.lost_datagram_count > dropped_count || stats.lost_datagram_count + 1 < dropped_count) {
+            fprintf(stderr, "Error, the drops were not all accounted for.\n");
+            ret = -1;
+        }
+        /* the case of a gap inside a batch is only covered when the datagrams come in batches */
+        if (stats.read_count * 2 > tx_sequence) {
+            fprintf(stderr, "Error, the datagrams were not received in batches.\n");
+            ret = -1;
+        }
+    }
+
+    RPlidarDriver::DisposeDriver(drv);
+    bridge->dispose();
+    return ret;
+}
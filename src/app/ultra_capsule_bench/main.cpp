@@ -0,0 +1,307 @@
+/*
+ *  Ultra capsule decoder benchmark
+ *  Checks the ultra capsule decoding of the driver, with its variable bit scale
+ *  decoder and angle offset table, bit for bit against a copy of the double
+ *  precision code it replaced on random capsules, then times both.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkcommon.h"
+#include "hal/abs_rxtx.h"
+#include "hal/thread.h"
+#include "hal/locker.h"
+#include "hal/atomic.h"
+#include "hal/event.h"
+#include "rplidar_cartesian.h"
+#include "rplidar_scan_pool.h"
+#include "rplidar_node_ring.h"
+#include "rplidar_point_history.h"
+#include "rplidar_byte_ring.h"
+#include "rplidar_driver_impl.h"
+#include "rplidar_driver_serial.h"
+#include "rplidar_capsule_decode.h"
+
+#define CAPSULE_COUNT       4096
+#define ROUND_COUNT         20
+#define MAX_SAMPLES         96
+
+using namespace rp::standalone::rplidar;
+
+static const char * engines[] = { "scalar", "sse2", "avx2", "neon" };
+
+/* The variable bit scale decoder of the driver before the segment count, kept as it was */
+static _u32 _varbitscale_decode(_u32 scaled, _u32 & scaleLevel)
+{
+    static const _u32 VBS_SCALED_BASE[] = {
+        RPLIDAR_VARBITSCALE_X16_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X8_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X4_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X2_DEST_VAL,
+        0,
+    };
+
+    static const _u32 VBS_SCALED_LVL[] = {
+        4,
+        3,
+        2,
+        1,
+        0,
+    };
+
+    static const _u32 VBS_TARGET_BASE[] = {
+        (0x1 << RPLIDAR_VARBITSCALE_X16_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X8_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X4_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X2_SRC_BIT),
+        0,
+    };
+
+    for (size_t i = 0; i < _countof(VBS_SCALED_BASE); ++i)
+    {
+        int remain = ((int)scaled - (int)VBS_SCALED_BASE[i]);
+        if (remain >= 0) {
+            scaleLevel = VBS_SCALED_LVL[i];
+            return VBS_TARGET_BASE[i] + (remain << scaleLevel);
+        }
+    }
+    return 0;
+}
+
+/* The ultra capsule decoding of the driver before the offset table, kept as it was */
+class BaselineDecoder {
+public:
+    BaselineDecoder() : _is_previous_capsuledataRdy(false) {}
+
+    void _ultraCapsuleToNormal(const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
+    {
+        nodeCount = 0;
+        if (_is_previous_capsuledataRdy) {
+            int diffAngle_q8;
+            int currentStartAngle_q8 = ((capsule.start_angle_sync_q6 & 0x7FFF) << 2);
+            int prevStartAngle_q8 = ((_cached_previous_ultracapsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
+
+            diffAngle_q8 = (currentStartAngle_q8)-(prevStartAngle_q8);
+            if (prevStartAngle_q8 >  currentStartAngle_q8) {
+                diffAngle_q8 += (360 << 8);
+            }
+
+            int angleInc_q16 = (diffAngle_q8 << 3) / 3;
+            int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
+            for (size_t pos = 0; pos < _countof(_cached_previous_ultracapsuledata.ultra_cabins); ++pos)
+            {
+                int dist_q2[3];
+                int angle_q6[3];
+                int syncBit[3];
+
+
+                _u32 combined_x3 = _cached_previous_ultracapsuledata.ultra_cabins[pos].combined_x3;
+
+                // unpack ...
+                int dist_major = (combined_x3 & 0xFFF);
+
+                // signed partical integer, using the magic shift here
+                // DO NOT TOUCH
+
+                int dist_predict1 = (((int)(combined_x3 << 10)) >> 22);
+                int dist_predict2 = (((int)combined_x3) >> 22);
+
+                int dist_major2;
+
+                _u32 scalelvl1, scalelvl2;
+
+                // prefetch next ...
+                if (pos == _countof(_cached_previous_ultracapsuledata.ultra_cabins) - 1)
+                {
+                    dist_major2 = (capsule.ultra_cabins[0].combined_x3 & 0xFFF);
+                }
+                else {
+                    dist_major2 = (_cached_previous_ultracapsuledata.ultra_cabins[pos + 1].combined_x3 & 0xFFF);
+                }
+
+                // decode with the var bit scale ...
+                dist_major = _varbitscale_decode(dist_major, scalelvl1);
+                dist_major2 = _varbitscale_decode(dist_major2, scalelvl2);
+
+
+                int dist_base1 = dist_major;
+                int dist_base2 = dist_major2;
+
+                if ((!dist_major) && dist_major2) {
+                    dist_base1 = dist_major2;
+                    scalelvl1 = scalelvl2;
+                }
+
+
+                dist_q2[0] = (dist_major << 2);
+                if ((dist_predict1 == (int)0xFFFFFE00) || (dist_predict1 == 0x1FF)) {
+                    dist_q2[1] = 0;
+                } else {
+                    dist_predict1 = (dist_predict1 << scalelvl1);
+                    dist_q2[1] = (dist_predict1 + dist_base1) << 2;
+
+                }
+
+                if ((dist_predict2 == (int)0xFFFFFE00) || (dist_predict2 == 0x1FF)) {
+                    dist_q2[2] = 0;
+                } else {
+                    dist_predict2 = (dist_predict2 << scalelvl2);
+                    dist_q2[2] = (dist_predict2 + dist_base2) << 2;
+                }
+
+
+                for (int cpos = 0; cpos < 3; ++cpos)
+                {
+
+                    syncBit[cpos] = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
+
+                    int offsetAngleMean_q16 = (int)(7.5 * 3.1415926535 * (1 << 16) / 180.0);
+
+                    if (dist_q2[cpos] >= (50 * 4))
+                    {
+                        const int k1 = 98361;
+                        const int k2 = int(k1 / dist_q2[cpos]);
+
+                        offsetAngleMean_q16 = (int)(8 * 3.1415926535 * (1 << 16) / 180) - (k2 << 6) - (k2 * k2 * k2) / 98304;
+                    }
+
+                    angle_q6[cpos] = ((currentAngle_raw_q16 - int(offsetAngleMean_q16 * 180 / 3.14159265)) >> 10);
+                    currentAngle_raw_q16 += angleInc_q16;
+
+                    if (angle_q6[cpos] < 0) angle_q6[cpos] += (360 << 6);
+                    if (angle_q6[cpos] >= (360 << 6)) angle_q6[cpos] -= (360 << 6);
+
+                    rplidar_response_measurement_node_hq_t node;
+
+                    node.flag = (syncBit[cpos] | ((!syncBit[cpos]) << 1));
+                    node.quality = dist_q2[cpos] ? (0x2F << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
+                    node.angle_z_q14 = _u16((angle_q6[cpos] << 8) / 90);
+                    node.dist_mm_q2 = dist_q2[cpos];
+
+                    nodebuffer[nodeCount++] = node;
+                }
+
+            }
+        }
+
+        _cached_previous_ultracapsuledata = capsule;
+        _is_previous_capsuledataRdy = true;
+    }
+
+protected:
+    rplidar_response_ultra_capsule_measurement_nodes_t _cached_previous_ultracapsuledata;
+    bool                                               _is_previous_capsuledataRdy;
+};
+
+/* Opens the ultra capsule decoding of the driver, no device is ever connected */
+class CapsuleProbe : public RPlidarDriverSerial {
+public:
+    /* the driver clears it when a scan starts */
+    CapsuleProbe() { _is_previous_capsuledataRdy = false; }
+
+    using RPlidarDriverImplCommon::_ultraCapsuleToNormal;
+};
+
+/* Random capsules, one out of 16 carries a start angle beyond 360 degree.
+ * The cabins mix random words with the cases the decoder treats apart:
+ * a zero major distance and the predictions that mark an invalid sample.
+ */
+static void build_capsules(rplidar_response_ultra_capsule_measurement_nodes_t * capsules)
+{
+    static const _u32 invalidPredicts[] = { 0x1FF, 0x200 };
+
+    for (int i = 0; i < CAPSULE_COUNT; ++i) {
+        rplidar_response_ultra_capsule_measurement_nodes_t & capsule = capsules[i];
+        _u8 * bytes = reinterpret_cast<_u8 *>(&capsule);
+        for (size_t pos = 0; pos < sizeof(capsule); ++pos) {
+            bytes[pos] = (_u8)rand();
+        }
+        int startAngle_q6 = (i % 16) ? rand() % (360 << 6) : rand() % 0x8000;
+        capsule.start_angle_sync_q6 = (_u16)(startAngle_q6 | ((rand() & 1) << 15));
+
+        for (size_t pos = 0; pos < _countof(capsule.ultra_cabins); ++pos) {
+            _u32 combined_x3 = capsule.ultra_cabins[pos].combined_x3;
+            switch (rand() % 8) {
+            case 0: combined_x3 &= ~0xFFFu; break;
+            case 1: combined_x3 = (combined_x3 & ~(0x3FFu << 12)) | (invalidPredicts[rand() & 1] << 12); break;
+            case 2: combined_x3 = (combined_x3 & ~(0x3FFu << 22)) | (invalidPredicts[rand() & 1] << 22); break;
+            default: break;
+            }
+            capsule.ultra_cabins[pos].combined_x3 = combined_x3;
+        }
+    }
+}
+
+typedef void (*decode_func_t)(void * decoder, const rplidar_response_ultra_capsule_measurement_nodes_t &, rplidar_response_measurement_node_hq_t *, size_t &);
+
+static void decode_baseline(void * decoder, const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t * nodebuffer, size_t & nodeCount)
+{
+    static_cast<BaselineDecoder *>(decoder)->_ultraCapsuleToNormal(capsule, nodebuffer, nodeCount);
+}
+
+static void decode_driver(void * decoder, const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t * nodebuffer, size_t & nodeCount)
+{
+    static_cast<CapsuleProbe *>(decoder)->_ultraCapsuleToNormal(capsule, nodebuffer, nodeCount);
+}
+
+static double bench(decode_func_t func, void * decoder, const rplidar_response_ultra_capsule_measurement_nodes_t * capsules)
+{
+    rplidar_response_measurement_node_hq_t nodes[MAX_SAMPLES];
+    size_t nodeCount;
+    volatile _u32 sink = 0;
+    _u64 startTs = rp::arch::rp_getus();
+    for (int round = 0; round < ROUND_COUNT; ++round) {
+        for (int i = 0; i < CAPSULE_COUNT; ++i) {
+            func(decoder, capsules[i], nodes, nodeCount);
+            sink ^= nodes[MAX_SAMPLES - 1].angle_z_q14;
+        }
+    }
+    return (rp::arch::rp_getus() - startTs) * 1000.0 / (ROUND_COUNT * CAPSULE_COUNT);
+}
+
+int main(int argc, char** argv) {
+    const char * defaultEngine = capsule_decoder::getEngineName();
+    rplidar_response_ultra_capsule_measurement_nodes_t * capsules = new rplidar_response_ultra_capsule_measurement_nodes_t[CAPSULE_COUNT];
+    int ans = 0;
+
+    srand(1);
+    printf("engine: %s\n", defaultEngine);
+    build_capsules(capsules);
+
+    for (size_t engine = 0; engine < _countof(engines); ++engine) {
+        if (!capsule_decoder::selectEngine(engines[engine])) continue;
+
+        CapsuleProbe probe;
+        BaselineDecoder baseline;
+        for (int i = 0; i < CAPSULE_COUNT; ++i) {
+            rplidar_response_measurement_node_hq_t expected[MAX_SAMPLES], actual[MAX_SAMPLES];
+            size_t expectedCount, actualCount;
+
+            baseline._ultraCapsuleToNormal(capsules[i], expected, expectedCount);
+            probe._ultraCapsuleToNormal(capsules[i], actual, actualCount);
+            if (expectedCount != actualCount || memcmp(expected, actual, actualCount * sizeof(actual[0]))) {
+                fprintf(stderr, "Error, ultra capsule %d decoded by the driver differently from the baseline with the %s engine.\n", i, engines[engine]);
+                ans = -1;
+                goto _final;
+            }
+        }
+        printf("%-8s driver matches the baseline on %d ultra capsules\n", engines[engine], CAPSULE_COUNT);
+    }
+
+    capsule_decoder::selectEngine(defaultEngine);
+    {
+        CapsuleProbe probe;
+        BaselineDecoder baseline;
+        printf("ultra    baseline %7.1f ns/capsule, driver %7.1f ns/capsule\n",
+            bench(decode_baseline, &baseline, capsules),
+            bench(decode_driver, &probe, capsules));
+    }
+
+_final:
+    capsule_decoder::selectEngine(defaultEngine);
+    delete [] capsules;
+    return ans;
+}
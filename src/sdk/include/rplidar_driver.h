@@ -60,9 +60,90 @@ struct RplidarScanMode {
     char    scan_mode[64];    // name of scan mode, max 63 characters
 };
 
+struct RplidarIntervalBufferStats {
+    _u32    capacity;         // max nodes held between two reads
+    _u32    pending_count;    // nodes waiting to be read
+    _u32    pushed_count;     // nodes stored since the driver was created (wraps around)
+    _u32    dropped_count;    // nodes lost because the buffer was full (wraps around)
+    _u32    overflow_count;   // times the buffer was full when nodes came in (wraps around)
+};
+
+struct RplidarTimestampedNode {
+    rplidar_response_measurement_node_hq_t node;
+    _u64    host_timestamp_us;   // host monotonic clock, interpolated from the arrival of the capsule and us_per_sample
+    _u64    device_timestamp;    // clock of the device for the capsule holding the node (HQ mode only), 0 otherwise
+};
+
+struct RplidarScanBufferStats {
+    _u32    max_nodes_per_scan;    // nodes a revolution can hold, sized from us_per_sample and the min scan frequency
+    _u32    history_capacity;      // points kept by the point history
+    _u32    arena_size;            // bytes allocated for all the scan buffers
+    _u32    truncated_scan_count;  // revolutions with more nodes than max_nodes_per_scan (wraps around)
+    _u32    dropped_scan_count;    // revolutions lost because every buffer was leased out (wraps around)
+};
+
+struct RplidarLinkStats {
+    _u32    baudrate;                   // of the serial connection, 0 over TCP and UDP
+    _u32    received_size;              // bytes read from the channel (wraps around)
+    _u32    read_count;                 // reads from the serial port or the socket, done by the reader of the channel when it has one (wraps around)
+    _u32    node_frame_count;           // standard scan nodes received (wraps around)
+    _u32    capsule_frame_count;        // express and dense capsules received (wraps around)
+    _u32    ultra_capsule_frame_count;  // ultra capsules received (wraps around)
+    _u32    hq_capsule_frame_count;     // HQ capsules received (wraps around)
+    _u32    resync_count;               // times the parser lost the frame boundaries (wraps around)
+    _u32    discarded_size;             // bytes skipped to find a frame again (wraps around)
+    _u32    checksum_error_count;       // frames failing their checksum or CRC (wraps around)
+    _u32    lost_datagram_count;        // UDP: datagrams missing from the sequence or cut, serial reader thread:
+                                        // bytes dropped with the ring full (wraps around)
+    // over interval_us, the time since the previous call (since the connection for the first one)
+    _u32    interval_us;
+    float   reads_per_frame;            // reads from the port for each frame received
+    float   link_utilization;           // share of the baud rate used, at 10 bits per byte. 0 over TCP and UDP
+};
+
+struct RplidarTcpOptions {
+    _u32    receive_buffer_size;   // SO_RCVBUF in bytes, 0 keeps the system default
+    bool    no_delay;              // TCP_NODELAY: send the commands without waiting for more data, true by default
+    _u32    busy_poll_us;          // SO_BUSY_POLL (Linux): spin up to that long before sleeping on a receive, 0 disables
+};
+
+// scheduling of the thread caching the scans, RPlidarDriver::RT_SCHED_xxx
+struct RplidarRealtimeProfile {
+    _u32    sched_policy;          // RT_SCHED_DEFAULT leaves the thread to the time sharing scheduler
+    int     sched_priority;        // of RT_SCHED_FIFO and RT_SCHED_RR, 1 to 99 on Linux
+    int     cpu_core;              // core the thread is pinned to, -1 lets it run anywhere
+    bool    lock_memory;           // mlockall() the process so no page of the driver is ever swapped out
+    _u32    prefault_stack_size;   // bytes of stack the thread touches before its first wait, up to MAX_PREFAULT_STACK_SIZE, 0 for none
+};
+
+struct RplidarRealtimeStats {
+    _u32    applied;               // RT_PROFILE_xxx, the parts of the profile in effect on the cache thread
+    // from the arrival of the last byte of a frame to the cache thread decoding it, since the scan started.
+    // Only the serial reader thread (CONNECT_FLAG_READER_THREAD) records the arrival times, frame_count stays 0 otherwise
+    _u32    frame_count;           // frames timed (wraps around)
+    _u32    min_latency_us;
+    _u32    mean_latency_us;
+    _u32    max_latency_us;
+    _u32    over_100us_count;      // frames decoded more than 100us after they arrived (wraps around)
+    _u32    over_1ms_count;        // frames decoded more than 1ms after they arrived (wraps around)
+};
+
+struct RplidarSerialRingStats {
+    _u32    capacity;          // bytes the ring between the reader thread and the decoder holds
+    _u32    pending_size;      // bytes received and not decoded yet
+    _u32    high_water_mark;   // most bytes pending at once since the port was opened
+    _u32    received_size;     // bytes read from the port (wraps around)
+    _u32    dropped_size;      // bytes lost because the ring was full (wraps around)
+    _u32    overflow_count;    // reads that found the ring full (wraps around)
+    _u32    chunk_count;       // reads that stored data, each with its own arrival time (wraps around)
+};
+
 enum {
     DRIVER_TYPE_SERIALPORT = 0x0,
     DRIVER_TYPE_TCP = 0x1,
+    // datagrams to and from a serial bridge: a 32-bit little endian sequence number, then the bytes
+    // of the serial link, whole frames in each datagram from the bridge
+    DRIVER_TYPE_UDP = 0x2,
 };
 
 class ChannelDevice
@@ -73,11 +154,103 @@ public:
     virtual void close() = 0;
     virtual void flush() {return;}
     virtual bool waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL) = 0;
+    // deadline_us is a time of RPlidarDriver::GetTimestamp_uS(), (_u64)-1 waits forever.
+    // The driver waits through this one, by default waitfordata with the time left rounded up to a millisecond
+    virtual bool waitfordataUntil(size_t data_count, _u64 deadline_us, size_t * returned_size = NULL);
+    // cancelWait ends the wait in progress, and fails the later ones, until resumeWait.
+    // Channels that cannot be woken, canCancelWait() false, let the wait run to its deadline
+    virtual bool canCancelWait() {return false;}
+    virtual void cancelWait() {return;}
+    virtual void resumeWait() {return;}
     virtual int senddata(const _u8 * data, size_t size) = 0;
     virtual int recvdata(unsigned char * data, size_t size) = 0;
     virtual void setDTR() {return;}
     virtual void clearDTR() {return;}
     virtual void ReleaseRxTx() {return;}
+    virtual _u32 getLowLatencyStatus() {return 0;}
+    virtual bool getArrivalTimestamp(size_t , _u64 & ) {return false;}
+    virtual bool getRingStats(RplidarSerialRingStats & ) {return false;}
+    virtual bool getReadCount(_u32 & ) {return false;}
+    // data lost by the channel ahead of the bytes read so far. A read never returns bytes from
+    // both sides of a loss, the count grows with the read that starts right after it
+    virtual bool getLossCount(_u32 & ) {return false;}
+};
+
+class RplidarScanPool;
+
+/// A read-only handle on one complete revolution held in a buffer owned by the driver.
+/// The buffer cannot be reused by the driver until the lease is released, either
+/// explicitly or when the lease object goes out of scope.
+///
+/// NOTE: the driver keeps only a handful of such buffers. Release the lease as soon
+/// as the scan has been consumed, and always before disposing the driver.
+class RplidarScanLease {
+public:
+    RplidarScanLease()
+        : _pool(NULL), _slot(0), _nodes(NULL), _hostOffsets(NULL), _deviceTs(NULL)
+        , _angles(NULL), _distances(NULL), _qualities(NULL), _flags(NULL), _xs(NULL), _ys(NULL)
+        , _count(0), _droppedNodes(0), _sequence(0), _startTs(0), _endTs(0) {}
+    ~RplidarScanLease() { release(); }
+
+    /// Give the buffer back to the driver, the lease is no longer valid afterwards
+    void release();
+
+    bool isValid() const { return _pool != NULL; }
+
+    /// Nodes of the revolution, the first one carries the sync bit
+    const rplidar_response_measurement_node_hq_t * nodes() const { return _nodes; }
+    size_t count() const { return _count; }
+
+    /// Sequence number of the revolution, a gap means revolutions were missed
+    _u64 sequence() const { return _sequence; }
+
+    /// Nodes of the revolution that did not fit in the driver buffer, see RPlidarDriver::setMinScanFrequency
+    size_t droppedNodeCount() const { return _droppedNodes; }
+
+    /// Host time of the first node of the revolution (in microseconds, monotonic clock)
+    _u64 startTimestamp_uS() const { return _startTs; }
+    /// Time the revolution was completed by the driver (in microseconds, monotonic clock)
+    _u64 endTimestamp_uS() const { return _endTs; }
+
+    /// Host time of a node, see RplidarTimestampedNode::host_timestamp_us
+    _u64 hostTimestamp_uS(size_t pos) const { return _startTs + _hostOffsets[pos]; }
+    /// Device time of a node, see RplidarTimestampedNode::device_timestamp
+    _u64 deviceTimestamp(size_t pos) const { return _deviceTs[pos]; }
+
+    /// The revolution as separate arrays of count() values, see RPlidarDriver::enableScanSoA
+    /// Each array starts on a 32-byte boundary. NULL when the SoA format is not enabled.
+    const float * angles() const { return _angles; }          // degree
+    const float * distances() const { return _distances; }    // mm
+    const _u8 * qualities() const { return _qualities; }
+    const _u8 * flags() const { return _flags; }
+
+    /// Position of each node (in mm), see RPlidarDriver::enableScanCartesian
+    /// Each array starts on a 32-byte boundary. NULL when the cartesian output is not enabled.
+    const float * xs() const { return _xs; }
+    const float * ys() const { return _ys; }
+
+private:
+    friend class RplidarScanPool;
+
+    RplidarScanLease(const RplidarScanLease &);
+    RplidarScanLease & operator = (const RplidarScanLease &);
+
+    RplidarScanPool * _pool;
+    _u32              _slot;
+    const rplidar_response_measurement_node_hq_t * _nodes;
+    const _u32 *      _hostOffsets;
+    const _u64 *      _deviceTs;
+    const float *     _angles;
+    const float *     _distances;
+    const _u8 *       _qualities;
+    const _u8 *       _flags;
+    const float *     _xs;
+    const float *     _ys;
+    size_t            _count;
+    size_t            _droppedNodes;
+    _u64              _sequence;
+    _u64              _startTs;
+    _u64              _endTs;
 };
 
 class RPlidarDriver {
@@ -94,6 +267,45 @@ public:
         LEGACY_SAMPLE_DURATION = 476,
     };
 
+    enum {
+        MAX_SCAN_SUBSCRIBERS = 8,
+    };
+
+    enum {
+        DEFAULT_MIN_SCAN_FREQUENCY = 2, // Hz
+    };
+
+    enum {
+        CONNECT_FLAG_LOW_LATENCY = 0x1,
+        CONNECT_FLAG_READER_THREAD = 0x2,
+    };
+
+    enum {
+        DEFAULT_SERIAL_RING_SIZE = 64 * 1024, // bytes
+    };
+
+    enum {
+        LOW_LATENCY_ASYNC = 0x1,    // the serial driver pushes the received bytes right away (ASYNC_LOW_LATENCY)
+        LOW_LATENCY_TIMER = 0x2,    // the latency timer of the USB adapter is 1ms (FTDI)
+    };
+
+    enum {
+        RT_SCHED_DEFAULT = 0,
+        RT_SCHED_FIFO = 1,          // runs until it blocks or a higher priority preempts it
+        RT_SCHED_RR = 2,            // like RT_SCHED_FIFO, time sliced among the threads of the same priority
+    };
+
+    enum {
+        RT_PROFILE_SCHED = 0x1,     // the policy and the priority
+        RT_PROFILE_AFFINITY = 0x2,  // the thread only runs on cpu_core
+        RT_PROFILE_MEMLOCK = 0x4,   // the memory of the process is locked
+        RT_PROFILE_STACK = 0x8,     // the stack was pre-faulted
+    };
+
+    enum {
+        MAX_PREFAULT_STACK_SIZE = 512 * 1024, // bytes
+    };
+
 public:
     /// Create an RPLIDAR Driver Instance
     /// This interface should be invoked first before any other operations
@@ -105,18 +317,29 @@ public:
     /// Applications should invoke this interface when the driver instance is no longer used in order to free memory
     static void DisposeDriver(RPlidarDriver * drv);
 
+    /// Current time of the monotonic clock used for all the timestamps reported by the driver, in microseconds
+    static _u64 GetTimestamp_uS();
+
 
     /// Open the specified serial port and connect to a target RPLIDAR device
     ///
     /// \param port_path     the device path of the serial port 
     ///        e.g. on Windows, it may be com3 or \\.\com10 
     ///             on Unix-Like OS, it may be /dev/ttyS1, /dev/ttyUSB2, etc
+    ///        or the address of the device for DRIVER_TYPE_TCP and DRIVER_TYPE_UDP
     ///
     /// \param baudrate      the baudrate used
     ///        For most RPLIDAR models, the baudrate should be set to 115200
+    ///        or the port of the device for DRIVER_TYPE_TCP and DRIVER_TYPE_UDP.
+    ///        Over UDP, the device streams to the address the commands come from.
     ///
     /// \param flag          other flags
-    ///        Reserved for future use, always set to Zero
+    ///        CONNECT_FLAG_LOW_LATENCY: on Linux, lower the delay added by the tty layer and the USB-UART
+    ///        adapter before the received bytes reach the driver, at the cost of more wake-ups.
+    ///        The settings are restored on disconnect, see getLowLatencyStatus for the ones applied.
+    ///        CONNECT_FLAG_READER_THREAD: read the serial port from a dedicated thread into a ring buffer
+    ///        (see setSerialRingSize), so a slow decode never delays the reads. The arrival time of the
+    ///        received data is then taken by that thread.
     virtual u_result connect(const char *, _u32, _u32 flag = 0) = 0;
 
 
@@ -126,6 +349,51 @@ public:
     /// Returns TRUE when the connection has been established
     virtual bool isConnected() = 0;
 
+    /// Retrieve the LOW_LATENCY_xxx settings applied by CONNECT_FLAG_LOW_LATENCY
+    /// Any of them may be missing: unsupported by the adapter, or not permitted to the current user.
+    /// The connection works the same without them.
+    virtual u_result getLowLatencyStatus(_u32 & status) = 0;
+
+    /// Set the size of the ring buffer filled by the reader thread of CONNECT_FLAG_READER_THREAD
+    /// It takes effect at the next connection and is rounded up to a power of 2.
+    /// Use getSerialRingStats to see how much of it is actually used.
+    ///
+    /// \param size         Bytes, DEFAULT_SERIAL_RING_SIZE by default
+    virtual u_result setSerialRingSize(size_t size) = 0;
+
+    /// Retrieve the fill level, the high-water mark and the overflow counters of the ring buffer
+    /// filled by the reader thread of CONNECT_FLAG_READER_THREAD
+    /// When the ring is full, the newest bytes are dropped until the decoder catches up.
+    ///
+    /// The interface will return RESULT_OPERATION_NOT_SUPPORT when the port is read without a reader thread.
+    virtual u_result getSerialRingStats(RplidarSerialRingStats & stats) = 0;
+
+    /// Set the socket options of DRIVER_TYPE_TCP
+    /// They take effect at the next connection. Each of them is applied on a best effort basis:
+    /// an option the system does not support or does not permit leaves the connection working as before.
+    virtual u_result setTcpOptions(const RplidarTcpOptions & options) = 0;
+
+    /// Set the real-time profile of the thread caching the scans
+    /// It takes effect when the next scan starts. The priority is checked against the range of the policy
+    /// and the call returns RESULT_INVALID_DATA for a priority or a core out of range.
+    /// Raising the policy needs CAP_SYS_NICE (or RLIMIT_RTPRIO) and locking the memory CAP_IPC_LOCK (or RLIMIT_MEMLOCK)
+    /// on Linux: each part is applied on a best effort basis, getRealtimeStats tells which ones are in effect.
+    ///
+    /// NOTE: a SCHED_FIFO thread spinning on a core starves everything else on that core,
+    /// pin the cache thread to a core left to it when the priority is high.
+    virtual u_result setRealtimeProfile(const RplidarRealtimeProfile & profile) = 0;
+
+    /// Retrieve the parts of the real-time profile in effect and how late the cache thread decodes the frames
+    /// The latency is only measured with the arrival times recorded by CONNECT_FLAG_READER_THREAD.
+    /// It can be called from any thread while scanning, the counters it returns are consistent with each other.
+    virtual u_result getRealtimeStats(RplidarRealtimeStats & stats) = 0;
+
+    /// Retrieve the traffic counters of the link with the device
+    /// The counters are always maintained, at the cost of a few increments per frame.
+    /// The rates (reads_per_frame, link_utilization) cover the time since the previous call,
+    /// a utilization close to 1 means the scan mode saturates the baud rate.
+    virtual u_result getLinkStats(RplidarLinkStats & stats) = 0;
+
     /// Ask the RPLIDAR core system to reset it self
     /// The host system can use the Reset operation to help RPLIDAR escape the self-protection mode.
     ///
@@ -275,6 +543,42 @@ public:
     /// \The caller application can set the timeout value to Zero(0) to make this interface always returns immediately to achieve non-block operation.
     virtual u_result grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT) = 0;
 
+    /// Wait and grab a complete 0-360 degree scan data previously received, with the time of each sample
+    /// Same as grabScanDataHq, see RplidarTimestampedNode for the timestamps.
+    virtual u_result grabScanDataTimestamped(RplidarTimestampedNode * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Wait for a complete 0-360 degree scan and lease the driver buffer holding it, without copying the data.
+    /// The leased scan has the same charactistics as the one returned by grabScanDataHq.
+    ///
+    /// \param lease          Receives the handle on the scan. A scan already held by this lease is released first.
+    ///                       The nodes must not be modified, copy them first to reorder them with ascendScanData.
+    ///
+    /// \param timeout        Max duration allowed to wait for a complete scan data.
+    ///
+    /// The interface will return RESULT_OPERATION_TIMEOUT to indicate that no complete 360-degrees' scan can be retrieved withing the given timeout duration. 
+    virtual u_result grabScanLease(RplidarScanLease & lease, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Register a new consumer of complete scans
+    /// Unlike grabScanDataHq and grabScanLease, where each scan goes to a single caller, every subscriber
+    /// receives every scan published after it subscribed. A subscriber must be used by one thread at a time.
+    ///
+    /// \param subscriberId   Receives the id to pass to grabSubscribedScan and unsubscribeScan.
+    ///
+    /// The interface will return RESULT_INSUFFICIENT_MEMORY when MAX_SCAN_SUBSCRIBERS are already registered.
+    virtual u_result subscribeScan(_u32 & subscriberId) = 0;
+
+    /// Unregister a subscriber, its id may be handed out again afterwards
+    virtual u_result unsubscribeScan(_u32 subscriberId) = 0;
+
+    /// Wait for the next complete scan of a subscriber and lease it, see grabScanLease
+    /// The driver keeps the last few scans for the subscribers. A subscriber that falls behind skips
+    /// to the oldest scan still available, it never slows down the acquisition.
+    ///
+    /// \param missedCount    Receives the number of scans the subscriber skipped since its previous call.
+    ///
+    /// The interface will return RESULT_OPERATION_TIMEOUT to indicate that no new scan was published withing the given timeout duration. 
+    virtual u_result grabSubscribedScan(_u32 subscriberId, RplidarScanLease & lease, _u32 & missedCount, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
     /// Ascending the scan data according to the angle value in the scan.
     ///
     /// \param nodebuffer     Buffer provided by the caller application to do the reorder. Should be retrived from the grabScanData
@@ -311,6 +615,98 @@ public:
     /// The interface will return RESULT_OPERATION_TIMEOUT to indicate that not even a single node can be retrieved since last call. 
     virtual u_result getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count) = 0;
 
+    /// Return received scan points even if it's not complete scan, without returning more than the caller can hold
+    /// The points not returned are kept for the next call. This never stalls the decoding of incoming data.
+    ///
+    /// \param nodebuffer     Buffer provided by the caller application to store the scan data
+    ///
+    /// \param count          The caller must initialize this parameter to set the max data count of the provided buffer (in unit of rplidar_response_measurement_node_hq_t).
+    ///                       Once the interface returns, this parameter will store the actual returned data count.
+    ///
+    /// The interface will return RESULT_OPERATION_TIMEOUT to indicate that not even a single node can be retrieved since last call. 
+    virtual u_result drainScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count) = 0;
+
+    /// Retrieve the fill level and the overflow counters of the buffer behind getScanDataWithIntervalHq
+    /// When the buffer is full, the newest points are dropped until the application reads some of them.
+    virtual u_result getScanDataWithIntervalStats(RplidarIntervalBufferStats & stats) = 0;
+
+    /// Retrieve the points received within a time range from the history kept by the driver
+    /// The driver keeps the latest points received (at least 2 seconds worth), whether their revolution is complete or not.
+    ///
+    /// \param startTs_uS     Start of the time range, included (see GetTimestamp_uS)
+    ///
+    /// \param endTs_uS       End of the time range, included
+    ///
+    /// \param nodebuffer     Buffer provided by the caller application to store the points
+    ///
+    /// \param timestamps     Optional buffer receiving the arrival time of each point, can be NULL
+    ///
+    /// \param count          The caller must initialize this parameter to set the max data count of the provided buffers.
+    ///                       Once the interface returns, this parameter will store the actual returned data count.
+    ///                       When more points match, only the most recent ones are returned.
+    ///
+    /// The interface will return RESULT_OPERATION_TIMEOUT to indicate that no point of the history falls within the range.
+    virtual u_result getScanHistory(_u64 startTs_uS, _u64 endTs_uS, rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps, size_t & count) = 0;
+
+    /// Retrieve the points covering the last 360 degree, ending with the latest point received
+    /// Unlike grabScanDataHq, this does not wait for the next sync bit, the first point is usually not the start of a scan.
+    /// The parameters are the same as getScanHistory.
+    ///
+    /// The interface will return RESULT_OPERATION_TIMEOUT to indicate that the history does not hold a full turn yet.
+    virtual u_result getLatestRevolutionFromHistory(rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps, size_t & count) = 0;
+
+    /// Set the lowest rotation frequency the scan buffers must be able to hold a full revolution for
+    /// The buffers are allocated when a scan starts, from the sample duration of the scan mode and this frequency,
+    /// with an upper bound of MAX_SCAN_NODES nodes per revolution. Nodes of a slower revolution are dropped and
+    /// reported by RplidarScanLease::droppedNodeCount and getScanBufferStats.
+    /// They are kept unchanged when a scan starts while a lease is still held.
+    ///
+    /// \param frequency      Rotation frequency in Hz, DEFAULT_MIN_SCAN_FREQUENCY by default. Applies from the next scan start.
+    virtual u_result setMinScanFrequency(float frequency) = 0;
+
+    /// Retrieve the sizes and the overflow counters of the scan buffers
+    virtual u_result getScanBufferStats(RplidarScanBufferStats & stats) = 0;
+
+    /// Also store each complete scan as separate angle, distance, quality and flag arrays
+    /// The arrays are filled by the driver as the scan comes in, see RplidarScanLease::angles.
+    /// They are returned by grabScanLease and grabSubscribedScan, or copied with grabScanDataSoA.
+    ///
+    /// \param enable         Disabled by default. Applies from the next scan start, like setMinScanFrequency.
+    virtual u_result enableScanSoA(bool enable) = 0;
+
+    /// Wait and grab a complete 0-360 degree scan data as separate arrays, see grabScanDataHq
+    /// Works whether or not enableScanSoA was called, the scan is converted on the fly otherwise.
+    ///
+    /// \param angles         Receives the angle of each node (in degree).
+    /// \param distances      Receives the distance of each node (in mm).
+    /// \param qualities      Receives the quality of each node.
+    /// \param flags          Receives the flags of each node (RPLIDAR_RESP_MEASUREMENT_SYNCBIT for the first one).
+    /// \param count          The caller must initialize this parameter to the capacity of each array.
+    ///                       Once the interface returns, this parameter will store the actual received data count.
+    ///
+    /// The interface will return RESULT_OPERATION_TIMEOUT to indicate that no complete 360-degrees' scan can be retrieved withing the given timeout duration. 
+    virtual u_result grabScanDataSoA(float * angles, float * distances, _u8 * qualities, _u8 * flags, size_t & count, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Set where the sensor is mounted, for the x/y coordinates of the nodes
+    /// The nodes are seen clockwise from above: in the frame of the sensor x points to 0 degree and y to 270 degree.
+    ///
+    /// \param x_mm           Position of the sensor in the target frame.
+    /// \param y_mm
+    /// \param yaw_deg        Angle from the x axis of the target frame to the 0 degree direction of the sensor, counterclockwise.
+    ///
+    /// Used by convertScanToCartesian right away, and by enableScanCartesian from the next scan start.
+    virtual u_result setSensorPose(float x_mm, float y_mm, float yaw_deg) = 0;
+
+    /// Also store each complete scan as x/y coordinates in the target frame of setSensorPose
+    /// The coordinates are computed by the driver as the scan comes in, see RplidarScanLease::xs.
+    ///
+    /// \param enable         Disabled by default. Applies from the next scan start, like setMinScanFrequency.
+    virtual u_result enableScanCartesian(bool enable) = 0;
+
+    /// Convert nodes to x/y coordinates (in mm) in the target frame of setSensorPose
+    /// sin and cos come from a table indexed by angle_z_q14, which is exact to the float precision.
+    virtual u_result convertScanToCartesian(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, float * x_mm, float * y_mm) = 0;
+
     virtual ~RPlidarDriver() {}
 protected:
     RPlidarDriver(){}
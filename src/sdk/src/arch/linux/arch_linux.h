@@ -58,6 +58,8 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/select.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <time.h>
 
 #include "timer.h"
@@ -46,7 +46,9 @@
 #include <time.h>
 #include "hal/types.h"
 #include "arch/linux/net_serial.h"
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <limits.h>
 
 #include <algorithm>
 //__GNUC__
@@ -55,6 +57,7 @@
 #include <asm/ioctls.h>
 #include <asm/termbits.h>
 #include <sys/ioctl.h>
+#include <linux/serial.h>
 extern "C" int tcflush(int fildes, int queue_selector);
 #else
 // for other standard UNIX
@@ -198,6 +201,10 @@ bool raw_serial::open(const char * portname, uint32_t baudrate, uint32_t flags)
     _is_serial_opened = true;
     _operation_aborted = false;
 
+    if (flags & FLAG_LOW_LATENCY) {
+        _applyLowLatency(portname);
+    }
+
     //Clear the DTR bit to let the motor spin
     clearDTR();
     do {
@@ -221,12 +228,34 @@ bool raw_serial::open(const char * portname, uint32_t baudrate, uint32_t flags)
             break;
 
     } while (0);
+
+    _vmin = 0;
+    _epoll_fd = epoll_create(2);
+    if (_epoll_fd == -1) {
+        close();
+        return false;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = serial_fd;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, serial_fd, &ev) == -1) {
+        close();
+        return false;
+    }
+    if (_selfpipe[0] != -1) {
+        ev.data.fd = _selfpipe[0];
+        epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _selfpipe[0], &ev);
+    }
     
     return true;
 }
 
 void raw_serial::close()
 {
+    _restoreLowLatency();
+
     if (serial_fd != -1)
         ::close(serial_fd);
     serial_fd = -1;
@@ -239,28 +268,57 @@ void raw_serial::close()
 
     _selfpipe[0] = _selfpipe[1] = -1;
 
+    if (_epoll_fd != -1)
+        ::close(_epoll_fd);
+    _epoll_fd = -1;
+
     _operation_aborted = false;
     _is_serial_opened = false;
 }
 
+// The port is non-blocking (FNDELAY): when the transmit queue is full, poll until it
+// drains, within SERIAL_TX_TIMEOUT for the whole buffer. cancelOperation aborts the wait.
+// Returns the number of bytes actually queued.
 int raw_serial::senddata(const unsigned char * data, size_t size)
 {
-// FIXME: non-block io should be used
     if (!isOpened()) return 0;
 
     if (data == NULL || size ==0) return 0;
     
+    _u64 deadline = getus() + (_u64)SERIAL_TX_TIMEOUT * 1000;
     size_t tx_len = 0;
     required_tx_cnt = 0;
-    do {
+    while (tx_len < size) {
         int ans = ::write(serial_fd, data + tx_len, size-tx_len);
         
-        if (ans == -1) return tx_len;
-        
-        tx_len += ans;
-        required_tx_cnt = tx_len;
-    }while (tx_len<size);
-    
+        if (ans > 0) {
+            tx_len += ans;
+            required_tx_cnt = tx_len;
+            continue;
+        }
+        if (ans == -1 && errno == EINTR) continue;
+        if (ans == -1 && errno != EAGAIN && errno != EWOULDBLOCK) break;
+
+        _u64 now = getus();
+        if (now >= deadline) break;
+
+        struct pollfd fds[2];
+        int nfds = 1;
+        fds[0].fd = serial_fd;
+        fds[0].events = POLLOUT;
+        if (_selfpipe[0] != -1) {
+            fds[1].fd = _selfpipe[0];
+            fds[1].events = POLLIN;
+            ++nfds;
+        }
+
+        int ret = poll(fds, nfds, (int)((deadline - now + 999) / 1000));
+        if (ret == -1 && errno != EINTR) break;
+        if (ret <= 0) continue;
+        // the self pipe is left for waitfordata to drain
+        if (nfds > 1 && (fds[1].revents & POLLIN)) break;
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) break;
+    }
     
     return tx_len;
 }
@@ -297,95 +355,119 @@ int raw_serial::waitforrecv(_u32 timeout, size_t * returned_size)
     return 0;
 }
 
+// In non-canonical mode with VTIME = 0, poll on a tty only reports it readable
+// once VMIN bytes are queued: epoll wakes up when the frame is complete instead
+// of at its first byte. Reads are non-blocking (FNDELAY) and are not affected.
+bool raw_serial::_setReadThreshold(size_t data_count)
+{
+    int vmin = (int)std::min<size_t>(data_count, UCHAR_MAX);
+    if (vmin < 1) vmin = 1;
+    if (vmin == _vmin) return true;
+
+#if !defined(__GNUC__)
+    struct termios options;
+    if (tcgetattr(serial_fd, &options)) return false;
+    options.c_cc[VMIN] = vmin;
+    options.c_cc[VTIME] = 0;
+    if (tcsetattr(serial_fd, TCSANOW, &options)) return false;
+#else
+    struct termios2 tio;
+    if (ioctl(serial_fd, TCGETS2, &tio) == -1) return false;
+    tio.c_cc[VMIN] = vmin;
+    tio.c_cc[VTIME] = 0;
+    if (ioctl(serial_fd, TCSETS2, &tio) == -1) return false;
+#endif
+    _vmin = vmin;
+    return true;
+}
+
+// epoll_wait until the deadline, to the microsecond with epoll_pwait2 (Linux 5.11),
+// to the millisecond above on older kernels
+static int epoll_wait_until(int epfd, struct epoll_event * events, int maxevents, _u64 deadline, _u64 now)
+{
+#ifdef SYS_epoll_pwait2
+    static volatile bool pwait2_missing = false;
+    if (!pwait2_missing) {
+        struct timespec wait_time;
+        struct timespec * timeout = NULL;
+        if (deadline != (_u64)-1) {
+            wait_time.tv_sec = (time_t)((deadline - now) / 1000000);
+            wait_time.tv_nsec = (long)((deadline - now) % 1000000) * 1000;
+            timeout = &wait_time;
+        }
+        int n = (int)syscall(SYS_epoll_pwait2, epfd, events, maxevents, timeout, NULL, 0);
+        // not there, or filtered out by a seccomp policy
+        if (n >= 0 || (errno != ENOSYS && errno != EPERM)) return n;
+        pwait2_missing = true;
+    }
+#endif
+    int timeout_ms = -1;
+    if (deadline != (_u64)-1) timeout_ms = (int)std::min<_u64>((deadline - now + 999) / 1000, INT_MAX);
+    return epoll_wait(epfd, events, maxevents, timeout_ms);
+}
+
 int raw_serial::waitfordata(size_t data_count, _u32 timeout, size_t * returned_size)
 {
-    _u32 startTs = getms();
+    return waitfordataUntil(data_count, (timeout == (_u32)-1) ? (_u64)-1 : getus() + (_u64)timeout * 1000, returned_size);
+}
+
+int raw_serial::waitfordataUntil(size_t data_count, _u64 deadline, size_t * returned_size)
+{
     size_t length = 0;
     if (returned_size==NULL) returned_size=(size_t *)&length;
     *returned_size = 0;
 
-    int max_fd;
-    fd_set input_set;
-    struct timeval timeout_val;
-
-    /* Initialize the input set */
-    FD_ZERO(&input_set);
-    FD_SET(serial_fd, &input_set);
-
-    if (_selfpipe[0] != -1)
-        FD_SET(_selfpipe[0], &input_set);
-
-    max_fd =  std::max<int>(serial_fd, _selfpipe[0]) + 1;
+    if (!isOpened()) return ANS_DEV_ERR;
 
-    /* Initialize the timeout structure */
-    timeout_val.tv_sec = timeout / 1000;
-    timeout_val.tv_usec = (timeout % 1000) * 1000;
+    // without the threshold, epoll still works but wakes up on every chunk
+    _setReadThreshold(data_count);
 
-    if ( isOpened() )
+    while ( isOpened() )
     {
         if ( ioctl(serial_fd, FIONREAD, returned_size) == -1) return ANS_DEV_ERR;
         if (*returned_size >= data_count)
         {
             return 0;
         }
-    }
 
-    while ( isOpened() )
-    {
-        if ((getms() - startTs) > timeout) {
+        _u64 now = getus();
+        if (now >= deadline) {
             return ANS_TIMEOUT;
         }
+        if (*returned_size >= (size_t)_vmin && _vmin == UCHAR_MAX) {
+            // more than VMIN can express: the port stays readable, sleep for the bytes missing
+            _u64 expect_remain_time = (_u64)(data_count - *returned_size) * 1000000 * 8 / _baudrate;
+            usleep((useconds_t)std::min<_u64>(expect_remain_time, deadline - now));
+            continue;
+        }
 
-        /* Do the select */
-        int n = ::select(max_fd, &input_set, NULL, NULL, &timeout_val);
+        struct epoll_event events[2];
+        int n = epoll_wait_until(_epoll_fd, events, 2, deadline, now);
 
         if (n < 0)
         {
-            // select error
+            if (errno == EINTR) continue;
             *returned_size =  0;
             return ANS_DEV_ERR;
         }
-        else if (n == 0)
-        {
-            // time out
-            *returned_size =0;
-            return ANS_TIMEOUT;
-        }
-        else
+
+        for (int i = 0; i < n; ++i)
         {
-            if (FD_ISSET(_selfpipe[0], &input_set)) {   
+            if (events[i].data.fd == _selfpipe[0]) {
                 // require aborting the current operation
                 int ch;
-                for (;;) {                    
+                for (;;) {
                     if (::read(_selfpipe[0], &ch, 1) == -1) {
                         break;
                     }
-                    
+
                 }
 
                 // treat as  timeout
                 *returned_size = 0;
                 return ANS_TIMEOUT;
             }
-
-            // data avaliable
-            assert (FD_ISSET(serial_fd, &input_set));
-
-
-            if ( ioctl(serial_fd, FIONREAD, returned_size) == -1) return ANS_DEV_ERR;
-            if (*returned_size >= data_count)
-            {
-                return 0;
-            }
-            else 
-            {
-                int remain_timeout = timeout_val.tv_sec*1000000 + timeout_val.tv_usec;
-                int expect_remain_time = (data_count - *returned_size)*1000000*8/_baudrate;
-                if (remain_timeout > expect_remain_time)
-                    usleep(expect_remain_time);
-            }
         }
-        
     }
 
     return ANS_DEV_ERR;
@@ -423,6 +505,85 @@ void raw_serial::_init()
     required_tx_cnt = required_rx_cnt = 0;
     _operation_aborted = false;
     _selfpipe[0] = _selfpipe[1] = -1;
+    _epoll_fd = -1;
+    _vmin = 0;
+    _low_latency_status = 0;
+    _saved_serial_flags = 0;
+    _saved_latency_timer = -1;
+    _latency_timer_path[0] = 0;
+}
+
+static int _readSysfsInt(const char * path)
+{
+    FILE * file = fopen(path, "r");
+    if (!file) return -1;
+    int value = -1;
+    if (fscanf(file, "%d", &value) != 1) value = -1;
+    fclose(file);
+    return value;
+}
+
+static bool _writeSysfsInt(const char * path, int value)
+{
+    FILE * file = fopen(path, "w");
+    if (!file) return false;
+    bool written = fprintf(file, "%d", value) > 0;
+    // sysfs reports a rejected value when the file is closed
+    return (fclose(file) == 0) && written;
+}
+
+// Every step is optional: the port works the same without them, only the delivery
+// of the bytes is delayed. getLowLatencyStatus tells what could be applied.
+void raw_serial::_applyLowLatency(const char * portname)
+{
+    _low_latency_status = 0;
+
+    // ask the tty layer to push the received bytes right away (honoured by most USB serial drivers)
+#if defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+    struct serial_struct serial;
+    if (ioctl(serial_fd, TIOCGSERIAL, &serial) != -1) {
+        _saved_serial_flags = serial.flags;
+        serial.flags |= ASYNC_LOW_LATENCY;
+        if (ioctl(serial_fd, TIOCSSERIAL, &serial) != -1) {
+            _low_latency_status |= LOW_LATENCY_ASYNC;
+        }
+    }
+#endif
+
+    // FTDI adapters hold the bytes up to their latency timer, 16ms by default.
+    // The attribute only exists for them and is usually writable by root only.
+    char devicePath[PATH_MAX];
+    if (!realpath(portname, devicePath)) return;
+    const char * deviceName = strrchr(devicePath, '/');
+    deviceName = deviceName ? deviceName + 1 : devicePath;
+    int pathLength = snprintf(_latency_timer_path, sizeof(_latency_timer_path), "/sys/bus/usb-serial/devices/%.64s/latency_timer", deviceName);
+    if (pathLength < 0 || pathLength >= (int)sizeof(_latency_timer_path)) return;
+
+    int latencyTimer = _readSysfsInt(_latency_timer_path);
+    if (latencyTimer == 1) {
+        _low_latency_status |= LOW_LATENCY_TIMER;
+    } else if (latencyTimer > 1 && _writeSysfsInt(_latency_timer_path, 1)) {
+        _saved_latency_timer = latencyTimer;
+        _low_latency_status |= LOW_LATENCY_TIMER;
+    }
+}
+
+void raw_serial::_restoreLowLatency()
+{
+#if defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+    if ((_low_latency_status & LOW_LATENCY_ASYNC) && !(_saved_serial_flags & ASYNC_LOW_LATENCY) && serial_fd != -1) {
+        struct serial_struct serial;
+        if (ioctl(serial_fd, TIOCGSERIAL, &serial) != -1) {
+            serial.flags &= ~ASYNC_LOW_LATENCY;
+            ioctl(serial_fd, TIOCSSERIAL, &serial);
+        }
+    }
+#endif
+    if (_saved_latency_timer != -1) {
+        _writeSysfsInt(_latency_timer_path, _saved_latency_timer);
+    }
+    _low_latency_status = 0;
+    _saved_latency_timer = -1;
 }
 
 void raw_serial::cancelOperation()
@@ -433,6 +594,16 @@ void raw_serial::cancelOperation()
     ::write(_selfpipe[1], "x", 1);
 }
 
+void raw_serial::resumeOperation()
+{
+    _operation_aborted = false;
+    if (_selfpipe[0] == -1) return;
+
+    // the wakes no wait took
+    char ch;
+    while (::read(_selfpipe[0], &ch, 1) == 1) {}
+}
+
 _u32 raw_serial::getTermBaudBitmap(_u32 baud)
 {
 #define BAUD_CONV( _baud_) case _baud_:  return B##_baud_ 
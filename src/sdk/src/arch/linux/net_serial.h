@@ -44,6 +44,7 @@ public:
     enum{
         SERIAL_RX_BUFFER_SIZE = 512,
         SERIAL_TX_BUFFER_SIZE = 128,
+        SERIAL_TX_TIMEOUT = 100,    // ms, longest senddata can wait for the transmit queue
     };
 
     raw_serial();
@@ -54,6 +55,7 @@ public:
     virtual void flush( _u32 flags);
     
     virtual int waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL);
+    virtual int waitfordataUntil(size_t data_count, _u64 deadline_us, size_t * returned_size = NULL);
 
     virtual int senddata(const unsigned char * data, size_t size);
     virtual int recvdata(unsigned char * data, size_t size);
@@ -68,11 +70,18 @@ public:
 
     _u32 getTermBaudBitmap(_u32 baud);
 
+    virtual bool canCancelOperation() { return _selfpipe[0] != -1; }
     virtual void cancelOperation();
+    virtual void resumeOperation();
+
+    virtual _u32 getLowLatencyStatus() { return _low_latency_status; }
 
 protected:
     bool open(const char * portname, uint32_t baudrate, uint32_t flags = 0);
     void _init();
+    bool _setReadThreshold(size_t data_count);
+    void _applyLowLatency(const char * portname);
+    void _restoreLowLatency();
 
     char _portName[200];
     uint32_t _baudrate;
@@ -85,6 +94,17 @@ protected:
 
     int    _selfpipe[2];
     bool   _operation_aborted;
+
+    // waitfordata sleeps in epoll on the port and the self pipe. The port is
+    // reported readable once VMIN bytes are queued, VMIN follows data_count.
+    int    _epoll_fd;
+    int    _vmin;
+
+    // FLAG_LOW_LATENCY, the previous settings are restored on close
+    _u32   _low_latency_status;
+    int    _saved_serial_flags;
+    int    _saved_latency_timer;
+    char   _latency_timer_path[256];
 };
 
 }}}
@@ -313,6 +313,73 @@ namespace rp { namespace arch { namespace net{
 
 using namespace rp::net;
 
+// Self pipe the waits for data select() on next to the socket, so another thread
+// can end them: cancel() leaves a byte in it until resume() drains it
+class SocketSelfPipe
+{
+public:
+    SocketSelfPipe()
+    {
+        if (pipe2(_fds, O_NONBLOCK | O_CLOEXEC) == -1) _fds[0] = _fds[1] = -1;
+    }
+    ~SocketSelfPipe()
+    {
+        if (_fds[0] != -1) ::close(_fds[0]);
+        if (_fds[1] != -1) ::close(_fds[1]);
+    }
+
+    int fd() const { return _fds[0]; }
+    bool isValid() const { return _fds[0] != -1; }
+
+    void cancel()
+    {
+        if (_fds[1] == -1) return;
+        ::write(_fds[1], "x", 1);
+    }
+
+    void resume()
+    {
+        if (_fds[0] == -1) return;
+        char ch;
+        while (::read(_fds[0], &ch, 1) == 1) {}
+    }
+
+protected:
+    int _fds[2];
+};
+
+// select() on the socket and the self pipe, to the microsecond
+static u_result wait_readable_until(int socket_fd, const SocketSelfPipe & selfpipe, _u64 deadline_us)
+{
+    fd_set rdset;
+    FD_ZERO(&rdset);
+    FD_SET(socket_fd, &rdset);
+    int maxfd = socket_fd;
+    if (selfpipe.fd() != -1) {
+        FD_SET(selfpipe.fd(), &rdset);
+        if (selfpipe.fd() > maxfd) maxfd = selfpipe.fd();
+    }
+
+    timeval tv;
+    timeval * ptv = NULL;
+    if (deadline_us != (_u64)-1) {
+        _u64 now = getus();
+        _u64 remaining = (deadline_us > now) ? deadline_us - now : 0;
+        tv.tv_sec = (time_t)(remaining / 1000000);
+        tv.tv_usec = (suseconds_t)(remaining % 1000000);
+        ptv = &tv;
+    }
+    int ans = ::select(maxfd+1, &rdset, NULL, NULL, ptv);
+
+    if (ans < 0) {
+        delay(0); //relax cpu
+        return RESULT_OPERATION_FAIL;
+    }
+    // a cancelled wait is treated as a timeout
+    if (ans == 0 || !FD_ISSET(socket_fd, &rdset)) return RESULT_OPERATION_TIMEOUT;
+    return RESULT_OK;
+}
+
 class _single_thread StreamSocketImpl : public StreamSocket
 {
 public:
@@ -543,6 +610,22 @@ public:
         return ::setsockopt( _socket_fd, IPPROTO_TCP, TCP_NODELAY,&bool_true, sizeof(bool_true) )?RESULT_OPERATION_FAIL:RESULT_OK;
     }
 
+    virtual u_result setReceiveBufferSize(size_t size)
+    {
+        int bufsize = (int)size;
+        return ::setsockopt( _socket_fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize) )?RESULT_OPERATION_FAIL:RESULT_OK;
+    }
+
+    virtual u_result setBusyPoll(_u32 timeout_us)
+    {
+#ifdef SO_BUSY_POLL
+        int busy_poll = (int)timeout_us;
+        return ::setsockopt( _socket_fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll) )?RESULT_OPERATION_FAIL:RESULT_OK;
+#else
+        return RESULT_OPERATION_NOT_SUPPORT;
+#endif
+    }
+
     virtual u_result waitforSent(_u32 timeout ) 
     {
         fd_set wrset;
@@ -569,30 +652,32 @@ public:
 
     virtual u_result waitforData(_u32 timeout )
     {
-        fd_set rdset;
-        FD_ZERO(&rdset);
-        FD_SET(_socket_fd, &rdset);
+        return waitforDataUntil(getus() + (_u64)timeout * 1000);
+    }
 
-        timeval tv;
-        tv.tv_sec = timeout / 1000;
-        tv.tv_usec = (timeout % 1000) * 1000;
-        int ans = ::select(_socket_fd+1, &rdset, NULL, NULL, &tv);
+    virtual u_result waitforDataUntil(_u64 deadline_us)
+    {
+        return wait_readable_until(_socket_fd, _selfpipe, deadline_us);
+    }
 
-        switch (ans) {
-            case 1:
-                // fired
-                return RESULT_OK;
-            case 0:
-                // timeout
-                return RESULT_OPERATION_TIMEOUT;
-            default:
-                delay(0); //relax cpu
-                return RESULT_OPERATION_FAIL;
-        }
+    virtual bool canCancelOperation()
+    {
+        return _selfpipe.isValid();
+    }
+
+    virtual void cancelOperation()
+    {
+        _selfpipe.cancel();
+    }
+
+    virtual void resumeOperation()
+    {
+        _selfpipe.resume();
     }
 
 protected:
     int  _socket_fd;
+    SocketSelfPipe _selfpipe;
 
 
 };
@@ -695,26 +780,27 @@ public:
 
     virtual u_result waitforData(_u32 timeout )
     {
-        fd_set rdset;
-        FD_ZERO(&rdset);
-        FD_SET(_socket_fd, &rdset);
+        return waitforDataUntil(getus() + (_u64)timeout * 1000);
+    }
 
-        timeval tv;
-        tv.tv_sec = timeout / 1000;
-        tv.tv_usec = (timeout % 1000) * 1000;
-        int ans = ::select(_socket_fd+1, &rdset, NULL, NULL, &tv);
+    virtual u_result waitforDataUntil(_u64 deadline_us)
+    {
+        return wait_readable_until(_socket_fd, _selfpipe, deadline_us);
+    }
 
-        switch (ans) {
-            case 1:
-                // fired
-                return RESULT_OK;
-            case 0:
-                // timeout
-                return RESULT_OPERATION_TIMEOUT;
-            default:
-                delay(0); //relax cpu
-                return RESULT_OPERATION_FAIL;
-        }
+    virtual bool canCancelOperation()
+    {
+        return _selfpipe.isValid();
+    }
+
+    virtual void cancelOperation()
+    {
+        _selfpipe.cancel();
+    }
+
+    virtual void resumeOperation()
+    {
+        _selfpipe.resume();
     }
 
     virtual u_result sendTo(const SocketAddress & target, const void * buffer, size_t len)
@@ -769,6 +855,33 @@ public:
 
     }
 
+    virtual u_result recvBatch(void * buf, size_t slotSize, size_t * lengths, size_t & count)
+    {
+        struct mmsghdr msgs[MAX_RECV_BATCH];
+        struct iovec   iovs[MAX_RECV_BATCH];
+        if (count > MAX_RECV_BATCH) count = MAX_RECV_BATCH;
+
+        memset(msgs, 0, sizeof(msgs[0]) * count);
+        for (size_t pos = 0; pos < count; ++pos) {
+            iovs[pos].iov_base = reinterpret_cast<_u8 *>(buf) + pos * slotSize;
+            iovs[pos].iov_len = slotSize;
+            msgs[pos].msg_hdr.msg_iov = &iovs[pos];
+            msgs[pos].msg_hdr.msg_iovlen = 1;
+        }
+
+        int ans = ::recvmmsg(_socket_fd, msgs, (unsigned int)count, MSG_DONTWAIT, NULL);
+        if (ans < 0) {
+            count = 0;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? RESULT_OK : RESULT_OPERATION_FAIL;
+        }
+
+        for (int pos = 0; pos < ans; ++pos) {
+            lengths[pos] = (msgs[pos].msg_hdr.msg_flags & MSG_TRUNC) ? slotSize + 1 : msgs[pos].msg_len;
+        }
+        count = ans;
+        return RESULT_OK;
+    }
+
 #if 0
     virtual u_result recvFromNoWait(void *buf, size_t len, size_t & recv_len, SocketAddress * sourceAddr)
     {
@@ -797,6 +910,7 @@ public:
     
 protected:
     int  _socket_fd;
+    SocketSelfPipe _selfpipe;
 
 };
 
@@ -35,6 +35,8 @@
 #include "arch/linux/arch_linux.h"
 
 #include <sched.h>
+#include <sys/mman.h>
+#include <alloca.h>
 
 namespace rp{ namespace hal{
 
@@ -72,27 +74,28 @@ u_result Thread::setPriority( priority_val_t p)
         return RESULT_OPERATION_FAIL;
     }   
 
-    //int pthread_priority = 0 ;
+    int pthread_priority_max = sched_get_priority_max(SCHED_RR);
+    int pthread_priority_min = sched_get_priority_min(SCHED_RR);
 
     switch(p)
     {
     case PRIORITY_REALTIME:
-        //pthread_priority = pthread_priority_max;
         current_policy = SCHED_RR;
+        current_param.sched_priority = pthread_priority_max;
         break;
     case PRIORITY_HIGH:
-        //pthread_priority = (pthread_priority_max + pthread_priority_min)/2;
         current_policy = SCHED_RR;
+        current_param.sched_priority = (pthread_priority_max + pthread_priority_min)/2;
         break;
     case PRIORITY_NORMAL:
     case PRIORITY_LOW:
     case PRIORITY_IDLE:
-        //pthread_priority = 0;
+        // the only priority of SCHED_OTHER
         current_policy = SCHED_OTHER;
+        current_param.sched_priority = 0;
         break;
     }
 
-    current_param.__sched_priority = current_policy;
     if ( (ans = pthread_setschedparam( (pthread_t) this->_handle, current_policy, &current_param)) )
     {
         return RESULT_OPERATION_FAIL;
@@ -126,11 +129,103 @@ Thread::priority_val_t Thread::getPriority()
     return PRIORITY_NORMAL;
 }
 
+static int to_posix_policy(Thread::sched_policy_t policy)
+{
+    switch (policy)
+    {
+    case Thread::SCHED_POLICY_FIFO:
+        return SCHED_FIFO;
+    case Thread::SCHED_POLICY_RR:
+        return SCHED_RR;
+    default:
+        return SCHED_OTHER;
+    }
+}
+
+bool Thread::getRealtimePriorityRange(sched_policy_t policy, int & minPriority, int & maxPriority)
+{
+    minPriority = sched_get_priority_min(to_posix_policy(policy));
+    maxPriority = sched_get_priority_max(to_posix_policy(policy));
+    return minPriority != -1 && maxPriority != -1;
+}
+
+u_result Thread::setRealtimePriority(sched_policy_t policy, int priority)
+{
+    if (!this->_handle) return RESULT_OPERATION_FAIL;
+
+    int minPriority, maxPriority;
+    if (policy == SCHED_POLICY_DEFAULT) priority = 0;
+    if (!getRealtimePriorityRange(policy, minPriority, maxPriority)) return RESULT_OPERATION_NOT_SUPPORT;
+    if (priority < minPriority || priority > maxPriority) return RESULT_INVALID_DATA;
+
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    // EPERM without CAP_SYS_NICE or an RLIMIT_RTPRIO allowing the priority
+    if (pthread_setschedparam((pthread_t)this->_handle, to_posix_policy(policy), &param))
+    {
+        return RESULT_OPERATION_FAIL;
+    }
+    return RESULT_OK;
+}
+
+u_result Thread::setAffinity(int cpu)
+{
+    if (!this->_handle) return RESULT_OPERATION_FAIL;
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return RESULT_INVALID_DATA;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    // EINVAL when the core is offline or outside the cpuset of the process
+    if (pthread_setaffinity_np((pthread_t)this->_handle, sizeof(cpus), &cpus))
+    {
+        return RESULT_OPERATION_FAIL;
+    }
+    return RESULT_OK;
+}
+
+u_result Thread::lockMemory()
+{
+    // EPERM or ENOMEM when RLIMIT_MEMLOCK is too low and the process lacks CAP_IPC_LOCK
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0 ? RESULT_OK : RESULT_OPERATION_FAIL;
+}
+
+void Thread::prefaultStack(size_t size)
+{
+    // the pages stay mapped once the frame is gone, and locked too after lockMemory()
+    volatile _u8 * stack = (volatile _u8 *)alloca(size);
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    for (size_t pos = 0; pos < size; pos += pageSize) stack[pos] = 0;
+}
+
 u_result Thread::join(unsigned long timeout)
 {
     if (!this->_handle) return RESULT_OK;
     
-    pthread_join((pthread_t)(this->_handle), NULL);
+    if (timeout == (unsigned long)-1) {
+        pthread_join((pthread_t)(this->_handle), NULL);
+    } else {
+        timespec wait_time;
+        int err;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 31))
+        _u64 deadline_us = getus() + (_u64)timeout * 1000;
+        wait_time.tv_sec = (time_t)(deadline_us / 1000000);
+        wait_time.tv_nsec = (long)(deadline_us % 1000000) * 1000;
+        err = pthread_clockjoin_np((pthread_t)(this->_handle), NULL, CLOCK_MONOTONIC, &wait_time);
+#else
+        timeval wall;
+        gettimeofday(&wall, NULL);
+        _u64 wait_us = (_u64)wall.tv_sec * 1000000 + wall.tv_usec + (_u64)timeout * 1000;
+        wait_time.tv_sec = (time_t)(wait_us / 1000000);
+        wait_time.tv_nsec = (long)(wait_us % 1000000) * 1000;
+        err = pthread_timedjoin_np((pthread_t)(this->_handle), NULL, &wait_time);
+#endif
+        if (err == ETIMEDOUT) return RESULT_OPERATION_TIMEOUT;
+        if (err) return RESULT_OPERATION_FAIL;
+    }
+    // a thread is joined once, the next join has nothing to wait for
+    this->_handle = 0;
     return RESULT_OK;
 }
 
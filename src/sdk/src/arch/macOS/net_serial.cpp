@@ -36,6 +36,7 @@
 #include "arch/macOS/net_serial.h"
 #include <termios.h>
 #include <sys/select.h>
+#include <errno.h>
 
 namespace rp{ namespace arch{ namespace net{
 
@@ -141,24 +142,41 @@ void raw_serial::close()
     _is_serial_opened = false;
 }
 
+// The port is non-blocking (FNDELAY): when the transmit queue is full, select until it
+// drains, within SERIAL_TX_TIMEOUT for the whole buffer.
+// Returns the number of bytes actually queued.
 int raw_serial::senddata(const unsigned char * data, _word_size_t size)
 {
-// FIXME: non-block io should be used
     if (!isOpened()) return 0;
 
     if (data == NULL || size ==0) return 0;
     
+    _u64 deadline = getus() + (_u64)SERIAL_TX_TIMEOUT * 1000;
     size_t tx_len = 0;
     required_tx_cnt = 0;
-    do {
+    while (tx_len < size) {
         int ans = ::write(serial_fd, data + tx_len, size-tx_len);
         
-        if (ans == -1) return tx_len;
-        
-        tx_len += ans;
-        required_tx_cnt = tx_len;
-    }while (tx_len<size);
-    
+        if (ans > 0) {
+            tx_len += ans;
+            required_tx_cnt = tx_len;
+            continue;
+        }
+        if (ans == -1 && errno == EINTR) continue;
+        if (ans == -1 && errno != EAGAIN && errno != EWOULDBLOCK) break;
+
+        _u64 now = getus();
+        if (now >= deadline) break;
+
+        fd_set output_set;
+        FD_ZERO(&output_set);
+        FD_SET(serial_fd, &output_set);
+        struct timeval timeout_val;
+        timeout_val.tv_sec = (deadline - now) / 1000000;
+        timeout_val.tv_usec = (deadline - now) % 1000000;
+
+        if (::select(serial_fd + 1, NULL, &output_set, NULL, &timeout_val) < 0 && errno != EINTR) break;
+    }
     
     return tx_len;
 }
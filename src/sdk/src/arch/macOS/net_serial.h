@@ -44,6 +44,7 @@ public:
     enum{
         SERIAL_RX_BUFFER_SIZE = 512,
         SERIAL_TX_BUFFER_SIZE = 128,
+        SERIAL_TX_TIMEOUT = 100,    // ms, longest senddata can wait for the transmit queue
     };
 
     raw_serial();
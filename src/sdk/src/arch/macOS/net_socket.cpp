@@ -544,6 +544,17 @@ public:
         return ::setsockopt( _socket_fd, IPPROTO_TCP, TCP_NODELAY,&bool_true, sizeof(bool_true) )?RESULT_OPERATION_FAIL:RESULT_OK;
     }
 
+    virtual u_result setReceiveBufferSize(size_t size)
+    {
+        int bufsize = (int)size;
+        return ::setsockopt( _socket_fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize) )?RESULT_OPERATION_FAIL:RESULT_OK;
+    }
+
+    virtual u_result setBusyPoll(_u32 timeout_us)
+    {
+        return timeout_us ? RESULT_OPERATION_NOT_SUPPORT : RESULT_OK;
+    }
+
     virtual u_result waitforSent(_u32 timeout ) 
     {
         fd_set wrset;
@@ -770,6 +781,31 @@ public:
 
     }
 
+    virtual u_result recvBatch(void * buf, size_t slotSize, size_t * lengths, size_t & count)
+    {
+        // no recvmmsg, one recvmsg per datagram
+        size_t received = 0;
+        while (received < count) {
+            struct iovec iov;
+            struct msghdr msg;
+            iov.iov_base = reinterpret_cast<_u8 *>(buf) + received * slotSize;
+            iov.iov_len = slotSize;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+
+            ssize_t ans = ::recvmsg(_socket_fd, &msg, MSG_DONTWAIT);
+            if (ans < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                count = received;
+                return received ? RESULT_OK : RESULT_OPERATION_FAIL;
+            }
+            lengths[received++] = (msg.msg_flags & MSG_TRUNC) ? slotSize + 1 : (size_t)ans;
+        }
+        count = received;
+        return RESULT_OK;
+    }
+
 #if 0
     virtual u_result recvFromNoWait(void *buf, size_t len, size_t & recv_len, SocketAddress * sourceAddr)
     {
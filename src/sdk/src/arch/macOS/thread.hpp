@@ -34,6 +34,9 @@
 
 #include "arch/macOS/arch_macOS.h"
 
+#include <sched.h>
+#include <alloca.h>
+
 namespace rp{ namespace hal{
 
 Thread Thread::create(thread_proc_t proc, void * data)
@@ -68,11 +71,71 @@ Thread::priority_val_t Thread::getPriority()
 	return PRIORITY_NORMAL;
 }
 
+static int to_posix_policy(Thread::sched_policy_t policy)
+{
+    switch (policy)
+    {
+    case Thread::SCHED_POLICY_FIFO:
+        return SCHED_FIFO;
+    case Thread::SCHED_POLICY_RR:
+        return SCHED_RR;
+    default:
+        return SCHED_OTHER;
+    }
+}
+
+bool Thread::getRealtimePriorityRange(sched_policy_t policy, int & minPriority, int & maxPriority)
+{
+    minPriority = sched_get_priority_min(to_posix_policy(policy));
+    maxPriority = sched_get_priority_max(to_posix_policy(policy));
+    return minPriority != -1 && maxPriority != -1;
+}
+
+u_result Thread::setRealtimePriority(sched_policy_t policy, int priority)
+{
+    if (!this->_handle) return RESULT_OPERATION_FAIL;
+
+    int minPriority, maxPriority;
+    if (!getRealtimePriorityRange(policy, minPriority, maxPriority)) return RESULT_OPERATION_NOT_SUPPORT;
+    if (policy == SCHED_POLICY_DEFAULT) priority = (minPriority + maxPriority) / 2;
+    if (priority < minPriority || priority > maxPriority) return RESULT_INVALID_DATA;
+
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    if (pthread_setschedparam((pthread_t)this->_handle, to_posix_policy(policy), &param))
+    {
+        return RESULT_OPERATION_FAIL;
+    }
+    return RESULT_OK;
+}
+
+u_result Thread::setAffinity(int cpu)
+{
+    // macOS only takes affinity hints (thread_policy_set), nothing pins a thread to a core
+    return RESULT_OPERATION_NOT_SUPPORT;
+}
+
+u_result Thread::lockMemory()
+{
+    // mlockall() is not implemented by macOS
+    return RESULT_OPERATION_NOT_SUPPORT;
+}
+
+void Thread::prefaultStack(size_t size)
+{
+    volatile _u8 * stack = (volatile _u8 *)alloca(size);
+    size_t pageSize = (size_t)getpagesize();
+    for (size_t pos = 0; pos < size; pos += pageSize) stack[pos] = 0;
+}
+
 u_result Thread::join(unsigned long timeout)
 {
     if (!this->_handle) return RESULT_OK;
     
+    // no timed join on macOS, the timeout is ignored
     pthread_join((pthread_t)(this->_handle), NULL);
+    this->_handle = 0;
     return RESULT_OK;
 }
 
@@ -55,3 +55,4 @@ _u32 rp_getms();
 }}
 
 #define getms() rp::arch::rp_getms()
+#define getus() rp::arch::rp_getus()
@@ -593,6 +593,17 @@ public:
         return ::setsockopt( _socket_fd, IPPROTO_TCP, TCP_NODELAY, (const char *)&bool_true, (int)sizeof(bool_true) )?RESULT_OPERATION_FAIL:RESULT_OK;
     }
 
+    virtual u_result setReceiveBufferSize(size_t size)
+    {
+        int bufsize = (int)size;
+        return ::setsockopt( _socket_fd, SOL_SOCKET, SO_RCVBUF, (const char *)&bufsize, (int)sizeof(bufsize) )?RESULT_OPERATION_FAIL:RESULT_OK;
+    }
+
+    virtual u_result setBusyPoll(_u32 timeout_us)
+    {
+        return timeout_us ? RESULT_OPERATION_NOT_SUPPORT : RESULT_OK;
+    }
+
     virtual u_result waitforSent(_u32 timeout ) 
     {
         fd_set wrset;
@@ -812,6 +823,26 @@ public:
 
     }
 
+    virtual u_result recvBatch(void * buf, size_t slotSize, size_t * lengths, size_t & count)
+    {
+        // no recvmmsg, one recvfrom per datagram while select reports more
+        size_t received = 0;
+        while (received < count && waitforData(0) == RESULT_OK) {
+            int ans = ::recvfrom(_socket_fd, (char *)buf + received * slotSize, (int)slotSize, 0, NULL, NULL);
+            if (ans == SOCKET_ERROR) {
+                if (WSAGetLastError() == WSAEMSGSIZE) {
+                    lengths[received++] = slotSize + 1;
+                    continue;
+                }
+                count = received;
+                return received ? RESULT_OK : RESULT_OPERATION_FAIL;
+            }
+            lengths[received++] = ans;
+        }
+        count = received;
+        return RESULT_OK;
+    }
+
 
     
 protected:
@@ -39,11 +39,12 @@
 namespace rp{ namespace arch{
 
 static LARGE_INTEGER _current_freq;
+static LARGE_INTEGER _current_freq_hz;
 
 void HPtimer_reset()
 {
-    BOOL ans=QueryPerformanceFrequency(&_current_freq);
-    _current_freq.QuadPart/=1000;
+    BOOL ans=QueryPerformanceFrequency(&_current_freq_hz);
+    _current_freq.QuadPart = _current_freq_hz.QuadPart/1000;
 }
 
 _u32 getHDTimer()
@@ -54,6 +55,16 @@ _u32 getHDTimer()
     return (_u32)(current.QuadPart/_current_freq.QuadPart);
 }
 
+_u64 getHDTimer_us()
+{
+    LARGE_INTEGER current;
+    QueryPerformanceCounter(&current);
+
+    // split the conversion so that the counter never overflows when scaled
+    return (_u64)(current.QuadPart / _current_freq_hz.QuadPart) * 1000000
+         + (_u64)(current.QuadPart % _current_freq_hz.QuadPart) * 1000000 / _current_freq_hz.QuadPart;
+}
+
 BEGIN_STATIC_CODE(timer_cailb)
 {
     HPtimer_reset();
@@ -34,6 +34,7 @@
 
 #include "sdkcommon.h"
 #include <process.h>
+#include <malloc.h>
 
 namespace rp{ namespace hal{
 
@@ -123,6 +124,56 @@ Thread::priority_val_t Thread::getPriority()
 	return PRIORITY_NORMAL;
 }
 
+// no real-time policy on Windows, both map to THREAD_PRIORITY_TIME_CRITICAL
+// with the POSIX range of priorities
+bool Thread::getRealtimePriorityRange(sched_policy_t policy, int & minPriority, int & maxPriority)
+{
+    minPriority = (policy == SCHED_POLICY_DEFAULT) ? 0 : 1;
+    maxPriority = (policy == SCHED_POLICY_DEFAULT) ? 0 : 99;
+    return true;
+}
+
+u_result Thread::setRealtimePriority(sched_policy_t policy, int priority)
+{
+    if (!this->_handle) return RESULT_OPERATION_FAIL;
+
+    int minPriority, maxPriority;
+    if (policy == SCHED_POLICY_DEFAULT) priority = 0;
+    getRealtimePriorityRange(policy, minPriority, maxPriority);
+    if (priority < minPriority || priority > maxPriority) return RESULT_INVALID_DATA;
+
+    int win_priority = (policy == SCHED_POLICY_DEFAULT) ? THREAD_PRIORITY_NORMAL : THREAD_PRIORITY_TIME_CRITICAL;
+    if (SetThreadPriority(reinterpret_cast<HANDLE>(this->_handle), win_priority))
+    {
+        return RESULT_OK;
+    }
+    return RESULT_OPERATION_FAIL;
+}
+
+u_result Thread::setAffinity(int cpu)
+{
+    if (!this->_handle) return RESULT_OPERATION_FAIL;
+    if (cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8)) return RESULT_INVALID_DATA;
+
+    if (SetThreadAffinityMask(reinterpret_cast<HANDLE>(this->_handle), (DWORD_PTR)1 << cpu))
+    {
+        return RESULT_OK;
+    }
+    return RESULT_OPERATION_FAIL;
+}
+
+u_result Thread::lockMemory()
+{
+    // VirtualLock() only locks given regions, nothing covers the whole process
+    return RESULT_OPERATION_NOT_SUPPORT;
+}
+
+void Thread::prefaultStack(size_t size)
+{
+    volatile _u8 * stack = (volatile _u8 *)_alloca(size);
+    for (size_t pos = 0; pos < size; pos += 4096) stack[pos] = 0;
+}
+
 u_result Thread::join(unsigned long timeout)
 {
     if (!this->_handle) return RESULT_OK;
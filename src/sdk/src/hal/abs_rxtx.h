@@ -47,6 +47,15 @@ public:
         ANS_DEV_ERR = -2,
     };
 
+    enum {
+        FLAG_LOW_LATENCY = 0x1,     // flags of bind(): favour latency over CPU load on USB adapters
+    };
+
+    enum {
+        LOW_LATENCY_ASYNC = 0x1,    // ASYNC_LOW_LATENCY set on the port
+        LOW_LATENCY_TIMER = 0x2,    // latency timer of the USB adapter set to 1ms
+    };
+
     static serial_rxtx * CreateRxTx();
     static void ReleaseRxTx( serial_rxtx * );
 
@@ -60,6 +69,15 @@ public:
     virtual void close()  = 0;
     
     virtual int waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL) = 0;
+    // deadline_us is a time of getus(), (_u64)-1 waits forever. Ports without a finer
+    // wait of their own wait for the time left rounded up to the millisecond
+    virtual int waitfordataUntil(size_t data_count, _u64 deadline_us, size_t * returned_size = NULL)
+    {
+        if (deadline_us == (_u64)-1) return waitfordata(data_count, -1, returned_size);
+
+        _u64 now = getus();
+        return waitfordata(data_count, (deadline_us > now) ? (_u32)((deadline_us - now + 999) / 1000) : 0, returned_size);
+    }
 
     virtual int senddata(const unsigned char * data, size_t size) = 0;
     virtual int recvdata(unsigned char * data, size_t size) = 0;
@@ -71,7 +89,15 @@ public:
 
     virtual void setDTR() = 0;
     virtual void clearDTR() = 0;
+    // cancelOperation wakes a waitfordata in progress, which returns ANS_TIMEOUT.
+    // A wake nobody took may end the next wait early until resumeOperation is called.
+    // Ports without canCancelOperation() let the wait run to its timeout
+    virtual bool canCancelOperation() { return false; }
     virtual void cancelOperation() {}
+    virtual void resumeOperation() {}
+
+    // LOW_LATENCY_xxx settings applied when the port was opened with FLAG_LOW_LATENCY
+    virtual _u32 getLowLatencyStatus() { return 0; }
 
     virtual bool isOpened()
     {
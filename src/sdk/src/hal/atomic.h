@@ -0,0 +1,102 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+namespace rp{ namespace hal{
+
+// Minimal atomic operations on 32-bit words, all of them act as full memory barriers.
+// They are meant for lock-free hand-over between the cache thread and its readers.
+
+static inline _u32 atomic_load(const volatile _u32 * target)
+{
+#ifdef _WIN32
+    return (_u32)InterlockedCompareExchange((volatile LONG *)target, 0, 0);
+#elif defined(__ATOMIC_SEQ_CST)
+    return __atomic_load_n(target, __ATOMIC_SEQ_CST);
+#else
+    return __sync_fetch_and_add(const_cast<volatile _u32 *>(target), 0);
+#endif
+}
+
+static inline void atomic_store(volatile _u32 * target, _u32 value)
+{
+#ifdef _WIN32
+    InterlockedExchange((volatile LONG *)target, (LONG)value);
+#elif defined(__ATOMIC_SEQ_CST)
+    __atomic_store_n(target, value, __ATOMIC_SEQ_CST);
+#else
+    __sync_synchronize();
+    *target = value;
+    __sync_synchronize();
+#endif
+}
+
+// returns the previous value
+static inline _u32 atomic_exchange(volatile _u32 * target, _u32 value)
+{
+#ifdef _WIN32
+    return (_u32)InterlockedExchange((volatile LONG *)target, (LONG)value);
+#elif defined(__ATOMIC_SEQ_CST)
+    return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+#else
+    __sync_synchronize();
+    return __sync_lock_test_and_set(target, value);
+#endif
+}
+
+// returns the previous value
+static inline _u32 atomic_fetch_add(volatile _u32 * target, _u32 delta)
+{
+#ifdef _WIN32
+    return (_u32)InterlockedExchangeAdd((volatile LONG *)target, (LONG)delta);
+#elif defined(__ATOMIC_SEQ_CST)
+    return __atomic_fetch_add(target, delta, __ATOMIC_SEQ_CST);
+#else
+    return __sync_fetch_and_add(target, delta);
+#endif
+}
+
+// stores desired only if the target still holds expected, returns true on success
+static inline bool atomic_compare_exchange(volatile _u32 * target, _u32 expected, _u32 desired)
+{
+#ifdef _WIN32
+    return (_u32)InterlockedCompareExchange((volatile LONG *)target, (LONG)desired, (LONG)expected) == expected;
+#elif defined(__ATOMIC_SEQ_CST)
+    return __atomic_compare_exchange_n(target, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#else
+    return __sync_bool_compare_and_swap(target, expected, desired);
+#endif
+}
+
+}}
@@ -35,6 +35,8 @@
 #pragma once
 namespace rp{ namespace hal{
 
+// On Linux the event is a futex word: set() and a wait() on a signalled event take no lock
+// and make no system call, and the waits sleep against CLOCK_MONOTONIC, the clock of getus().
 class Event
 {
 public:
@@ -49,14 +51,18 @@ public:
     Event(bool isAutoReset = true, bool isSignal = false)
 #ifdef _WIN32
         : _event(NULL)
-#else
+#elif defined(_MACOS)
         : _is_signalled(isSignal)
         , _isAutoReset(isAutoReset)
+#else
+        : _state(isSignal ? 1 : 0)
+        , _waiters(0)
+        , _isAutoReset(isAutoReset)
 #endif
     {
 #ifdef _WIN32
         _event = CreateEvent(NULL, isAutoReset?FALSE:TRUE, isSignal?TRUE:FALSE, NULL); 
-#else
+#elif defined(_MACOS)
         pthread_mutex_init(&_cond_locker, NULL);
         pthread_cond_init(&_cond_var, NULL);
 #endif
@@ -72,7 +78,7 @@ public:
         if (isSignal){
 #ifdef _WIN32
             SetEvent(_event);
-#else
+#elif defined(_MACOS)
             pthread_mutex_lock(&_cond_locker);
                
             if ( _is_signalled == false )
@@ -81,24 +87,47 @@ public:
                 pthread_cond_signal(&_cond_var);
             }
             pthread_mutex_unlock(&_cond_locker);
+#else
+            if (atomic_exchange(&_state, 1) == 0 && atomic_load(&_waiters)) {
+                syscall(SYS_futex, &_state, FUTEX_WAKE_PRIVATE, _isAutoReset ? 1 : 0x7FFFFFFF, NULL, NULL, 0);
+            }
 #endif
         }
         else
         {
 #ifdef _WIN32
             ResetEvent(_event);
-#else
+#elif defined(_MACOS)
             pthread_mutex_lock(&_cond_locker);
             _is_signalled = false;
             pthread_mutex_unlock(&_cond_locker);
+#else
+            atomic_store(&_state, 0);
 #endif
         }
     }
     
     unsigned long wait( unsigned long timeout = 0xFFFFFFFF )
     {
+#if !defined(_WIN32) && !defined(_MACOS)
+        // signalled already, no need for the clock
+        if (_tryConsume()) return EVENT_OK;
+#endif
+        if (timeout == 0xFFFFFFFF) return waitUntil((_u64)-1);
+        return waitUntil(getus() + (_u64)timeout * 1000);
+    }
+
+    // deadline_us is a time of getus(), (_u64)-1 waits forever
+    unsigned long waitUntil( _u64 deadline_us )
+    {
 #ifdef _WIN32
-        switch (WaitForSingleObject(_event, timeout==0xFFFFFFF?INFINITE:(DWORD)timeout))
+        DWORD timeout = INFINITE;
+        if (deadline_us != (_u64)-1) {
+            _u64 now = getus();
+            // rounded up, not to come back before the deadline
+            timeout = (deadline_us > now) ? (DWORD)((deadline_us - now + 999) / 1000) : 0;
+        }
+        switch (WaitForSingleObject(_event, timeout))
         {
         case WAIT_FAILED:
             return EVENT_FAILED;
@@ -108,48 +137,36 @@ public:
             return EVENT_TIMEOUT;
         }
         return EVENT_OK;
-#else
+#elif defined(_MACOS)
+        // no monotonic clock for the condition variable here, the deadline becomes a wall clock one
+        timespec wait_time;
+        if (deadline_us != (_u64)-1) {
+            _u64 now = getus();
+            _u64 timeout_us = (deadline_us > now) ? deadline_us - now : 0;
+            timeval wall;
+            gettimeofday(&wall, NULL);
+
+            _u64 wait_us = (_u64)wall.tv_sec * 1000000 + wall.tv_usec + timeout_us;
+            wait_time.tv_sec = (time_t)(wait_us / 1000000);
+            wait_time.tv_nsec = (long)(wait_us % 1000000) * 1000;
+        }
+
         unsigned long ans = EVENT_OK;
         pthread_mutex_lock( &_cond_locker );
 
-        if ( !_is_signalled )
+        // another waiter may take the signal first, or the wake up be spurious: check again
+        while ( !_is_signalled )
         {
-            
-                if (timeout == 0xFFFFFFFF){
-                    pthread_cond_wait(&_cond_var,&_cond_locker);
-                }else
-                {
-                    timespec wait_time;
-                    timeval now;
-                    gettimeofday(&now,NULL);
-
-                    wait_time.tv_sec = timeout/1000 + now.tv_sec;
-                    wait_time.tv_nsec = (timeout%1000)*1000000ULL + now.tv_usec*1000;
-                
-                    if (wait_time.tv_nsec >= 1000000000)
-                    {
-                       ++wait_time.tv_sec;
-                       wait_time.tv_nsec -= 1000000000;
-                    }
-                    switch (pthread_cond_timedwait(&_cond_var,&_cond_locker,&wait_time))
-                    {
-                    case 0:
-                        // signalled
-                        break;
-                    case ETIMEDOUT:
-                        // time up
-                        ans = EVENT_TIMEOUT;
-                        goto _final;
-                        break;
-                    default:
-                        ans = EVENT_FAILED;
-                        goto _final;
-                    }
-       
+            int err = (deadline_us == (_u64)-1) ? pthread_cond_wait(&_cond_var, &_cond_locker)
+                                                : pthread_cond_timedwait(&_cond_var, &_cond_locker, &wait_time);
+            if (err == ETIMEDOUT) {
+                ans = EVENT_TIMEOUT;
+                goto _final;
+            } else if (err) {
+                ans = EVENT_FAILED;
+                goto _final;
             }
         }
-          
-        assert(_is_signalled);
 
         if ( _isAutoReset )
         {
@@ -159,16 +176,47 @@ _final:
         pthread_mutex_unlock( &_cond_locker );
 
         return ans;
+#else
+        timespec wait_time;
+        if (deadline_us != (_u64)-1) {
+            wait_time.tv_sec = (time_t)(deadline_us / 1000000);
+            wait_time.tv_nsec = (long)(deadline_us % 1000000) * 1000;
+        }
+
+        for (;;) {
+            if (_tryConsume()) return EVENT_OK;
+
+            atomic_fetch_add(&_waiters, 1);
+            // sleeps unless the event got signalled in between, FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC deadline
+            long err = syscall(SYS_futex, &_state, FUTEX_WAIT_BITSET_PRIVATE, 0,
+                               (deadline_us == (_u64)-1) ? NULL : &wait_time, NULL, FUTEX_BITSET_MATCH_ANY);
+            int errCode = errno;
+            atomic_fetch_add(&_waiters, (_u32)-1);
+
+            if (err && errCode == ETIMEDOUT) {
+                return _tryConsume() ? EVENT_OK : EVENT_TIMEOUT;
+            } else if (err && errCode != EAGAIN && errCode != EINTR) {
+                return EVENT_FAILED;
+            }
+        }
 #endif
         
     }
 protected:
 
+#if !defined(_WIN32) && !defined(_MACOS)
+    bool _tryConsume()
+    {
+        if (_isAutoReset) return atomic_compare_exchange(&_state, 1, 0);
+        return atomic_load(&_state) != 0;
+    }
+#endif
+
     void release()
     {
 #ifdef _WIN32
         CloseHandle(_event);
-#else
+#elif defined(_MACOS)
         pthread_mutex_destroy(&_cond_locker);
         pthread_cond_destroy(&_cond_var);
 #endif
@@ -176,11 +224,15 @@ protected:
 
 #ifdef _WIN32
         HANDLE _event;
-#else
+#elif defined(_MACOS)
         pthread_cond_t         _cond_var;
         pthread_mutex_t        _cond_locker;
         bool                   _is_signalled;
         bool                   _isAutoReset;
+#else
+        volatile _u32          _state;      // 1 when signalled
+        volatile _u32          _waiters;    // threads in or about to enter FUTEX_WAIT
+        bool                   _isAutoReset;
 #endif
 };
 }}
@@ -58,9 +58,21 @@ public:
     }
 
     Locker::LOCK_STATUS lock(unsigned long timeout = 0xFFFFFFFF)
+    {
+        if (timeout == 0xFFFFFFFF) return lockUntil((_u64)-1);
+        return lockUntil(getus() + (_u64)timeout * 1000);
+    }
+
+    // deadline_us is a time of getus(), (_u64)-1 waits forever
+    Locker::LOCK_STATUS lockUntil(_u64 deadline_us)
     {
 #ifdef _WIN32
-        switch (WaitForSingleObject(_lock, timeout==0xFFFFFFF?INFINITE:(DWORD)timeout))
+        DWORD timeout = INFINITE;
+        if (deadline_us != (_u64)-1) {
+            _u64 now = getus();
+            timeout = (deadline_us > now) ? (DWORD)((deadline_us - now + 999) / 1000) : 0;
+        }
+        switch (WaitForSingleObject(_lock, timeout))
         {
         case WAIT_ABANDONED:
             return LOCK_FAILED;
@@ -71,41 +83,42 @@ public:
         }
 
 #else
-#ifdef _MACOS
-        if (timeout !=0 ) {
+        if (deadline_us == (_u64)-1) {
             if (pthread_mutex_lock(&_lock) == 0) return LOCK_OK;
+            return LOCK_FAILED;
         }
-#else
-        if (timeout == 0xFFFFFFFF){
+#ifdef _MACOS
+        // no timed lock here, any wait blocks until the lock is taken
+        if (deadline_us > getus()) {
             if (pthread_mutex_lock(&_lock) == 0) return LOCK_OK;
+        } else if (pthread_mutex_trylock(&_lock) == 0) {
+            return LOCK_OK;
         }
+#else
+        timespec wait_time;
+        int err;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+        // against CLOCK_MONOTONIC, a step of the wall clock does not change the wait
+        wait_time.tv_sec = (time_t)(deadline_us / 1000000);
+        wait_time.tv_nsec = (long)(deadline_us % 1000000) * 1000;
+        err = pthread_mutex_clocklock(&_lock, CLOCK_MONOTONIC, &wait_time);
+#else
+        _u64 now = getus();
+        _u64 timeout_us = (deadline_us > now) ? deadline_us - now : 0;
+        timeval wall;
+        gettimeofday(&wall, NULL);
+
+        _u64 wait_us = (_u64)wall.tv_sec * 1000000 + wall.tv_usec + timeout_us;
+        wait_time.tv_sec = (time_t)(wait_us / 1000000);
+        wait_time.tv_nsec = (long)(wait_us % 1000000) * 1000;
+        err = pthread_mutex_timedlock(&_lock, &wait_time);
 #endif
-        else if (timeout == 0)
+        switch (err)
         {
-            if (pthread_mutex_trylock(&_lock) == 0) return LOCK_OK;
-        }
-#ifndef _MACOS
-        else
-        {
-            timespec wait_time;
-            timeval now;
-            gettimeofday(&now,NULL);
-
-            wait_time.tv_sec = timeout/1000 + now.tv_sec;
-            wait_time.tv_nsec = (timeout%1000)*1000000 + now.tv_usec*1000;
-        
-            if (wait_time.tv_nsec >= 1000000000)
-            {
-               ++wait_time.tv_sec;
-               wait_time.tv_nsec -= 1000000000;
-            }
-            switch (pthread_mutex_timedlock(&_lock,&wait_time))
-            {
-            case 0:
-                return LOCK_OK;
-            case ETIMEDOUT:
-                return LOCK_TIMEOUT;
-            }
+        case 0:
+            return LOCK_OK;
+        case ETIMEDOUT:
+            return LOCK_TIMEOUT;
         }
 #endif
 #endif
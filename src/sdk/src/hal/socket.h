@@ -90,6 +90,23 @@ public:
 
     virtual u_result waitforSent(_u32 timeout  = DEFAULT_SOCKET_TIMEOUT) = 0;
     virtual u_result waitforData(_u32 timeout  = DEFAULT_SOCKET_TIMEOUT)  = 0;
+
+    // deadline_us is a time of getus(), (_u64)-1 waits forever. Sockets without a finer
+    // wait of their own wait for the time left rounded up to the millisecond
+    virtual u_result waitforDataUntil(_u64 deadline_us)
+    {
+        if (deadline_us == (_u64)-1) return waitforData(-1);
+
+        _u64 now = getus();
+        return waitforData((deadline_us > now) ? (_u32)((deadline_us - now + 999) / 1000) : 0);
+    }
+
+    // cancelOperation ends the wait for data in progress and the later ones with
+    // RESULT_OPERATION_TIMEOUT until resumeOperation is called. Sockets that cannot
+    // be woken, canCancelOperation() false, wait until their deadline.
+    virtual bool canCancelOperation() { return false; }
+    virtual void cancelOperation() {}
+    virtual void resumeOperation() {}
 protected:
     SocketBase() {} 
 };
@@ -122,6 +139,10 @@ public:
     virtual u_result enableKeepAlive(bool enable = true) = 0;
     
     virtual u_result enableNoDelay(bool enable = true) = 0;
+    // SO_RCVBUF, set it before connect for the TCP window to follow
+    virtual u_result setReceiveBufferSize(size_t size) = 0;
+    // SO_BUSY_POLL: spin for up to timeout_us in the blocking receives instead of sleeping, 0 disables
+    virtual u_result setBusyPoll(_u32 timeout_us) = 0;
 
 protected:
     virtual ~StreamSocket() {} // use dispose();
@@ -133,6 +154,10 @@ class _single_thread DGramSocket: public SocketBase
 
 public:
 
+    enum {
+        MAX_RECV_BATCH = 64,
+    };
+
     static DGramSocket * CreateSocket(socket_family_t family = SOCKET_FAMILY_INET);
         
     
@@ -141,6 +166,11 @@ public:
    
     virtual u_result recvFrom(void *buf, size_t len, size_t & recv_len, SocketAddress * sourceAddr = NULL) = 0;
 
+    // receives up to count (MAX_RECV_BATCH at most) of the datagrams already queued, without waiting
+    // and with a single recvmmsg on Linux: datagram n goes to buf + n * slotSize and its size to lengths[n],
+    // a size above slotSize tells it was cut. count returns the number received, 0 when none was queued
+    virtual u_result recvBatch(void * buf, size_t slotSize, size_t * lengths, size_t & count) = 0;
+
     
 protected:
     virtual ~DGramSocket() {} // use dispose();
@@ -52,6 +52,13 @@ public:
 		PRIORITY_IDLE     = 4,
 	};
 
+    enum sched_policy_t
+    {
+        SCHED_POLICY_DEFAULT = 0,   // time sharing
+        SCHED_POLICY_FIFO    = 1,   // real-time, runs until it blocks or a higher priority preempts it
+        SCHED_POLICY_RR      = 2,   // real-time, time sliced among the threads of the same priority
+    };
+
     template <class T, u_result (T::*PROC)(void)>
     static Thread create_member(T * pthis)
     {
@@ -75,6 +82,17 @@ public:
 	u_result setPriority( priority_val_t p);
 	priority_val_t getPriority();
 
+    // priority within the range of the real-time policy, ignored by SCHED_POLICY_DEFAULT
+    u_result setRealtimePriority(sched_policy_t policy, int priority);
+    static bool getRealtimePriorityRange(sched_policy_t policy, int & minPriority, int & maxPriority);
+    // run the thread on that core only
+    u_result setAffinity(int cpu);
+
+    // keep every page of the process, current and future, in RAM
+    static u_result lockMemory();
+    // touch size bytes of the stack of the calling thread so no page fault is left on it
+    static void prefaultStack(size_t size);
+
     bool operator== ( const Thread & right) { return this->_handle == right._handle; }
 protected:
     Thread( thread_proc_t proc, void * data ): _data(data),_func(proc), _handle(0)  {}
@@ -0,0 +1,222 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "hal/atomic.h"
+#include "rplidar_byte_ring.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+RplidarByteRing::RplidarByteRing()
+    : _chunks(NULL)
+    , _bytes(NULL)
+    , _capacity(0)
+    , _head(0)
+    , _tail(0)
+    , _chunk_head(0)
+    , _chunk_tail(0)
+    , _chunk_release(0)
+    , _gap_head(0)
+    , _gap_tail(0)
+    , _gap_pending(0)
+    , _lost_size(0)
+    , _high_water_mark(0)
+    , _received_size(0)
+    , _dropped_size(0)
+    , _overflow_count(0)
+    , _chunk_count(0)
+{
+}
+
+void RplidarByteRing::attach(void * storage, size_t capacity)
+{
+    _chunks = (Chunk *)storage;
+    _bytes = storage ? (_u8 *)storage + CHUNK_CAPACITY * sizeof(Chunk) : NULL;
+    _capacity = storage ? (_u32)capacity : 0;
+    rp::hal::atomic_store(&_tail, _head);
+    _chunk_tail = _chunk_head;
+    rp::hal::atomic_store(&_chunk_release, _chunk_head);
+    rp::hal::atomic_store(&_gap_tail, _gap_head);
+    _gap_pending = 0;
+    rp::hal::atomic_store(&_high_water_mark, 0);
+}
+
+_u8 * RplidarByteRing::getWriteBuffer(size_t & size)
+{
+    _u32 head = _head;
+    size_t offset = head & (_capacity - 1);
+    size_t space = _capacity - (head - rp::hal::atomic_load(&_tail));
+
+    size = std::min((size_t)_capacity - offset, space);
+    return _bytes + offset;
+}
+
+void RplidarByteRing::commit(size_t size, _u64 arrivalTs)
+{
+    if (!size) return;
+
+    // the drop goes in front of these bytes, which follow it after it is published only
+    if (_gap_pending) {
+        _u32 gapHead = _gap_head;
+        if (gapHead - rp::hal::atomic_load(&_gap_tail) >= GAP_CAPACITY) {
+            drop(size);
+            return;
+        }
+        Gap & gap = _gaps[gapHead & (GAP_CAPACITY - 1)];
+        gap.position = _head;
+        gap.size = _gap_pending;
+        rp::hal::atomic_store(&_gap_head, gapHead + 1);
+        _gap_pending = 0;
+    }
+
+    _u32 head = _head + (_u32)size;
+
+    // the records before _chunk_release are the only ones the consumer no longer looks at
+    _u32 chunkHead = _chunk_head;
+    if (chunkHead - rp::hal::atomic_load(&_chunk_release) < CHUNK_CAPACITY) {
+        Chunk & chunk = _chunks[chunkHead & (CHUNK_CAPACITY - 1)];
+        chunk.end = head;
+        chunk.arrivalTs = arrivalTs;
+        rp::hal::atomic_store(&_chunk_head, chunkHead + 1);
+    }
+
+    // publishing the new head also publishes the bytes written before it
+    rp::hal::atomic_store(&_head, head);
+    rp::hal::atomic_store(&_received_size, _received_size + (_u32)size);
+    rp::hal::atomic_store(&_chunk_count, _chunk_count + 1);
+
+    _u32 pending = head - rp::hal::atomic_load(&_tail);
+    if (pending > _high_water_mark) rp::hal::atomic_store(&_high_water_mark, pending);
+}
+
+void RplidarByteRing::drop(size_t size)
+{
+    rp::hal::atomic_store(&_received_size, _received_size + (_u32)size);
+    rp::hal::atomic_store(&_dropped_size, _dropped_size + (_u32)size);
+    rp::hal::atomic_store(&_overflow_count, _overflow_count + 1);
+    _gap_pending += (_u32)size;
+}
+
+size_t RplidarByteRing::read(_u8 * data, size_t size)
+{
+    _u32 tail = _tail;
+    _u32 head = rp::hal::atomic_load(&_head);
+    _passGaps(tail);
+
+    // stop right before the next drop
+    if (_gap_tail != rp::hal::atomic_load(&_gap_head)) {
+        _u32 gapPosition = _gaps[_gap_tail & (GAP_CAPACITY - 1)].position;
+        if ((_s32)(gapPosition - head) < 0) head = gapPosition;
+    }
+
+    size_t count = std::min((size_t)(head - tail), size);
+    if (!count) return 0;
+
+    size_t offset = tail & (_capacity - 1);
+    size_t firstPart = std::min((size_t)_capacity - offset, count);
+    memcpy(data, _bytes + offset, firstPart);
+    memcpy(data + firstPart, _bytes, count - firstPart);
+
+    rp::hal::atomic_store(&_tail, tail + (_u32)count);
+    _releaseChunks();
+    return count;
+}
+
+size_t RplidarByteRing::pending() const
+{
+    return rp::hal::atomic_load(&_head) - rp::hal::atomic_load(&_tail);
+}
+
+void RplidarByteRing::discard()
+{
+    _u32 head = rp::hal::atomic_load(&_head);
+    _passGaps(head);
+    rp::hal::atomic_store(&_tail, head);
+    _releaseChunks();
+}
+
+// accounts for the drops at or before position, the consumer reads on from there
+void RplidarByteRing::_passGaps(_u32 position)
+{
+    _u32 gapTail = _gap_tail;
+    _u32 gapHead = rp::hal::atomic_load(&_gap_head);
+    while (gapTail != gapHead && (_s32)(_gaps[gapTail & (GAP_CAPACITY - 1)].position - position) <= 0) {
+        _lost_size += _gaps[gapTail & (GAP_CAPACITY - 1)].size;
+        ++gapTail;
+    }
+    rp::hal::atomic_store(&_gap_tail, gapTail);
+}
+
+void RplidarByteRing::_releaseChunks()
+{
+    _u32 chunkHead = rp::hal::atomic_load(&_chunk_head);
+    while (_chunk_tail != chunkHead && (_s32)(_chunks[_chunk_tail & (CHUNK_CAPACITY - 1)].end - _tail) <= 0) {
+        ++_chunk_tail;
+    }
+    if (_chunk_tail - _chunk_release > CHUNK_KEEP) {
+        rp::hal::atomic_store(&_chunk_release, _chunk_tail - CHUNK_KEEP);
+    }
+}
+
+bool RplidarByteRing::getArrivalTimestamp(size_t bytesAfter, _u64 & ts) const
+{
+    _u32 position = _tail - 1 - (_u32)bytesAfter;
+    _u32 chunkHead = rp::hal::atomic_load(&_chunk_head);
+
+    // look for the first record ending after the byte, the one before it must end at or before it
+    _u32 index = _chunk_tail;
+    while (index != _chunk_release && (_s32)(_chunks[(index - 1) & (CHUNK_CAPACITY - 1)].end - position) > 0) {
+        --index;
+    }
+    if (index == _chunk_release || index == chunkHead) return false;
+
+    ts = _chunks[index & (CHUNK_CAPACITY - 1)].arrivalTs;
+    return true;
+}
+
+void RplidarByteRing::getStats(RplidarSerialRingStats & stats) const
+{
+    stats.capacity = _capacity;
+    stats.pending_size = (_u32)pending();
+    stats.high_water_mark = rp::hal::atomic_load(&_high_water_mark);
+    stats.received_size = rp::hal::atomic_load(&_received_size);
+    stats.dropped_size = rp::hal::atomic_load(&_dropped_size);
+    stats.overflow_count = rp::hal::atomic_load(&_overflow_count);
+    stats.chunk_count = rp::hal::atomic_load(&_chunk_count);
+}
+
+}}}
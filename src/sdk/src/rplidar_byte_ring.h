@@ -0,0 +1,134 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Wait-free single producer / single consumer ring of received bytes.
+//
+// The serial reader thread read()s straight into the free room given by
+// getWriteBuffer() and publishes the bytes with commit(), the decoding thread
+// takes them out with read(). As with RplidarNodeRing, each side only writes its
+// own index and the newest bytes are dropped when the ring is full.
+//
+// Each commit also records the arrival time of its chunk, so the consumer can
+// tell when any byte it has read came in. The records are kept in a second ring:
+// when it is full the newest chunks go unrecorded and their bytes get the time
+// of the next recorded chunk.
+//
+// The stream position of each drop is kept too, so that read() never returns
+// bytes from both sides of one: it stops right before it, and getLostSize()
+// grows with the read that starts right after it. With GAP_CAPACITY drops not
+// read past yet, the producer drops everything until the consumer catches up.
+//
+// The bytes and the records live in storage provided by the owner.
+class RplidarByteRing
+{
+public:
+    enum {
+        CHUNK_CAPACITY = 1024,
+        CHUNK_KEEP = 128,   // records kept behind the read position for getArrivalTimestamp
+        GAP_CAPACITY = 64,
+    };
+
+    RplidarByteRing();
+
+    // bytes of storage needed for a ring of capacity bytes, capacity must be a power of 2
+    static size_t getStorageSize(size_t capacity) { return CHUNK_CAPACITY * sizeof(Chunk) + capacity; }
+    // only allowed while neither side runs, NULL detaches. Bytes not read yet are lost.
+    void attach(void * storage, size_t capacity);
+    size_t getCapacity() const { return _capacity; }
+
+    // producer side: contiguous free room at the write position, size is 0 when the ring is full
+    _u8 * getWriteBuffer(size_t & size);
+    // publishes size bytes written to the write buffer, all of them received at arrivalTs
+    void commit(size_t size, _u64 arrivalTs);
+    // accounts for size bytes thrown away because the ring was full
+    void drop(size_t size);
+
+    // consumer side, returns the number of bytes copied to data
+    size_t read(_u8 * data, size_t size);
+    size_t pending() const;
+    // throws away everything pending
+    void discard();
+    // bytes dropped ahead of the data read so far (wraps around)
+    _u32 getLostSize() const { return _lost_size; }
+    // arrival time of the byte located bytesAfter bytes before the end of the data read so far,
+    // false when its chunk is no longer (or not yet) recorded
+    bool getArrivalTimestamp(size_t bytesAfter, _u64 & ts) const;
+
+    void getStats(RplidarSerialRingStats & stats) const;
+
+private:
+    struct Chunk {
+        _u32 end;           // stream position right after the chunk
+        _u64 arrivalTs;
+    };
+
+    struct Gap {
+        _u32 position;      // stream position of the first byte committed after the drop
+        _u32 size;
+    };
+
+    void _releaseChunks();
+    void _passGaps(_u32 head);
+
+    Chunk *       _chunks;
+    _u8 *         _bytes;
+    _u32          _capacity;
+
+    // free running stream positions, only their low bits address _bytes
+    volatile _u32 _head;            // written by the producer
+    volatile _u32 _tail;            // written by the consumer
+
+    // free running record indexes, only their low bits address _chunks
+    volatile _u32 _chunk_head;      // written by the producer
+    _u32          _chunk_tail;      // first record ending after _tail, consumer only
+    volatile _u32 _chunk_release;   // records before it can be overwritten, written by the consumer
+
+    Gap           _gaps[GAP_CAPACITY];
+    volatile _u32 _gap_head;        // written by the producer, each gap is published before the bytes after it
+    volatile _u32 _gap_tail;        // written by the consumer
+    _u32          _gap_pending;     // dropped since the last commit, producer only
+    _u32          _lost_size;       // consumer only
+
+    volatile _u32 _high_water_mark;
+    volatile _u32 _received_size;
+    volatile _u32 _dropped_size;
+    volatile _u32 _overflow_count;
+    volatile _u32 _chunk_count;
+};
+
+}}}
@@ -0,0 +1,403 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sdkcommon.h"
+#include "rplidar_capsule_decode.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RP_CAPSULE_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+// AVX2 is compiled in with a target attribute and only used when the CPU supports it
+#define RP_CAPSULE_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RP_CAPSULE_NEON
+#include <arm_neon.h>
+#endif
+
+namespace rp { namespace standalone{ namespace rplidar { namespace capsule_decoder {
+
+enum {
+    FULL_TURN_Q16 = (360 << 16),
+    FULL_TURN_Q6  = (360 << 6),
+    NODE_QUALITY  = (0x2f << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT),
+};
+
+void decodeScalar(int startAngle_raw_q16, int angleInc_q16, const int * angleOffset_q16, const _u32 * dist_q2, size_t count, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    int currentAngle_raw_q16 = startAngle_raw_q16;
+    for (size_t pos = 0; pos < count; ++pos)
+    {
+        int angle_q6 = ((currentAngle_raw_q16 - angleOffset_q16[pos]) >> 10);
+        int syncBit = (((currentAngle_raw_q16 + angleInc_q16) % FULL_TURN_Q16) < angleInc_q16) ? 1 : 0;
+        currentAngle_raw_q16 += angleInc_q16;
+
+        if (angle_q6 < 0) angle_q6 += FULL_TURN_Q6;
+        if (angle_q6 >= FULL_TURN_Q6) angle_q6 -= FULL_TURN_Q6;
+
+        rplidar_response_measurement_node_hq_t node;
+
+        node.angle_z_q14 = _u16((angle_q6 << 8) / 90);
+        node.flag = (syncBit | ((!syncBit) << 1));
+        node.quality = dist_q2[pos] ? NODE_QUALITY : 0;
+        node.dist_mm_q2 = dist_q2[pos];
+
+        nodebuffer[pos] = node;
+    }
+}
+
+// The vector engines below replace the modulo with one conditional subtraction and
+// (q6 << 8) / 90 with reciprocal multiplications that are exact for q6 < 65536.
+// Both hold as long as the last raw angle stays below two turns, which is always
+// the case unless the device reports a start angle beyond 360 degree.
+// Like the scalar code, the angle is truncated to 16 bits when the wrap is not enough.
+static inline bool _fitsVectorRange(int startAngle_raw_q16, int angleInc_q16, size_t count)
+{
+    return (_u64)startAngle_raw_q16 + (_u64)angleInc_q16 * count < (_u64)(2 * FULL_TURN_Q16);
+}
+
+
+// (q6 << 8) / 90 == (q6 / 45) * 128 + ((q6 % 45) * 128) / 45, where x / 45 == (x * 46604) >> 21 for any 16-bit x
+#define RP_CAPSULE_RECIP45_Q21     46604
+// (q6 << 8) / 90 == (q6 * 3054198967) >> 30 for any 16-bit q6
+#define RP_CAPSULE_RECIP90_Q38     3054198967u
+
+// the flag of a node without the sync bit set
+#define RP_CAPSULE_FLAG_NOSYNC     (RPLIDAR_RESP_MEASUREMENT_SYNCBIT << 1)
+
+#if defined(RP_CAPSULE_SSE2)
+// A node is stored as two little-endian words: angle | dist << 16, dist >> 16 | quality << 16 | flag << 24
+static void _decode_sse2(int startAngle_raw_q16, int angleInc_q16, const int * angleOffset_q16, const _u32 * dist_q2, size_t count, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    if (!_fitsVectorRange(startAngle_raw_q16, angleInc_q16, count)) {
+        decodeScalar(startAngle_raw_q16, angleInc_q16, angleOffset_q16, dist_q2, count, nodebuffer);
+        return;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i turn_q16 = _mm_set1_epi32(FULL_TURN_Q16);
+    const __m128i turn_q16_max = _mm_set1_epi32(FULL_TURN_Q16 - 1);
+    const __m128i turn_q6 = _mm_set1_epi32(FULL_TURN_Q6);
+    const __m128i turn_q6_max = _mm_set1_epi32(FULL_TURN_Q6 - 1);
+    const __m128i recip45 = _mm_set1_epi32(RP_CAPSULE_RECIP45_Q21);
+    const __m128i mul45 = _mm_set1_epi32(45);
+    const __m128i lo16 = _mm_set1_epi32(0xFFFF);
+    const __m128i node_quality = _mm_set1_epi32(NODE_QUALITY << 16);
+    const __m128i flag_nosync = _mm_set1_epi32(RP_CAPSULE_FLAG_NOSYNC << 24);
+    const __m128i inc = _mm_set1_epi32(angleInc_q16);
+    const __m128i step = _mm_set1_epi32(angleInc_q16 * 4);
+    __m128i raw = _mm_setr_epi32(startAngle_raw_q16, startAngle_raw_q16 + angleInc_q16,
+        startAngle_raw_q16 + angleInc_q16 * 2, startAngle_raw_q16 + angleInc_q16 * 3);
+
+    size_t pos = 0;
+    for (; pos + 4 <= count; pos += 4, raw = _mm_add_epi32(raw, step)) {
+        __m128i angle_q6 = _mm_srai_epi32(_mm_sub_epi32(raw, _mm_loadu_si128((const __m128i *)(angleOffset_q16 + pos))), 10);
+        angle_q6 = _mm_add_epi32(angle_q6, _mm_and_si128(_mm_cmplt_epi32(angle_q6, zero), turn_q6));
+        angle_q6 = _mm_sub_epi32(angle_q6, _mm_and_si128(_mm_cmpgt_epi32(angle_q6, turn_q6_max), turn_q6));
+
+        // the upper halves of all the lanes are zero, so the 16-bit multiplications are safe
+        __m128i k = _mm_srli_epi32(_mm_mulhi_epu16(angle_q6, recip45), 5);
+        __m128i r = _mm_slli_epi32(_mm_sub_epi32(angle_q6, _mm_mullo_epi16(k, mul45)), 7);
+        __m128i angle_q14 = _mm_add_epi32(_mm_slli_epi32(k, 7), _mm_srli_epi32(_mm_mulhi_epu16(r, recip45), 5));
+
+        __m128i next = _mm_add_epi32(raw, inc);
+        next = _mm_sub_epi32(next, _mm_and_si128(_mm_cmpgt_epi32(next, turn_q16_max), turn_q16));
+        __m128i sync = _mm_cmplt_epi32(next, inc);
+
+        __m128i dist = _mm_loadu_si128((const __m128i *)(dist_q2 + pos));
+        __m128i quality = _mm_andnot_si128(_mm_cmpeq_epi32(dist, zero), node_quality);
+
+        __m128i w0 = _mm_or_si128(_mm_and_si128(angle_q14, lo16), _mm_slli_epi32(dist, 16));
+        __m128i w1 = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(dist, 16), quality), _mm_add_epi32(flag_nosync, _mm_slli_epi32(sync, 24)));
+
+        _mm_storeu_si128((__m128i *)(nodebuffer + pos), _mm_unpacklo_epi32(w0, w1));
+        _mm_storeu_si128((__m128i *)(nodebuffer + pos + 2), _mm_unpackhi_epi32(w0, w1));
+    }
+
+    if (pos < count) {
+        decodeScalar(startAngle_raw_q16 + angleInc_q16 * (int)pos, angleInc_q16, angleOffset_q16 + pos, dist_q2 + pos, count - pos, nodebuffer + pos);
+    }
+}
+#endif
+
+#if defined(RP_CAPSULE_AVX2)
+// same as _decode_sse2 with 8 lanes
+__attribute__((target("avx2")))
+static void _decode_avx2(int startAngle_raw_q16, int angleInc_q16, const int * angleOffset_q16, const _u32 * dist_q2, size_t count, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    if (!_fitsVectorRange(startAngle_raw_q16, angleInc_q16, count)) {
+        decodeScalar(startAngle_raw_q16, angleInc_q16, angleOffset_q16, dist_q2, count, nodebuffer);
+        return;
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i turn_q16 = _mm256_set1_epi32(FULL_TURN_Q16);
+    const __m256i turn_q16_max = _mm256_set1_epi32(FULL_TURN_Q16 - 1);
+    const __m256i turn_q6 = _mm256_set1_epi32(FULL_TURN_Q6);
+    const __m256i turn_q6_max = _mm256_set1_epi32(FULL_TURN_Q6 - 1);
+    const __m256i recip45 = _mm256_set1_epi32(RP_CAPSULE_RECIP45_Q21);
+    const __m256i mul45 = _mm256_set1_epi32(45);
+    const __m256i lo16 = _mm256_set1_epi32(0xFFFF);
+    const __m256i node_quality = _mm256_set1_epi32(NODE_QUALITY << 16);
+    const __m256i flag_nosync = _mm256_set1_epi32(RP_CAPSULE_FLAG_NOSYNC << 24);
+    const __m256i inc = _mm256_set1_epi32(angleInc_q16);
+    const __m256i step = _mm256_set1_epi32(angleInc_q16 * 8);
+    __m256i raw = _mm256_add_epi32(_mm256_set1_epi32(startAngle_raw_q16),
+        _mm256_mullo_epi32(inc, _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+
+    size_t pos = 0;
+    for (; pos + 8 <= count; pos += 8, raw = _mm256_add_epi32(raw, step)) {
+        __m256i angle_q6 = _mm256_srai_epi32(_mm256_sub_epi32(raw, _mm256_loadu_si256((const __m256i *)(angleOffset_q16 + pos))), 10);
+        angle_q6 = _mm256_add_epi32(angle_q6, _mm256_and_si256(_mm256_cmpgt_epi32(zero, angle_q6), turn_q6));
+        angle_q6 = _mm256_sub_epi32(angle_q6, _mm256_and_si256(_mm256_cmpgt_epi32(angle_q6, turn_q6_max), turn_q6));
+
+        __m256i k = _mm256_srli_epi32(_mm256_mulhi_epu16(angle_q6, recip45), 5);
+        __m256i r = _mm256_slli_epi32(_mm256_sub_epi32(angle_q6, _mm256_mullo_epi16(k, mul45)), 7);
+        __m256i angle_q14 = _mm256_add_epi32(_mm256_slli_epi32(k, 7), _mm256_srli_epi32(_mm256_mulhi_epu16(r, recip45), 5));
+
+        __m256i next = _mm256_add_epi32(raw, inc);
+        next = _mm256_sub_epi32(next, _mm256_and_si256(_mm256_cmpgt_epi32(next, turn_q16_max), turn_q16));
+        __m256i sync = _mm256_cmpgt_epi32(inc, next);
+
+        __m256i dist = _mm256_loadu_si256((const __m256i *)(dist_q2 + pos));
+        __m256i quality = _mm256_andnot_si256(_mm256_cmpeq_epi32(dist, zero), node_quality);
+
+        __m256i w0 = _mm256_or_si256(_mm256_and_si256(angle_q14, lo16), _mm256_slli_epi32(dist, 16));
+        __m256i w1 = _mm256_or_si256(_mm256_or_si256(_mm256_srli_epi32(dist, 16), quality), _mm256_add_epi32(flag_nosync, _mm256_slli_epi32(sync, 24)));
+
+        // the unpacks work within 128-bit halves: lo holds nodes 0,1,4,5 and hi nodes 2,3,6,7
+        __m256i lo = _mm256_unpacklo_epi32(w0, w1);
+        __m256i hi = _mm256_unpackhi_epi32(w0, w1);
+        _mm256_storeu_si256((__m256i *)(nodebuffer + pos), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(nodebuffer + pos + 4), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    if (pos < count) {
+        _decode_sse2(startAngle_raw_q16 + angleInc_q16 * (int)pos, angleInc_q16, angleOffset_q16 + pos, dist_q2 + pos, count - pos, nodebuffer + pos);
+    }
+}
+#endif
+
+#if defined(RP_CAPSULE_NEON)
+static void _decode_neon(int startAngle_raw_q16, int angleInc_q16, const int * angleOffset_q16, const _u32 * dist_q2, size_t count, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    if (!_fitsVectorRange(startAngle_raw_q16, angleInc_q16, count)) {
+        decodeScalar(startAngle_raw_q16, angleInc_q16, angleOffset_q16, dist_q2, count, nodebuffer);
+        return;
+    }
+
+    const int32x4_t  zero = vdupq_n_s32(0);
+    const int32x4_t  turn_q16 = vdupq_n_s32(FULL_TURN_Q16);
+    const int32x4_t  turn_q6 = vdupq_n_s32(FULL_TURN_Q6);
+    const uint32x2_t recip90 = vdup_n_u32(RP_CAPSULE_RECIP90_Q38);
+    const uint32x4_t lo16 = vdupq_n_u32(0xFFFF);
+    const uint32x4_t node_quality = vdupq_n_u32(NODE_QUALITY << 16);
+    const uint32x4_t flag_nosync = vdupq_n_u32(RP_CAPSULE_FLAG_NOSYNC << 24);
+    const int32x4_t  inc = vdupq_n_s32(angleInc_q16);
+    const int32x4_t  step = vdupq_n_s32(angleInc_q16 * 4);
+    const int32_t    lanes[4] = { 0, 1, 2, 3 };
+    int32x4_t raw = vmlaq_s32(vdupq_n_s32(startAngle_raw_q16), inc, vld1q_s32(lanes));
+
+    size_t pos = 0;
+    for (; pos + 4 <= count; pos += 4, raw = vaddq_s32(raw, step)) {
+        int32x4_t angle_q6 = vshrq_n_s32(vsubq_s32(raw, vld1q_s32(angleOffset_q16 + pos)), 10);
+        angle_q6 = vaddq_s32(angle_q6, vandq_s32(vreinterpretq_s32_u32(vcltq_s32(angle_q6, zero)), turn_q6));
+        angle_q6 = vsubq_s32(angle_q6, vandq_s32(vreinterpretq_s32_u32(vcgeq_s32(angle_q6, turn_q6)), turn_q6));
+
+        uint32x4_t q6 = vreinterpretq_u32_s32(angle_q6);
+        uint32x4_t angle_q14 = vcombine_u32(vshrn_n_u64(vmull_u32(vget_low_u32(q6), recip90), 30),
+                                            vshrn_n_u64(vmull_u32(vget_high_u32(q6), recip90), 30));
+
+        int32x4_t next = vaddq_s32(raw, inc);
+        next = vsubq_s32(next, vandq_s32(vreinterpretq_s32_u32(vcgeq_s32(next, turn_q16)), turn_q16));
+        uint32x4_t sync = vcltq_s32(next, inc);
+
+        uint32x4_t dist = vld1q_u32(dist_q2 + pos);
+        uint32x4_t quality = vbicq_u32(node_quality, vceqq_u32(dist, vreinterpretq_u32_s32(zero)));
+
+        uint32x4x2_t node;
+        node.val[0] = vorrq_u32(vandq_u32(angle_q14, lo16), vshlq_n_u32(dist, 16));
+        node.val[1] = vorrq_u32(vorrq_u32(vshrq_n_u32(dist, 16), quality), vaddq_u32(flag_nosync, vshlq_n_u32(sync, 24)));
+        // interleaving the two words gives the packed node layout
+        vst2q_u32((uint32_t *)(nodebuffer + pos), node);
+    }
+
+    if (pos < count) {
+        decodeScalar(startAngle_raw_q16 + angleInc_q16 * (int)pos, angleInc_q16, angleOffset_q16 + pos, dist_q2 + pos, count - pos, nodebuffer + pos);
+    }
+}
+#endif
+
+typedef void (*decode_engine_t)(int, int, const int *, const _u32 *, size_t, rplidar_response_measurement_node_hq_t *);
+
+static decode_engine_t _engine = decodeScalar;
+static const char *    _engine_name = "scalar";
+
+// the engine is selected before main() so that no lazy init can race with the caching threads
+BEGIN_STATIC_CODE(capsule_engine_select)
+{
+#if defined(RP_CAPSULE_SSE2)
+    _engine = _decode_sse2;
+    _engine_name = "sse2";
+#if defined(RP_CAPSULE_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        _engine = _decode_avx2;
+        _engine_name = "avx2";
+    }
+#endif
+#elif defined(RP_CAPSULE_NEON)
+    _engine = _decode_neon;
+    _engine_name = "neon";
+#endif
+}END_STATIC_CODE(capsule_engine_select)
+
+void decode(int startAngle_raw_q16, int angleInc_q16, const int * angleOffset_q16, const _u32 * dist_q2, size_t count, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    _engine(startAngle_raw_q16, angleInc_q16, angleOffset_q16, dist_q2, count, nodebuffer);
+}
+
+const char * getEngineName()
+{
+    return _engine_name;
+}
+
+bool selectEngine(const char * name)
+{
+    if (!strcmp(name, "scalar")) {
+        _engine = decodeScalar;
+        _engine_name = "scalar";
+        return true;
+    }
+#if defined(RP_CAPSULE_SSE2)
+    if (!strcmp(name, "sse2")) {
+        _engine = _decode_sse2;
+        _engine_name = "sse2";
+        return true;
+    }
+#endif
+#if defined(RP_CAPSULE_AVX2)
+    if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) {
+        _engine = _decode_avx2;
+        _engine_name = "avx2";
+        return true;
+    }
+#endif
+#if defined(RP_CAPSULE_NEON)
+    if (!strcmp(name, "neon")) {
+        _engine = _decode_neon;
+        _engine_name = "neon";
+        return true;
+    }
+#endif
+    return false;
+}
+
+// 90 / 16384 and 1 / 4 are exact in float, the products are rounded once like the divisions
+#define RP_UNPACK_DEG_PER_Q14   (90.f / 16384.f)
+#define RP_UNPACK_MM_PER_Q2     0.25f
+
+void unpackScalar(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, float * angle_deg, float * dist_mm, _u8 * quality, _u8 * flag)
+{
+    for (size_t pos = 0; pos < count; ++pos) {
+        angle_deg[pos] = nodebuffer[pos].angle_z_q14 * RP_UNPACK_DEG_PER_Q14;
+        dist_mm[pos] = nodebuffer[pos].dist_mm_q2 * RP_UNPACK_MM_PER_Q2;
+        quality[pos] = nodebuffer[pos].quality;
+        flag[pos] = nodebuffer[pos].flag;
+    }
+}
+
+void unpack(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, float * angle_deg, float * dist_mm, _u8 * quality, _u8 * flag)
+{
+    size_t pos = 0;
+#if defined(RP_CAPSULE_SSE2)
+    const __m128i lo16 = _mm_set1_epi32(0xFFFF);
+    const __m128i lo8 = _mm_set1_epi32(0xFF);
+    const __m128 deg_per_q14 = _mm_set1_ps(RP_UNPACK_DEG_PER_Q14);
+    const __m128 mm_per_q2 = _mm_set1_ps(RP_UNPACK_MM_PER_Q2);
+    const __m128 q2_hi_scale = _mm_set1_ps(65536.f);
+
+    for (; pos + 4 <= count; pos += 4) {
+        // first and second word of the 4 nodes, see _decode_sse2 for the layout
+        __m128 n01 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(nodebuffer + pos)));
+        __m128 n23 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(nodebuffer + pos + 2)));
+        __m128i w0 = _mm_castps_si128(_mm_shuffle_ps(n01, n23, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i w1 = _mm_castps_si128(_mm_shuffle_ps(n01, n23, _MM_SHUFFLE(3, 1, 3, 1)));
+
+        _mm_storeu_ps(angle_deg + pos, _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(w0, lo16)), deg_per_q14));
+
+        // the distance is unsigned: both 16-bit halves are exact in float, their sum is rounded once
+        __m128 dist_hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(w1, lo16)), q2_hi_scale);
+        __m128 dist_lo = _mm_cvtepi32_ps(_mm_srli_epi32(w0, 16));
+        _mm_storeu_ps(dist_mm + pos, _mm_mul_ps(_mm_add_ps(dist_hi, dist_lo), mm_per_q2));
+
+        __m128i bytes = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(w1, 16), lo8), _mm_srli_epi32(w1, 24));
+        bytes = _mm_packus_epi16(bytes, bytes);
+        _u32 q = (_u32)_mm_cvtsi128_si32(bytes);
+        _u32 f = (_u32)_mm_cvtsi128_si32(_mm_srli_si128(bytes, 4));
+        memcpy(quality + pos, &q, 4);
+        memcpy(flag + pos, &f, 4);
+    }
+#elif defined(RP_CAPSULE_NEON)
+    const float32x4_t deg_per_q14 = vdupq_n_f32(RP_UNPACK_DEG_PER_Q14);
+    const float32x4_t mm_per_q2 = vdupq_n_f32(RP_UNPACK_MM_PER_Q2);
+
+    for (; pos + 4 <= count; pos += 4) {
+        // de-interleaving the two words of the 4 nodes, see _decode_neon
+        uint32x4x2_t node = vld2q_u32((const uint32_t *)(nodebuffer + pos));
+        uint32x4_t angle_q14 = vandq_u32(node.val[0], vdupq_n_u32(0xFFFF));
+        uint32x4_t dist_q2 = vorrq_u32(vshrq_n_u32(node.val[0], 16), vshlq_n_u32(node.val[1], 16));
+
+        vst1q_f32(angle_deg + pos, vmulq_f32(vcvtq_f32_u32(angle_q14), deg_per_q14));
+        vst1q_f32(dist_mm + pos, vmulq_f32(vcvtq_f32_u32(dist_q2), mm_per_q2));
+
+        uint16x4_t qf = vmovn_u32(vshrq_n_u32(node.val[1], 16));
+        uint8x8_t bytes = vreinterpret_u8_u16(qf);     // quality, flag, quality, flag...
+        uint8x8x2_t split = vuzp_u8(bytes, bytes);
+        vst1_lane_u32((uint32_t *)(quality + pos), vreinterpret_u32_u8(split.val[0]), 0);
+        vst1_lane_u32((uint32_t *)(flag + pos), vreinterpret_u32_u8(split.val[1]), 0);
+    }
+#endif
+
+    if (pos < count) {
+        unpackScalar(nodebuffer + pos, count - pos, angle_deg + pos, dist_mm + pos, quality + pos, flag + pos);
+    }
+}
+
+}}}}
@@ -0,0 +1,66 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar { namespace capsule_decoder {
+
+// Batch decoding of the express, dense and ultra capsules.
+// Sample i of a capsule is taken at startAngle_raw_q16 + i * angleInc_q16 (degree, q16)
+// and corrected by angleOffset_q16[i]. The raw angles must not be negative and the
+// offsets must stay within +/-32 degree, which every capsule format guarantees.
+
+/// Decode count samples into nodebuffer with the fastest engine available on this CPU
+void decode(int startAngle_raw_q16, int angleInc_q16, const int * angleOffset_q16, const _u32 * dist_q2, size_t count, rplidar_response_measurement_node_hq_t * nodebuffer);
+
+/// Decode count samples into nodebuffer with the portable per-sample code
+void decodeScalar(int startAngle_raw_q16, int angleInc_q16, const int * angleOffset_q16, const _u32 * dist_q2, size_t count, rplidar_response_measurement_node_hq_t * nodebuffer);
+
+/// Name of the engine used by decode()
+const char * getEngineName();
+
+/// Make decode() use the named engine ("scalar", "sse2", "avx2" or "neon"), for the tests and benches
+/// Returns false when the engine is not built in or not supported by this CPU
+/// Not thread safe: no scan may be running while the engine changes
+bool selectEngine(const char * name);
+
+/// Split count nodes into separate arrays: angle in degree, distance in mm, quality and flag bytes
+/// The float values are the same as node.angle_z_q14 * 90.f / 16384.f and node.dist_mm_q2 / 4.f
+void unpack(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, float * angle_deg, float * dist_mm, _u8 * quality, _u8 * flag);
+
+/// Same as unpack() with the portable per-node code
+void unpackScalar(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, float * angle_deg, float * dist_mm, _u8 * quality, _u8 * flag);
+
+}}}}
@@ -0,0 +1,307 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "rplidar_cartesian.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RP_CARTESIAN_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+// AVX2 is compiled in with a target attribute and only used when the CPU supports it
+#define RP_CARTESIAN_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RP_CARTESIAN_NEON
+#include <arm_neon.h>
+#endif
+
+namespace rp { namespace standalone{ namespace rplidar { namespace cartesian {
+
+enum {
+    QUARTER_TURN_Q14 = 16384,
+    QUARTER_MASK_Q14 = QUARTER_TURN_Q14 - 1,
+};
+
+#define RP_CARTESIAN_MM_PER_Q2      0.25f
+#define RP_CARTESIAN_PI             3.14159265358979323846
+
+// sin over the first quadrant, sin and cos of the other ones follow by symmetry:
+// 64KB instead of 512KB for both functions over the whole turn
+static float _sin_table[QUARTER_TURN_Q14 + 1];
+
+void makeTransform(float x_mm, float y_mm, float yaw_deg, Transform & transform)
+{
+    double yaw = yaw_deg * RP_CARTESIAN_PI / 180.0;
+    transform.cos_yaw = (float)cos(yaw);
+    transform.sin_yaw = (float)sin(yaw);
+    transform.x_mm = x_mm;
+    transform.y_mm = y_mm;
+}
+
+void makeIdentity(Transform & transform)
+{
+    transform.cos_yaw = 1.f;
+    transform.sin_yaw = 0.f;
+    transform.x_mm = 0.f;
+    transform.y_mm = 0.f;
+}
+
+void convertScalar(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, const Transform & transform, float * x_mm, float * y_mm)
+{
+    for (size_t pos = 0; pos < count; ++pos)
+    {
+        _u32 angle_q14 = nodebuffer[pos].angle_z_q14;
+        _u32 r = angle_q14 & QUARTER_MASK_Q14;
+        float a = _sin_table[QUARTER_TURN_Q14 - r];     // cos and sin within the quadrant
+        float b = _sin_table[r];
+        float c, s;
+        switch (angle_q14 >> 14) {
+        case 0:  c = a;  s = b;  break;
+        case 1:  c = -b; s = a;  break;
+        case 2:  c = -a; s = -b; break;
+        default: c = b;  s = -a; break;
+        }
+
+        float dist = nodebuffer[pos].dist_mm_q2 * RP_CARTESIAN_MM_PER_Q2;
+        float local_x = dist * c;
+        float local_y = -(dist * s);
+        x_mm[pos] = (transform.cos_yaw * local_x - transform.sin_yaw * local_y) + transform.x_mm;
+        y_mm[pos] = (transform.sin_yaw * local_x + transform.cos_yaw * local_y) + transform.y_mm;
+    }
+}
+
+// The vector engines do the same operations in the same order as convertScalar, the
+// quadrant is applied by swapping the table values and flipping their sign bits.
+
+#if defined(RP_CARTESIAN_SSE2)
+// A node is stored as two little-endian words: angle | dist << 16, dist >> 16 | quality << 16 | flag << 24
+static void _convert_sse2(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, const Transform & transform, float * x_mm, float * y_mm)
+{
+    const __m128i lo16 = _mm_set1_epi32(0xFFFF);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    const __m128 mm_per_q2 = _mm_set1_ps(RP_CARTESIAN_MM_PER_Q2);
+    const __m128 q2_hi_scale = _mm_set1_ps(65536.f);
+    const __m128 sign = _mm_set1_ps(-0.f);
+    const __m128 cos_yaw = _mm_set1_ps(transform.cos_yaw);
+    const __m128 sin_yaw = _mm_set1_ps(transform.sin_yaw);
+    const __m128 offset_x = _mm_set1_ps(transform.x_mm);
+    const __m128 offset_y = _mm_set1_ps(transform.y_mm);
+
+    size_t pos = 0;
+    for (; pos + 4 <= count; pos += 4) {
+        __m128 n01 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(nodebuffer + pos)));
+        __m128 n23 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(nodebuffer + pos + 2)));
+        __m128i w0 = _mm_castps_si128(_mm_shuffle_ps(n01, n23, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i w1 = _mm_castps_si128(_mm_shuffle_ps(n01, n23, _MM_SHUFFLE(3, 1, 3, 1)));
+
+        // no gather in SSE2, the table is read lane by lane
+        __m128i angle_q14 = _mm_and_si128(w0, lo16);
+        _u32 r0 = nodebuffer[pos].angle_z_q14 & QUARTER_MASK_Q14;
+        _u32 r1 = nodebuffer[pos + 1].angle_z_q14 & QUARTER_MASK_Q14;
+        _u32 r2 = nodebuffer[pos + 2].angle_z_q14 & QUARTER_MASK_Q14;
+        _u32 r3 = nodebuffer[pos + 3].angle_z_q14 & QUARTER_MASK_Q14;
+        __m128 a = _mm_setr_ps(_sin_table[QUARTER_TURN_Q14 - r0], _sin_table[QUARTER_TURN_Q14 - r1],
+                               _sin_table[QUARTER_TURN_Q14 - r2], _sin_table[QUARTER_TURN_Q14 - r3]);
+        __m128 b = _mm_setr_ps(_sin_table[r0], _sin_table[r1], _sin_table[r2], _sin_table[r3]);
+
+        __m128i quadrant = _mm_srli_epi32(angle_q14, 14);
+        __m128 odd = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+        __m128 neg_c = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+        __m128 neg_s = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+        __m128 c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(odd, b), _mm_andnot_ps(odd, a)), neg_c);
+        __m128 s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(odd, a), _mm_andnot_ps(odd, b)), neg_s);
+
+        // the distance is unsigned: both 16-bit halves are exact in float, their sum is rounded once
+        __m128 dist_hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(w1, lo16)), q2_hi_scale);
+        __m128 dist_lo = _mm_cvtepi32_ps(_mm_srli_epi32(w0, 16));
+        __m128 dist = _mm_mul_ps(_mm_add_ps(dist_hi, dist_lo), mm_per_q2);
+
+        __m128 local_x = _mm_mul_ps(dist, c);
+        __m128 local_y = _mm_xor_ps(_mm_mul_ps(dist, s), sign);
+        _mm_storeu_ps(x_mm + pos, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(cos_yaw, local_x), _mm_mul_ps(sin_yaw, local_y)), offset_x));
+        _mm_storeu_ps(y_mm + pos, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sin_yaw, local_x), _mm_mul_ps(cos_yaw, local_y)), offset_y));
+    }
+
+    if (pos < count) {
+        convertScalar(nodebuffer + pos, count - pos, transform, x_mm + pos, y_mm + pos);
+    }
+}
+#endif
+
+#if defined(RP_CARTESIAN_AVX2)
+// same as _convert_sse2 with 8 lanes, the table is read with gathers
+__attribute__((target("avx2")))
+static void _convert_avx2(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, const Transform & transform, float * x_mm, float * y_mm)
+{
+    const __m256i lo16 = _mm256_set1_epi32(0xFFFF);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i quarter_mask = _mm256_set1_epi32(QUARTER_MASK_Q14);
+    const __m256i quarter_turn = _mm256_set1_epi32(QUARTER_TURN_Q14);
+    const __m256 mm_per_q2 = _mm256_set1_ps(RP_CARTESIAN_MM_PER_Q2);
+    const __m256 q2_hi_scale = _mm256_set1_ps(65536.f);
+    const __m256 sign = _mm256_set1_ps(-0.f);
+    const __m256 cos_yaw = _mm256_set1_ps(transform.cos_yaw);
+    const __m256 sin_yaw = _mm256_set1_ps(transform.sin_yaw);
+    const __m256 offset_x = _mm256_set1_ps(transform.x_mm);
+    const __m256 offset_y = _mm256_set1_ps(transform.y_mm);
+
+    size_t pos = 0;
+    for (; pos + 8 <= count; pos += 8) {
+        // the shuffles work within 128-bit halves: nodes 0,1,4,5 then 2,3,6,7 until the permutes
+        __m256 n0123 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *)(nodebuffer + pos)));
+        __m256 n4567 = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i *)(nodebuffer + pos + 4)));
+        __m256i w0 = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(n0123, n4567, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i w1 = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(n0123, n4567, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0));
+
+        __m256i angle_q14 = _mm256_and_si256(w0, lo16);
+        __m256i r = _mm256_and_si256(angle_q14, quarter_mask);
+        __m256 a = _mm256_i32gather_ps(_sin_table, _mm256_sub_epi32(quarter_turn, r), 4);
+        __m256 b = _mm256_i32gather_ps(_sin_table, r, 4);
+
+        __m256i quadrant = _mm256_srli_epi32(angle_q14, 14);
+        __m256 odd = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+        __m256 neg_c = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30));
+        __m256 neg_s = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30));
+        __m256 c = _mm256_xor_ps(_mm256_blendv_ps(a, b, odd), neg_c);
+        __m256 s = _mm256_xor_ps(_mm256_blendv_ps(b, a, odd), neg_s);
+
+        __m256 dist_hi = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(w1, lo16)), q2_hi_scale);
+        __m256 dist_lo = _mm256_cvtepi32_ps(_mm256_srli_epi32(w0, 16));
+        __m256 dist = _mm256_mul_ps(_mm256_add_ps(dist_hi, dist_lo), mm_per_q2);
+
+        __m256 local_x = _mm256_mul_ps(dist, c);
+        __m256 local_y = _mm256_xor_ps(_mm256_mul_ps(dist, s), sign);
+        _mm256_storeu_ps(x_mm + pos, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(cos_yaw, local_x), _mm256_mul_ps(sin_yaw, local_y)), offset_x));
+        _mm256_storeu_ps(y_mm + pos, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sin_yaw, local_x), _mm256_mul_ps(cos_yaw, local_y)), offset_y));
+    }
+
+    if (pos < count) {
+        _convert_sse2(nodebuffer + pos, count - pos, transform, x_mm + pos, y_mm + pos);
+    }
+}
+#endif
+
+#if defined(RP_CARTESIAN_NEON)
+static void _convert_neon(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, const Transform & transform, float * x_mm, float * y_mm)
+{
+    const uint32x4_t  lo16 = vdupq_n_u32(0xFFFF);
+    const uint32x4_t  one = vdupq_n_u32(1);
+    const uint32x4_t  two = vdupq_n_u32(2);
+    const float32x4_t mm_per_q2 = vdupq_n_f32(RP_CARTESIAN_MM_PER_Q2);
+    const float32x4_t cos_yaw = vdupq_n_f32(transform.cos_yaw);
+    const float32x4_t sin_yaw = vdupq_n_f32(transform.sin_yaw);
+    const float32x4_t offset_x = vdupq_n_f32(transform.x_mm);
+    const float32x4_t offset_y = vdupq_n_f32(transform.y_mm);
+
+    size_t pos = 0;
+    for (; pos + 4 <= count; pos += 4) {
+        // de-interleaving the two words of the 4 nodes
+        uint32x4x2_t node = vld2q_u32((const uint32_t *)(nodebuffer + pos));
+        uint32x4_t angle_q14 = vandq_u32(node.val[0], lo16);
+        uint32x4_t dist_q2 = vorrq_u32(vshrq_n_u32(node.val[0], 16), vshlq_n_u32(node.val[1], 16));
+
+        float a_lanes[4], b_lanes[4];
+        for (int lane = 0; lane < 4; ++lane) {
+            _u32 r = nodebuffer[pos + lane].angle_z_q14 & QUARTER_MASK_Q14;
+            a_lanes[lane] = _sin_table[QUARTER_TURN_Q14 - r];
+            b_lanes[lane] = _sin_table[r];
+        }
+        float32x4_t a = vld1q_f32(a_lanes);
+        float32x4_t b = vld1q_f32(b_lanes);
+
+        uint32x4_t quadrant = vshrq_n_u32(angle_q14, 14);
+        uint32x4_t odd = vceqq_u32(vandq_u32(quadrant, one), one);
+        uint32x4_t neg_c = vshlq_n_u32(vandq_u32(vaddq_u32(quadrant, one), two), 30);
+        uint32x4_t neg_s = vshlq_n_u32(vandq_u32(quadrant, two), 30);
+        float32x4_t c = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(vbslq_f32(odd, b, a)), neg_c));
+        float32x4_t s = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(vbslq_f32(odd, a, b)), neg_s));
+
+        float32x4_t dist = vmulq_f32(vcvtq_f32_u32(dist_q2), mm_per_q2);
+        float32x4_t local_x = vmulq_f32(dist, c);
+        float32x4_t local_y = vnegq_f32(vmulq_f32(dist, s));
+        vst1q_f32(x_mm + pos, vaddq_f32(vsubq_f32(vmulq_f32(cos_yaw, local_x), vmulq_f32(sin_yaw, local_y)), offset_x));
+        vst1q_f32(y_mm + pos, vaddq_f32(vaddq_f32(vmulq_f32(sin_yaw, local_x), vmulq_f32(cos_yaw, local_y)), offset_y));
+    }
+
+    if (pos < count) {
+        convertScalar(nodebuffer + pos, count - pos, transform, x_mm + pos, y_mm + pos);
+    }
+}
+#endif
+
+typedef void (*convert_engine_t)(const rplidar_response_measurement_node_hq_t *, size_t, const Transform &, float *, float *);
+
+static convert_engine_t _engine = convertScalar;
+static const char *     _engine_name = "scalar";
+
+// the table is filled and the engine selected before main() so that no lazy init can race with the caching threads
+BEGIN_STATIC_CODE(cartesian_engine_select)
+{
+    for (int pos = 0; pos <= QUARTER_TURN_Q14; ++pos) {
+        _sin_table[pos] = (float)sin(pos * (RP_CARTESIAN_PI / 2) / QUARTER_TURN_Q14);
+    }
+
+#if defined(RP_CARTESIAN_SSE2)
+    _engine = _convert_sse2;
+    _engine_name = "sse2";
+#if defined(RP_CARTESIAN_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        _engine = _convert_avx2;
+        _engine_name = "avx2";
+    }
+#endif
+#elif defined(RP_CARTESIAN_NEON)
+    _engine = _convert_neon;
+    _engine_name = "neon";
+#endif
+}END_STATIC_CODE(cartesian_engine_select)
+
+void convert(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, const Transform & transform, float * x_mm, float * y_mm)
+{
+    _engine(nodebuffer, count, transform, x_mm, y_mm);
+}
+
+const char * getEngineName()
+{
+    return _engine_name;
+}
+
+}}}}
@@ -0,0 +1,68 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar { namespace cartesian {
+
+// Conversion of the nodes to x/y coordinates in millimetres.
+// The angle of a node grows clockwise seen from above: in the frame of the sensor
+// x points to 0 degree and y to 270 degree (x forward, y to the left, z up).
+// sin and cos come from a table indexed by angle_z_q14, the distance scaling and
+// the mount transform are vectorized.
+
+/// Pose of the sensor in the frame the points are wanted in
+struct Transform {
+    float cos_yaw;
+    float sin_yaw;
+    float x_mm;
+    float y_mm;
+};
+
+/// Sensor at (x_mm, y_mm), its 0 degree direction turned by yaw_deg counterclockwise from the x axis
+void makeTransform(float x_mm, float y_mm, float yaw_deg, Transform & transform);
+
+/// The identity transform, points stay in the frame of the sensor
+void makeIdentity(Transform & transform);
+
+/// Convert count nodes with the fastest engine available on this CPU
+void convert(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, const Transform & transform, float * x_mm, float * y_mm);
+
+/// Same as convert() with the portable per-node code
+void convertScalar(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, const Transform & transform, float * x_mm, float * y_mm);
+
+/// Name of the engine used by convert()
+const char * getEngineName();
+
+}}}}
@@ -40,12 +40,22 @@
 #include "hal/assert.h"
 #include "hal/locker.h"
 #include "hal/socket.h"
+#include "hal/atomic.h"
 #include "hal/event.h"
+#include "rplidar_cartesian.h"
+#include "rplidar_scan_pool.h"
+#include "rplidar_node_ring.h"
+#include "rplidar_point_history.h"
+#include "rplidar_byte_ring.h"
 #include "rplidar_driver_impl.h"
 #include "rplidar_driver_serial.h"
 #include "rplidar_driver_TCP.h"
+#include "rplidar_driver_UDP.h"
+#include "rplidar_crc32.h"
+#include "rplidar_capsule_decode.h"
 
 #include <algorithm>
+#include <new>
 
 #ifndef min
 #define min(a,b)            (((a) < (b)) ? (a) : (b))
@@ -89,6 +99,8 @@ RPlidarDriver * RPlidarDriver::CreateDriver(_u32 drivertype)
         return new RPlidarDriverSerial();
     case DRIVER_TYPE_TCP:
          return new RPlidarDriverTCP();
+    case DRIVER_TYPE_UDP:
+        return new RPlidarDriverUDP();
     default:
         return NULL;
     }
@@ -100,16 +112,79 @@ void RPlidarDriver::DisposeDriver(RPlidarDriver * drv)
     delete drv;
 }
 
+_u64 RPlidarDriver::GetTimestamp_uS()
+{
+    return getus();
+}
+
+// channels without a finer wait of their own
+bool ChannelDevice::waitfordataUntil(size_t data_count, _u64 deadline_us, size_t * returned_size)
+{
+    if (deadline_us == (_u64)-1) return waitfordata(data_count, -1, returned_size);
+
+    _u64 now = getus();
+    _u32 timeout = (deadline_us > now) ? (_u32)((deadline_us - now + 999) / 1000) : 0;
+    return waitfordata(data_count, timeout, returned_size);
+}
+
 
 RPlidarDriverImplCommon::RPlidarDriverImplCommon()
     : _isConnected(false)
     , _isScanning(false)
     , _isSupportingMotorCtrl(false)
 {
-    _cached_scan_node_hq_count = 0;
-    _cached_scan_node_hq_count_for_interval_retrieve = 0;
+    for (_u32 pos = 0; pos < MAX_SCAN_SUBSCRIBERS; ++pos) {
+        _scan_subscribers[pos].active = 0;
+        _scan_subscribers[pos].cursor = 0;
+    }
     _cached_sampleduration_std = LEGACY_SAMPLE_DURATION;
     _cached_sampleduration_express = LEGACY_SAMPLE_DURATION;
+    _cached_scan_us_per_sample = LEGACY_SAMPLE_DURATION;
+    _scan_arena = NULL;
+    _scan_arena_size = 0;
+    _min_scan_frequency = DEFAULT_MIN_SCAN_FREQUENCY;
+    _scan_arrays = 0;
+    cartesian::makeIdentity(_sensor_pose);
+    _truncated_scan_count = 0;
+    _rx_resync_count = 0;
+    _rx_loss_count = 0;
+    _rx_gap = false;
+    _serial_ring_size = DEFAULT_SERIAL_RING_SIZE;
+    _tcp_options.receive_buffer_size = 0;
+    _tcp_options.no_delay = true;
+    _tcp_options.busy_poll_us = 0;
+    _rt_profile.sched_policy = RT_SCHED_DEFAULT;
+    _rt_profile.sched_priority = 0;
+    _rt_profile.cpu_core = -1;
+    _rt_profile.lock_memory = false;
+    _rt_profile.prefault_stack_size = 0;
+    _rt_applied = 0;
+    _rt_stats_seq = 0;
+    _rt_stack_prefaulted = false;
+    _rt_frame_count = 0;
+    _rt_latency_sum = 0;
+    _rt_latency_min = 0;
+    _rt_latency_max = 0;
+    _rt_over_100us_count = 0;
+    _rt_over_1ms_count = 0;
+    _link_received_size = 0;
+    _link_read_count = 0;
+    memset(_link_frame_count, 0, sizeof(_link_frame_count));
+    _link_discarded_size = 0;
+    _link_checksum_error_count = 0;
+    _link_baudrate = 0;
+    memset(&_link_previous, 0, sizeof(_link_previous));
+    _link_previous_ts = getus();
+    _resetRxStream();
+}
+
+RPlidarDriverImplCommon::~RPlidarDriverImplCommon()
+{
+    // the derived classes stopped the cache thread already
+    _scan_pool.attach(NULL, 0, 0);
+    _interval_ring.attach(NULL, 0);
+    _point_history.attach(NULL, 0);
+    delete [] _scan_arena;
 }
 
 bool RPlidarDriverImplCommon::isConnected()
@@ -142,24 +217,22 @@ u_result RPlidarDriverImplCommon::clearNetSerialRxCache()
     return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::_waitResponseHeader(rplidar_ans_header_t * header, _u32 timeout)
+u_result RPlidarDriverImplCommon::_waitResponseHeader(rplidar_ans_header_t * header, _u64 deadline_us)
 {
     int  recvPos = 0;
-    _u32 startTs = getms();
     _u8  recvBuffer[sizeof(rplidar_ans_header_t)];
     _u8  *headerBuffer = reinterpret_cast<_u8 *>(header);
-    _u32 waitTime;
 
-    while ((waitTime=getms() - startTs) <= timeout) {
+    do {
         size_t remainSize = sizeof(rplidar_ans_header_t) - recvPos;
         size_t recvSize;
         
-        bool ans = _chanDev->waitfordata(remainSize, timeout - waitTime, &recvSize);
+        bool ans = _chanDev->waitfordataUntil(remainSize, deadline_us, &recvSize);
         if(!ans) return RESULT_OPERATION_TIMEOUT;
         
         if(recvSize > remainSize) recvSize = remainSize;
         
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
+        recvSize = _recvChannel(recvBuffer, recvSize);
 
         for (size_t pos = 0; pos < recvSize; ++pos) {
             _u8 currentByte = recvBuffer[pos];
@@ -183,20 +256,249 @@ u_result RPlidarDriverImplCommon::_waitResponseHeader(rplidar_ans_header_t * hea
                 return RESULT_OK;
             }
         }
-    }
+    } while (getus() <= deadline_us);
 
     return RESULT_OPERATION_TIMEOUT;
 }
 
 
 
+// Frame specs used by the stream parser.
+// findSync() returns the first position in [pos, last) where a frame may start, or last if there is none.
+// A sync pattern may span two bytes, so pos[1] is always readable.
+struct NodeFrameSpec
+{
+    enum { FRAME_SIZE = sizeof(rplidar_response_measurement_node_t) };
+    enum { LINK_FRAME_TYPE = RPlidarDriverImplCommon::LINK_FRAME_NODE };
+
+    static inline const _u8 * findSync(const _u8 * pos, const _u8 * last)
+    {
+        for (; pos < last; ++pos) {
+            // the sync bit and its reverse, then the check bit
+            if ((((pos[0] >> 1) ^ pos[0]) & 0x1) && (pos[1] & RPLIDAR_RESP_MEASUREMENT_CHECKBIT)) break;
+        }
+        return pos;
+    }
+
+    static inline bool verify(const _u8 *)
+    {
+        return true;
+    }
+};
+
+template <size_t CapsuleSize, int LinkFrameType>
+struct CapsuleFrameSpec
+{
+    enum { FRAME_SIZE = CapsuleSize };
+    enum { LINK_FRAME_TYPE = LinkFrameType };
+
+    static inline const _u8 * findSync(const _u8 * pos, const _u8 * last)
+    {
+        for (; pos < last; ++pos) {
+            if ((pos[0] >> 4) == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 && (pos[1] >> 4) == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2) break;
+        }
+        return pos;
+    }
+
+    static inline bool verify(const _u8 * frame)
+    {
+        _u8 checksum = 0;
+        _u8 recvChecksum = ((frame[0] & 0xF) | (frame[1] << 4));
+        for (size_t cpos = offsetof(rplidar_response_capsule_measurement_nodes_t, start_angle_sync_q6); cpos < FRAME_SIZE; ++cpos) {
+            checksum ^= frame[cpos];
+        }
+        return recvChecksum == checksum;
+    }
+};
+
+typedef CapsuleFrameSpec<sizeof(rplidar_response_capsule_measurement_nodes_t), RPlidarDriverImplCommon::LINK_FRAME_CAPSULE>             ExpressCapsuleFrameSpec;
+typedef CapsuleFrameSpec<sizeof(rplidar_response_ultra_capsule_measurement_nodes_t), RPlidarDriverImplCommon::LINK_FRAME_ULTRA_CAPSULE> UltraCapsuleFrameSpec;
+
+struct HqCapsuleFrameSpec
+{
+    enum { FRAME_SIZE = sizeof(rplidar_response_hq_capsule_measurement_nodes_t) };
+    enum { LINK_FRAME_TYPE = RPlidarDriverImplCommon::LINK_FRAME_HQ_CAPSULE };
+
+    static inline const _u8 * findSync(const _u8 * pos, const _u8 * last)
+    {
+        const _u8 * sync = (const _u8 *)memchr(pos, RPLIDAR_RESP_MEASUREMENT_HQ_SYNC, last - pos);
+        return sync ? sync : last;
+    }
+
+    static inline bool verify(const _u8 * frame)
+    {
+        _u32 recvCrc;
+        memcpy(&recvCrc, frame + FRAME_SIZE - sizeof(recvCrc), sizeof(recvCrc));
+        return crc32::compute(frame, FRAME_SIZE - sizeof(recvCrc)) == recvCrc;
+    }
+};
+
+int RPlidarDriverImplCommon::_recvChannel(_u8 * data, size_t size)
+{
+    int received = _chanDev->recvdata(data, size);
+    if (received > 0) {
+        _link_received_size += received;
+        ++_link_read_count;
+    }
+    return received;
+}
+
+void RPlidarDriverImplCommon::_resetRxStream()
+{
+    _rxbuf_pos = _rxbuf_end = 0;
+}
+
+u_result RPlidarDriverImplCommon::_fillRxStream(size_t frameSize, _u64 deadline_us)
+{
+    size_t buffered = _rxbuf_end - _rxbuf_pos;
+
+    // keep the pending bytes (less than one frame) at the head so every frame stays contiguous
+    if (!buffered) {
+        _resetRxStream();
+    } else if (_rxbuf_end > sizeof(_rxbuf) / 2) {
+        memmove(_rxbuf, _rxbuf + _rxbuf_pos, buffered);
+        _rxbuf_pos = 0;
+        _rxbuf_end = buffered;
+    }
+
+    size_t recvSize;
+    if (!_chanDev->waitfordataUntil(frameSize - buffered, deadline_us, &recvSize)) {
+        return RESULT_OPERATION_TIMEOUT;
+    }
+
+    // drain everything available with a single read
+    size_t room = sizeof(_rxbuf) - _rxbuf_end;
+    if (recvSize > room) recvSize = room;
+
+    size_t gapEnd = _rxbuf_end;
+    _rxbuf_end += _recvChannel(_rxbuf + _rxbuf_end, recvSize);
+
+    // the channel lost data right before the bytes just read: the next frame does not follow
+    // the previous one, and the bytes buffered before cannot complete a frame with them
+    _u32 lossCount;
+    if (_chanDev->getLossCount(lossCount) && lossCount != _rx_loss_count) {
+        _rx_loss_count = lossCount;
+        _link_discarded_size += (_u32)(gapEnd - _rxbuf_pos);
+        _rxbuf_pos = gapEnd;
+        _rx_gap = true;
+    }
+    return RESULT_OK;
+}
+
+// arrival time of the last byte of the frame _waitStreamFrame just returned,
+// now when the channel does not record when its data came in
+_u64 RPlidarDriverImplCommon::_rxFrameTimestamp()
+{
+    _u64 ts;
+    if (!_chanDev->getArrivalTimestamp(_rxbuf_end - _rxbuf_pos, ts)) return getus();
+
+    // how late the cache thread gets to the frame, for getRealtimeStats
+    _u64 now = getus();
+    _u32 latency = (now <= ts) ? 0 : ((now - ts > 0xFFFFFFFF) ? 0xFFFFFFFF : (_u32)(now - ts));
+    rp::hal::atomic_fetch_add(&_rt_stats_seq, 1);
+    if (!_rt_frame_count || latency < _rt_latency_min) _rt_latency_min = latency;
+    if (latency > _rt_latency_max) _rt_latency_max = latency;
+    if (latency > 100) ++_rt_over_100us_count;
+    if (latency > 1000) ++_rt_over_1ms_count;
+    _rt_latency_sum += latency;
+    ++_rt_frame_count;
+    rp::hal::atomic_fetch_add(&_rt_stats_seq, 1);
+    return ts;
+}
+
+void RPlidarDriverImplCommon::_applyRealtimeProfile()
+{
+    _u32 applied = 0;
+    if (_rt_profile.sched_policy != RT_SCHED_DEFAULT) {
+        rp::hal::Thread::sched_policy_t policy = (_rt_profile.sched_policy == RT_SCHED_FIFO) ? rp::hal::Thread::SCHED_POLICY_FIFO : rp::hal::Thread::SCHED_POLICY_RR;
+        if (IS_OK(_cachethread.setRealtimePriority(policy, _rt_profile.sched_priority))) applied |= RT_PROFILE_SCHED;
+    }
+    if (_rt_profile.cpu_core >= 0 && IS_OK(_cachethread.setAffinity(_rt_profile.cpu_core))) {
+        applied |= RT_PROFILE_AFFINITY;
+    }
+    if (_rt_profile.lock_memory && IS_OK(rp::hal::Thread::lockMemory())) {
+        applied |= RT_PROFILE_MEMLOCK;
+    }
+    rp::hal::atomic_store(&_rt_applied, applied);
+}
+
+// on the cache thread, before its first wait
+void RPlidarDriverImplCommon::_enterRealtimeProfile()
+{
+    rp::hal::atomic_fetch_add(&_rt_stats_seq, 1);
+    _rt_frame_count = 0;
+    _rt_latency_sum = 0;
+    _rt_latency_min = 0;
+    _rt_latency_max = 0;
+    _rt_over_100us_count = 0;
+    _rt_over_1ms_count = 0;
+    _rt_stack_prefaulted = false;
+    rp::hal::atomic_fetch_add(&_rt_stats_seq, 1);
+
+    if (_rt_profile.prefault_stack_size) {
+        rp::hal::Thread::prefaultStack(_rt_profile.prefault_stack_size);
+        rp::hal::atomic_fetch_add(&_rt_stats_seq, 1);
+        _rt_stack_prefaulted = true;
+        rp::hal::atomic_fetch_add(&_rt_stats_seq, 1);
+    }
+}
+
+template <class TFrameSpec>
+u_result RPlidarDriverImplCommon::_waitStreamFrame(_u8 * frame, _u64 deadline_us, bool & resynced)
+{
+    resynced = false;
+
+    do {
+        while (_rxbuf_end - _rxbuf_pos >= TFrameSpec::FRAME_SIZE) {
+            const _u8 * begin = _rxbuf + _rxbuf_pos;
+            const _u8 * sync = TFrameSpec::findSync(begin, _rxbuf + _rxbuf_end - 1);
+
+            if (sync != begin) {
+                // garbage before the sync pattern
+                _rxbuf_pos += sync - begin;
+                _link_discarded_size += (_u32)(sync - begin);
+                if (!resynced) ++_rx_resync_count;
+                resynced = true;
+            }
+
+            if (_rxbuf_end - _rxbuf_pos < TFrameSpec::FRAME_SIZE) break;
+
+            if (TFrameSpec::verify(sync)) {
+                memcpy(frame, sync, TFrameSpec::FRAME_SIZE);
+                _rxbuf_pos += TFrameSpec::FRAME_SIZE;
+                ++_link_frame_count[TFrameSpec::LINK_FRAME_TYPE];
+                if (_rx_gap) {
+                    // frames went missing before this one, nothing to pair it with
+                    _rx_gap = false;
+                    resynced = true;
+                }
+                return RESULT_OK;
+            }
+
+            // false sync pattern or corrupted frame, search again from the next byte
+            _rxbuf_pos += 1;
+            ++_link_discarded_size;
+            ++_link_checksum_error_count;
+            ++_rx_resync_count;
+            resynced = true;
+            return RESULT_INVALID_DATA;
+        }
+
+        if (IS_FAIL(_fillRxStream(TFrameSpec::FRAME_SIZE, deadline_us))) {
+            return RESULT_OPERATION_TIMEOUT;
+        }
+    } while (getus() <= deadline_us);
+
+    return RESULT_OPERATION_TIMEOUT;
+}
+
 u_result RPlidarDriverImplCommon::getHealth(rplidar_response_device_health_t & healthinfo, _u32 timeout)
 {
     u_result  ans;
     
     if (!isConnected()) return RESULT_OPERATION_FAIL;
     
-    _disableDataGrabbing();
+    if (IS_FAIL(ans = _disableDataGrabbing())) return ans;
 
     {
         rp::hal::AutoLocker l(_lock);
@@ -205,8 +507,9 @@ u_result RPlidarDriverImplCommon::getHealth(rplidar_response_device_health_t & h
             return ans;
         }
 
+        _u64 deadline_us = deadlineAfter(timeout);
         rplidar_ans_header_t response_header;
-        if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
+        if (IS_FAIL(ans = _waitResponseHeader(&response_header, deadline_us))) {
             return ans;
         }
 
@@ -220,10 +523,10 @@ u_result RPlidarDriverImplCommon::getHealth(rplidar_response_device_health_t & h
             return RESULT_INVALID_DATA;
         }
 
-         if (!_chanDev->waitfordata(header_size, timeout)) {
+         if (!_chanDev->waitfordataUntil(header_size, deadline_us)) {
             return RESULT_OPERATION_TIMEOUT;
         }
-        _chanDev->recvdata(reinterpret_cast<_u8 *>(&healthinfo), sizeof(healthinfo));
+        _recvChannel(reinterpret_cast<_u8 *>(&healthinfo), sizeof(healthinfo));
     }
     return RESULT_OK;
 }
@@ -236,7 +539,7 @@ u_result RPlidarDriverImplCommon::getDeviceInfo(rplidar_response_device_info_t &
     
     if (!isConnected()) return RESULT_OPERATION_FAIL;
 
-    _disableDataGrabbing();
+    if (IS_FAIL(ans = _disableDataGrabbing())) return ans;
 
     {
         rp::hal::AutoLocker l(_lock);
@@ -245,8 +548,9 @@ u_result RPlidarDriverImplCommon::getDeviceInfo(rplidar_response_device_info_t &
             return ans;
         }
 
+        _u64 deadline_us = deadlineAfter(timeout);
         rplidar_ans_header_t response_header;
-        if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
+        if (IS_FAIL(ans = _waitResponseHeader(&response_header, deadline_us))) {
             return ans;
         }
 
@@ -260,10 +564,10 @@ u_result RPlidarDriverImplCommon::getDeviceInfo(rplidar_response_device_info_t &
             return RESULT_INVALID_DATA;
         }
 
-        if (!_chanDev->waitfordata(header_size, timeout)) {
+        if (!_chanDev->waitfordataUntil(header_size, deadline_us)) {
             return RESULT_OPERATION_TIMEOUT;
         }
-        _chanDev->recvdata(reinterpret_cast<_u8 *>(&info), sizeof(info));
+        _recvChannel(reinterpret_cast<_u8 *>(&info), sizeof(info));
     }
     return RESULT_OK;
 }
@@ -291,62 +595,16 @@ u_result RPlidarDriverImplCommon::getFrequency(const RplidarScanMode& scanMode,
     return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::_waitNode(rplidar_response_measurement_node_t * node, _u32 timeout)
+u_result RPlidarDriverImplCommon::_waitNode(rplidar_response_measurement_node_t * node, _u64 deadline_us)
 {
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_measurement_node_t)];
-    _u8 *nodeBuffer = (_u8*)node;
-    _u32 waitTime;
-
-   while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_measurement_node_t) - recvPos;
-        size_t recvSize;
-
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans) return RESULT_OPERATION_FAIL;
-
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
-            switch (recvPos) {
-            case 0: // expect the sync bit and its reverse in this byte
-                {
-                    _u8 tmp = (currentByte>>1);
-                    if ( (tmp ^ currentByte) & 0x1 ) {
-                        // pass
-                    } else {
-                        continue;
-                    }
-
-                }
-                break;
-            case 1: // expect the highest bit to be 1
-                {
-                    if (currentByte & RPLIDAR_RESP_MEASUREMENT_CHECKBIT) {
-                        // pass
-                    } else {
-                        recvPos = 0;
-                        continue;
-                    }
-                }
-                break;
-            }
-            nodeBuffer[recvPos++] = currentByte;
-
-            if (recvPos == sizeof(rplidar_response_measurement_node_t)) {
-                return RESULT_OK;
-            }
-        }
-    }
+    bool resynced;
+    u_result ans = _waitStreamFrame<NodeFrameSpec>(reinterpret_cast<_u8 *>(node), deadline_us, resynced);
 
-    return RESULT_OPERATION_TIMEOUT;
+    // a stalled channel ends the standard scan, see _cacheScanData
+    return (ans == RESULT_OPERATION_TIMEOUT) ? RESULT_OPERATION_FAIL : ans;
 }
 
-u_result RPlidarDriverImplCommon::_waitScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout)
+u_result RPlidarDriverImplCommon::_waitScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u64 deadline_us)
 {
     if (!_isConnected) {
         count = 0;
@@ -354,13 +612,11 @@ u_result RPlidarDriverImplCommon::_waitScanData(rplidar_response_measurement_nod
     }
 
     size_t   recvNodeCount =  0;
-    _u32     startTs = getms();
-    _u32     waitTime;
     u_result ans;
 
-    while ((waitTime = getms() - startTs) <= timeout && recvNodeCount < count) {
+    while (getus() <= deadline_us && recvNodeCount < count) {
         rplidar_response_measurement_node_t node;
-        if (IS_FAIL(ans = _waitNode(&node, timeout - waitTime))) {
+        if (IS_FAIL(ans = _waitNode(&node, deadline_us))) {
             return ans;
         }
         
@@ -373,226 +629,284 @@ u_result RPlidarDriverImplCommon::_waitScanData(rplidar_response_measurement_nod
 }
 
 
-u_result RPlidarDriverImplCommon::_waitCapsuledNode(rplidar_response_capsule_measurement_nodes_t & node, _u32 timeout)
+u_result RPlidarDriverImplCommon::_waitCapsuledNode(rplidar_response_capsule_measurement_nodes_t & node, _u64 deadline_us)
 {
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_capsule_measurement_nodes_t)];
-    _u8 *nodeBuffer = (_u8*)&node;
-    _u32 waitTime;
+    bool resynced;
+    u_result ans = _waitStreamFrame<ExpressCapsuleFrameSpec>(reinterpret_cast<_u8 *>(&node), deadline_us, resynced);
 
+    // a capsule is decoded together with the previous one, which is useless after a gap,
+    // and the capsule with the sync bit starts a new scan
+    if (IS_FAIL(ans) || resynced || (node.start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT)) {
+        _is_previous_capsuledataRdy = false;
+    }
+    return ans;
+}
 
-   while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_capsule_measurement_nodes_t) - recvPos;
-        size_t recvSize;
+u_result RPlidarDriverImplCommon::_waitUltraCapsuledNode(rplidar_response_ultra_capsule_measurement_nodes_t & node, _u64 deadline_us)
+{
+    if (!_isConnected) {
+        return RESULT_OPERATION_FAIL;
+    }
 
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans)
-        {
-            return RESULT_OPERATION_TIMEOUT;
-        }
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-        
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
+    bool resynced;
+    u_result ans = _waitStreamFrame<UltraCapsuleFrameSpec>(reinterpret_cast<_u8 *>(&node), deadline_us, resynced);
 
-            switch (recvPos) {
-            case 0: // expect the sync bit 1
-                {
-                    _u8 tmp = (currentByte>>4);
-                    if ( tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 ) {
-                        // pass
-                    } else {
-                        _is_previous_capsuledataRdy = false;
-                        continue;
-                    }
-
-                }
-                break;
-            case 1: // expect the sync bit 2
-                {
-                    _u8 tmp = (currentByte>>4);
-                    if (tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2) {
-                        // pass
-                    } else {
-                        recvPos = 0;
-                        _is_previous_capsuledataRdy = false;
-                        continue;
-                    }
-                }
-                break;
-            }
-            nodeBuffer[recvPos++] = currentByte;
-            if (recvPos == sizeof(rplidar_response_capsule_measurement_nodes_t)) {
-                // calc the checksum ...
-                _u8 checksum = 0;
-                _u8 recvChecksum = ((node.s_checksum_1 & 0xF) | (node.s_checksum_2<<4));
-                for (size_t cpos = offsetof(rplidar_response_capsule_measurement_nodes_t, start_angle_sync_q6);
-                    cpos < sizeof(rplidar_response_capsule_measurement_nodes_t); ++cpos)
-                {
-                    checksum ^= nodeBuffer[cpos];
-                }
-                if (recvChecksum == checksum)
-                {
-                    // only consider vaild if the checksum matches...
-                    if (node.start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) 
-                    {
-                        // this is the first capsule frame in logic, discard the previous cached data...
-                        _is_previous_capsuledataRdy = false;
-                        return RESULT_OK;
-                    }
-                    return RESULT_OK;
-                }
-                _is_previous_capsuledataRdy = false;
-                return RESULT_INVALID_DATA;
-            }
-        }
+    if (IS_FAIL(ans) || resynced || (node.start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT)) {
+        _is_previous_capsuledataRdy = false;
     }
-    _is_previous_capsuledataRdy = false;
-    return RESULT_OPERATION_TIMEOUT;
+    return ans;
 }
 
-u_result RPlidarDriverImplCommon::_waitUltraCapsuledNode(rplidar_response_ultra_capsule_measurement_nodes_t & node, _u32 timeout)
+// Measurement answer traits used by the scan caching engine, one specialization per answer type.
+// frame_t                  what the device sends for each wait
+// MAX_NODES_PER_FRAME      upper bound of the nodes decoded from one frame
+// DECODED_ONE_FRAME_LATE   whether decode() returns the nodes received with the previous frame
+// waitFrame()              receive the next frame
+// canSkip()                whether a failed wait only loses the current frame
+// deviceTimestamp()        device clock of the nodes decode() is about to return, 0 if not supplied
+// decode()                 turn the frame into nodes, may return no node at all
+template <class TAnswer>
+struct ScanAnswerTraits;
+
+template <>
+struct ScanAnswerTraits<rplidar_response_measurement_node_t>
 {
-    if (!_isConnected) {
-        return RESULT_OPERATION_FAIL;
+    enum { MAX_NODES_PER_FRAME = 128 };
+    enum { DECODED_ONE_FRAME_LATE = 0 };
+
+    struct frame_t {
+        rplidar_response_measurement_node_t nodes[MAX_NODES_PER_FRAME];
+        size_t                              count;
+    };
+
+    static inline u_result waitFrame(RPlidarDriverImplCommon & drv, frame_t & frame)
+    {
+        frame.count = _countof(frame.nodes);
+        u_result ans = drv.RPlidarDriverImplCommon::_waitScanData(frame.nodes, frame.count, deadlineAfter(RPlidarDriver::DEFAULT_TIMEOUT));
+        // the nodes received before a timeout are still good
+        return (ans == RESULT_OPERATION_TIMEOUT) ? RESULT_OK : ans;
     }
-    
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_ultra_capsule_measurement_nodes_t)];
-    _u8 *nodeBuffer = (_u8*)&node;
-    _u32 waitTime;
-    
-    while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_ultra_capsule_measurement_nodes_t) - recvPos;
-        size_t recvSize;
 
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans)
-        {
-            return RESULT_OPERATION_TIMEOUT;
-        }
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-        
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
-            switch (recvPos) {
-            case 0: // expect the sync bit 1
-                {
-                    _u8 tmp = (currentByte>>4);
-                    if ( tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 ) {
-                    // pass
-                    }
-                    else {
-                        _is_previous_capsuledataRdy = false;
-                        continue;
-                    }
-                }    
-            break;
-            case 1: // expect the sync bit 2
-            {
-                _u8 tmp = (currentByte>>4);
-                if (tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2) {
-                    // pass
-                }
-                else {
-                    recvPos = 0;
-                    _is_previous_capsuledataRdy = false;
-                    continue;
-                }
-            }
-            break;
-            }
-            nodeBuffer[recvPos++] = currentByte;
-            if (recvPos == sizeof(rplidar_response_ultra_capsule_measurement_nodes_t)) {
-                // calc the checksum ...
-                _u8 checksum = 0;
-                _u8 recvChecksum = ((node.s_checksum_1 & 0xF) | (node.s_checksum_2 << 4));
-                
-                for (size_t cpos = offsetof(rplidar_response_ultra_capsule_measurement_nodes_t, start_angle_sync_q6);
-                cpos < sizeof(rplidar_response_ultra_capsule_measurement_nodes_t); ++cpos)
-                {
-                    checksum ^= nodeBuffer[cpos];
-                }
-                
-                if (recvChecksum == checksum)
-                {
-                    // only consider vaild if the checksum matches...
-                    if (node.start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) 
-                    {
-                        // this is the first capsule frame in logic, discard the previous cached data...
-                        _is_previous_capsuledataRdy = false;
-                        return RESULT_OK;
-                    }
-                    return RESULT_OK;
-                }
-                _is_previous_capsuledataRdy = false;
-                return RESULT_INVALID_DATA;
-            }
+    static inline bool canSkip(u_result )
+    {
+        return false;
+    }
+
+    static inline _u64 deviceTimestamp(RPlidarDriverImplCommon & , const frame_t & )
+    {
+        return 0;
+    }
+
+    static inline void decode(RPlidarDriverImplCommon & , const frame_t & frame, rplidar_response_measurement_node_hq_t * nodebuffer, size_t & nodeCount)
+    {
+        for (nodeCount = 0; nodeCount < frame.count; ++nodeCount) {
+            convert(frame.nodes[nodeCount], nodebuffer[nodeCount]);
         }
     }
-    _is_previous_capsuledataRdy = false;
-    return RESULT_OPERATION_TIMEOUT;
-}
+};
 
-u_result RPlidarDriverImplCommon::_cacheScanData()
+template <>
+struct ScanAnswerTraits<rplidar_response_capsule_measurement_nodes_t>
 {
-    rplidar_response_measurement_node_t      local_buf[128];
-    size_t                                   count = 128;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
+    enum { MAX_NODES_PER_FRAME = _countof(((rplidar_response_capsule_measurement_nodes_t *)0)->cabins) * 2 };
+    enum { DECODED_ONE_FRAME_LATE = 1 };    // the nodes decoded from a capsule are the ones of the previous capsule
+
+    typedef rplidar_response_capsule_measurement_nodes_t frame_t;
+
+    static inline u_result waitFrame(RPlidarDriverImplCommon & drv, frame_t & frame)
+    {
+        return drv.RPlidarDriverImplCommon::_waitCapsuledNode(frame, deadlineAfter(RPlidarDriver::DEFAULT_TIMEOUT));
+    }
+
+    static inline bool canSkip(u_result ans)
+    {
+        return ans == RESULT_OPERATION_TIMEOUT || ans == RESULT_INVALID_DATA;
+    }
+
+    static inline _u64 deviceTimestamp(RPlidarDriverImplCommon & , const frame_t & )
+    {
+        return 0;
+    }
+
+    static inline void decode(RPlidarDriverImplCommon & drv, const frame_t & frame, rplidar_response_measurement_node_hq_t * nodebuffer, size_t & nodeCount)
+    {
+        drv.RPlidarDriverImplCommon::_capsuleToNormal(frame, nodebuffer, nodeCount);
+    }
+};
+
+// dense capsules share the framing of the express ones
+template <>
+struct ScanAnswerTraits<rplidar_response_dense_capsule_measurement_nodes_t> : ScanAnswerTraits<rplidar_response_capsule_measurement_nodes_t>
+{
+    enum { MAX_NODES_PER_FRAME = _countof(((rplidar_response_dense_capsule_measurement_nodes_t *)0)->cabins) };
+
+    static inline void decode(RPlidarDriverImplCommon & drv, const frame_t & frame, rplidar_response_measurement_node_hq_t * nodebuffer, size_t & nodeCount)
+    {
+        drv.RPlidarDriverImplCommon::_dense_capsuleToNormal(frame, nodebuffer, nodeCount);
+    }
+};
+
+template <>
+struct ScanAnswerTraits<rplidar_response_ultra_capsule_measurement_nodes_t>
+{
+    enum { MAX_NODES_PER_FRAME = _countof(((rplidar_response_ultra_capsule_measurement_nodes_t *)0)->ultra_cabins) * 3 };
+    enum { DECODED_ONE_FRAME_LATE = 1 };
+
+    typedef rplidar_response_ultra_capsule_measurement_nodes_t frame_t;
+
+    static inline u_result waitFrame(RPlidarDriverImplCommon & drv, frame_t & frame)
+    {
+        return drv.RPlidarDriverImplCommon::_waitUltraCapsuledNode(frame, deadlineAfter(RPlidarDriver::DEFAULT_TIMEOUT));
+    }
+
+    static inline bool canSkip(u_result ans)
+    {
+        return ans == RESULT_OPERATION_TIMEOUT || ans == RESULT_INVALID_DATA;
+    }
+
+    static inline _u64 deviceTimestamp(RPlidarDriverImplCommon & , const frame_t & )
+    {
+        return 0;
+    }
+
+    static inline void decode(RPlidarDriverImplCommon & drv, const frame_t & frame, rplidar_response_measurement_node_hq_t * nodebuffer, size_t & nodeCount)
+    {
+        drv.RPlidarDriverImplCommon::_ultraCapsuleToNormal(frame, nodebuffer, nodeCount);
+    }
+};
+
+template <>
+struct ScanAnswerTraits<rplidar_response_hq_capsule_measurement_nodes_t>
+{
+    enum { MAX_NODES_PER_FRAME = _countof(((rplidar_response_hq_capsule_measurement_nodes_t *)0)->node_hq) };
+    enum { DECODED_ONE_FRAME_LATE = 0 };    // HQ nodes are complete, decode() returns the ones of the capsule given
+
+    typedef rplidar_response_hq_capsule_measurement_nodes_t frame_t;
+
+    static inline u_result waitFrame(RPlidarDriverImplCommon & drv, frame_t & frame)
+    {
+        return drv.RPlidarDriverImplCommon::_waitHqNode(frame, deadlineAfter(RPlidarDriver::DEFAULT_TIMEOUT));
+    }
+
+    static inline bool canSkip(u_result ans)
+    {
+        return ans == RESULT_OPERATION_TIMEOUT || ans == RESULT_INVALID_DATA;
+    }
+
+    static inline _u64 deviceTimestamp(RPlidarDriverImplCommon & , const frame_t & frame)
+    {
+        return frame.time_stamp;
+    }
+
+    static inline void decode(RPlidarDriverImplCommon & drv, const frame_t & frame, rplidar_response_measurement_node_hq_t * nodebuffer, size_t & nodeCount)
+    {
+        drv.RPlidarDriverImplCommon::_HqToNormal(frame, nodebuffer, nodeCount);
+    }
+};
+
+template <class TAnswer>
+u_result RPlidarDriverImplCommon::_cacheScanDataT()
+{
+    typedef ScanAnswerTraits<TAnswer> Traits;
+
+    typename Traits::frame_t                 frame;
+    rplidar_response_measurement_node_hq_t   local_buf[Traits::MAX_NODES_PER_FRAME];
+    _u64                                     local_ts[Traits::MAX_NODES_PER_FRAME];
+    size_t                                   count = 0;
+    rplidar_response_measurement_node_hq_t * local_scan = _scan_pool.writeBuffer();
+    _u32 *                                   local_scan_offsets = _scan_pool.writeHostOffsets();
+    _u64 *                                   local_scan_device_ts = _scan_pool.writeDeviceTimestamps();
+    const size_t                             scan_capacity = _scan_pool.getMaxNodes();
     size_t                                   scan_count = 0;
+    size_t                                   scan_dropped = 0;
+    size_t                                   scan_arrays_count = 0;  // nodes of the revolution already in the optional arrays
+    _u64                                     scan_start_ts = 0;
+    _u64                                     previous_frame_ts = 0;
+    _u64                                     last_sample_ts = 0;
+    const float                              us_per_sample = _cached_scan_us_per_sample;
     u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
+    memset(local_scan, 0, sizeof(*local_scan)); // the first revolution is incomplete and must not be published
 
-    _waitScanData(local_buf, count); // // always discard the first data since it may be incomplete
+    _enterRealtimeProfile();
+    _resetRxStream();
+    Traits::waitFrame(*this, frame); // always discard the first data since it may be incomplete
 
     while(_isScanning)
     {
-        if (IS_FAIL(ans=_waitScanData(local_buf, count))) {
-            if (ans != RESULT_OPERATION_TIMEOUT) {
+        if (IS_FAIL(ans = Traits::waitFrame(*this, frame))) {
+            if (!Traits::canSkip(ans)) {
                 _isScanning = false;
                 return RESULT_OPERATION_FAIL;
+            } else {
+                // current data is invalid, do not use it.
+                continue;
             }
         }
-        
+
+        _u64 frame_ts = _rxFrameTimestamp();
+        _u64 device_ts = Traits::deviceTimestamp(*this, frame);
+        Traits::decode(*this, frame, local_buf, count);
+
+        // the samples are evenly spaced and the last one was taken just before the frame holding it was sent,
+        // the timestamps never go backward even when frames are delivered in bursts
+        _u64 samples_end_ts = Traits::DECODED_ONE_FRAME_LATE ? previous_frame_ts : frame_ts;
+        previous_frame_ts = frame_ts;
+        for (size_t pos = 0; pos < count; ++pos)
+        {
+            _u64 backward = (_u64)((count - 1 - pos) * us_per_sample);
+            _u64 sample_ts = samples_end_ts > backward ? samples_end_ts - backward : 0;
+            if (sample_ts < last_sample_ts) sample_ts = last_sample_ts;
+            local_ts[pos] = last_sample_ts = sample_ts;
+        }
+
         for (size_t pos = 0; pos < count; ++pos)
         {
-            if (local_buf[pos].sync_quality & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
+            if (local_buf[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
             {
                 // only publish the data when it contains a full 360 degree scan 
                 
                 if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count*sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
+                    _scan_pool.writeArrays(scan_arrays_count, scan_count);
+                    if (scan_dropped) rp::hal::atomic_fetch_add(&_truncated_scan_count, 1);
+                    local_scan = _scan_pool.publish(scan_count, scan_dropped, scan_start_ts, frame_ts);
+                    local_scan_offsets = _scan_pool.writeHostOffsets();
+                    local_scan_device_ts = _scan_pool.writeDeviceTimestamps();
                     _dataEvt.set();
-                    _lock.unlock();
+                    for (_u32 id = 0; id < MAX_SCAN_SUBSCRIBERS; ++id) {
+                        if (rp::hal::atomic_load(&_scan_subscribers[id].active)) _scan_subscribers[id].dataEvt.set();
+                    }
                 }
                 scan_count = 0;
+                scan_dropped = 0;
+                scan_arrays_count = 0;
+                scan_start_ts = local_ts[pos];
             }
-
-            rplidar_response_measurement_node_hq_t nodeHq;
-            convert(local_buf[pos], nodeHq);
-            local_scan[scan_count++] = nodeHq;
-            if (scan_count == _countof(local_scan)) scan_count-=1; // prevent overflow
-
-            //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = nodeHq;
-                if(_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve-=1; // prevent overflow
+            if (scan_count == scan_capacity) {
+                // the motor runs slower than the buffers were sized for
+                ++scan_dropped;
+                continue;
             }
+            local_scan_offsets[scan_count] = (_u32)(local_ts[pos] - scan_start_ts);
+            local_scan_device_ts[scan_count] = device_ts;
+            local_scan[scan_count++] = local_buf[pos];
         }
+        // while the frame is still in cache
+        _scan_pool.writeArrays(scan_arrays_count, scan_count);
+        scan_arrays_count = scan_count;
+
+        //for interval retrieve
+        _interval_ring.push(local_buf, count);
+        _point_history.push(local_buf, local_ts, count);
     }
     _isScanning = false;
     return RESULT_OK;
 }
 
+u_result RPlidarDriverImplCommon::_cacheScanData()
+{
+    return _cacheScanDataT<rplidar_response_measurement_node_t>();
+}
+
 u_result RPlidarDriverImplCommon::startScanNormal(bool force,  _u32 timeout)
 {
     u_result ans;
@@ -600,6 +914,7 @@ u_result RPlidarDriverImplCommon::startScanNormal(bool force,  _u32 timeout)
     if (_isScanning) return RESULT_ALREADY_DONE;
 
     stop(); //force the previous operation to stop
+    if (_cachethread.getHandle()) return RESULT_OPERATION_TIMEOUT;
 
     {
         rp::hal::AutoLocker l(_lock);
@@ -609,8 +924,9 @@ u_result RPlidarDriverImplCommon::startScanNormal(bool force,  _u32 timeout)
         }
 
         // waiting for confirmation
+        _u64 deadline_us = deadlineAfter(timeout);
         rplidar_ans_header_t response_header;
-        if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
+        if (IS_FAIL(ans = _waitResponseHeader(&response_header, deadline_us))) {
             return ans;
         }
 
@@ -624,11 +940,16 @@ u_result RPlidarDriverImplCommon::startScanNormal(bool force,  _u32 timeout)
             return RESULT_INVALID_DATA;
         }
 
+        if (IS_FAIL(ans = _setupScanArena(_cached_sampleduration_std))) {
+            return ans;
+        }
+        _cached_scan_us_per_sample = _cached_sampleduration_std;
         _isScanning = true;
         _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheScanData);
         if (_cachethread.getHandle() == 0) {
             return RESULT_OPERATION_FAIL;
         }
+        _applyRealtimeProfile();
     }
     return RESULT_OK;
 }
@@ -657,128 +978,16 @@ u_result RPlidarDriverImplCommon::checkExpressScanSupported(bool & support, _u32
 
 u_result RPlidarDriverImplCommon::_cacheCapsuledScanData()
 {
-    rplidar_response_capsule_measurement_nodes_t    capsule_node;
-    rplidar_response_measurement_node_hq_t   local_buf[128];
-    size_t                                   count = 128;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-    size_t                                   scan_count = 0;
-    u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
-
-    _waitCapsuledNode(capsule_node); // // always discard the first data since it may be incomplete
-
-    
-    
-
-    while(_isScanning)
-    {
-        if (IS_FAIL(ans=_waitCapsuledNode(capsule_node))) {
-            if (ans != RESULT_OPERATION_TIMEOUT && ans != RESULT_INVALID_DATA) {
-                _isScanning = false;
-                return RESULT_OPERATION_FAIL;
-            } else {
-                // current data is invalid, do not use it.
-                continue;
-            }
-        }
-        switch (_cached_express_flag) 
-        {
-        case 0:
-            _capsuleToNormal(capsule_node, local_buf, count);
-            break;
-        case 1:
-            _dense_capsuleToNormal(capsule_node, local_buf, count);
-            break;
-        }
-        //
-        
-        for (size_t pos = 0; pos < count; ++pos)
-        {
-            if (local_buf[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
-            {
-                // only publish the data when it contains a full 360 degree scan 
-                
-                if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count*sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
-                    _dataEvt.set();
-                    _lock.unlock();
-                }
-                scan_count = 0;
-            }
-            local_scan[scan_count++] = local_buf[pos];
-            if (scan_count == _countof(local_scan)) scan_count-=1; // prevent overflow
-
-            //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                if(_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve-=1; // prevent overflow
-            }
-        }
+    // the capsule format does not change during a scan
+    if (_cached_express_flag == 1) {
+        return _cacheScanDataT<rplidar_response_dense_capsule_measurement_nodes_t>();
     }
-    _isScanning = false;
-
-    return RESULT_OK;
+    return _cacheScanDataT<rplidar_response_capsule_measurement_nodes_t>();
 }
 
 u_result RPlidarDriverImplCommon::_cacheUltraCapsuledScanData()
-{
-    rplidar_response_ultra_capsule_measurement_nodes_t    ultra_capsule_node;
-    rplidar_response_measurement_node_hq_t   local_buf[128];
-    size_t                                   count = 128;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-    size_t                                   scan_count = 0;
-    u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
-
-    _waitUltraCapsuledNode(ultra_capsule_node);
-    
-    while(_isScanning)
-    {
-        if (IS_FAIL(ans=_waitUltraCapsuledNode(ultra_capsule_node))) {
-            if (ans != RESULT_OPERATION_TIMEOUT && ans != RESULT_INVALID_DATA) {
-                _isScanning = false;
-                return RESULT_OPERATION_FAIL;
-            } else {
-                // current data is invalid, do not use it.
-                continue;
-            }
-        }
-        
-        _ultraCapsuleToNormal(ultra_capsule_node, local_buf, count);
-        
-        for (size_t pos = 0; pos < count; ++pos)
-        {
-            if (local_buf[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
-            {
-                // only publish the data when it contains a full 360 degree scan 
-                
-                if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count*sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
-                    _dataEvt.set();
-                    _lock.unlock();
-                }
-                scan_count = 0;
-            }
-            local_scan[scan_count++] = local_buf[pos];
-            if (scan_count == _countof(local_scan)) scan_count-=1; // prevent overflow
-
-            //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                if(_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve-=1; // prevent overflow
-            }
-        }
-    }
-    
-    _isScanning = false;
-
-    return RESULT_OK;
+{
+    return _cacheScanDataT<rplidar_response_ultra_capsule_measurement_nodes_t>();
 }
 
 void     RPlidarDriverImplCommon::_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
@@ -796,43 +1005,27 @@ void     RPlidarDriverImplCommon::_capsuleToNormal(const rplidar_response_capsul
 
         int angleInc_q16 = (diffAngle_q8 << 3);
         int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-        for (size_t pos = 0; pos < _countof(_cached_previous_capsuledata.cabins); ++pos)
-        {
-            int dist_q2[2];
-            int angle_q6[2];
-            int syncBit[2];
-
-            dist_q2[0] = (_cached_previous_capsuledata.cabins[pos].distance_angle_1 & 0xFFFC);
-            dist_q2[1] = (_cached_previous_capsuledata.cabins[pos].distance_angle_2 & 0xFFFC);
-
-            int angle_offset1_q3 = ( (_cached_previous_capsuledata.cabins[pos].offset_angles_q3 & 0xF) | ((_cached_previous_capsuledata.cabins[pos].distance_angle_1 & 0x3)<<4));
-            int angle_offset2_q3 = ( (_cached_previous_capsuledata.cabins[pos].offset_angles_q3 >> 4) | ((_cached_previous_capsuledata.cabins[pos].distance_angle_2 & 0x3)<<4));
-
-            angle_q6[0] = ((currentAngle_raw_q16 - (angle_offset1_q3<<13))>>10);
-            syncBit[0] =  (( (currentAngle_raw_q16 + angleInc_q16) % (360<<16)) < angleInc_q16 )?1:0;
-            currentAngle_raw_q16 += angleInc_q16;
-
-
-            angle_q6[1] = ((currentAngle_raw_q16 - (angle_offset2_q3<<13))>>10);
-            syncBit[1] =  (( (currentAngle_raw_q16 + angleInc_q16) % (360<<16)) < angleInc_q16 )?1:0;
-            currentAngle_raw_q16 += angleInc_q16;
-
-            for (int cpos = 0; cpos < 2; ++cpos) {
 
-                if (angle_q6[cpos] < 0) angle_q6[cpos] += (360<<6);
-                if (angle_q6[cpos] >= (360<<6)) angle_q6[cpos] -= (360<<6);
+        const size_t cabinCount = _countof(_cached_previous_capsuledata.cabins);
+        int  angleOffset_q16[cabinCount * 2];
+        _u32 dist_q2[cabinCount * 2];
 
-                rplidar_response_measurement_node_hq_t node;
+        for (size_t pos = 0; pos < cabinCount; ++pos)
+        {
+            const rplidar_response_cabin_nodes_t & cabin = _cached_previous_capsuledata.cabins[pos];
 
-                node.angle_z_q14 = _u16((angle_q6[cpos] << 8) / 90);
-                node.flag = (syncBit[cpos] | ((!syncBit[cpos]) << 1));
-                node.quality = dist_q2[cpos] ? (0x2f << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
-                node.dist_mm_q2 = dist_q2[cpos];
+            dist_q2[pos * 2] = (cabin.distance_angle_1 & 0xFFFC);
+            dist_q2[pos * 2 + 1] = (cabin.distance_angle_2 & 0xFFFC);
 
-                nodebuffer[nodeCount++] = node;
-             }
+            int angle_offset1_q3 = ( (cabin.offset_angles_q3 & 0xF) | ((cabin.distance_angle_1 & 0x3)<<4));
+            int angle_offset2_q3 = ( (cabin.offset_angles_q3 >> 4) | ((cabin.distance_angle_2 & 0x3)<<4));
 
+            angleOffset_q16[pos * 2] = (angle_offset1_q3 << 13);
+            angleOffset_q16[pos * 2 + 1] = (angle_offset2_q3 << 13);
         }
+
+        capsule_decoder::decode(currentAngle_raw_q16, angleInc_q16, angleOffset_q16, dist_q2, cabinCount * 2, nodebuffer);
+        nodeCount = cabinCount * 2;
     }
 
     _cached_previous_capsuledata = capsule;
@@ -855,33 +1048,18 @@ void     RPlidarDriverImplCommon::_dense_capsuleToNormal(const rplidar_response_
 
         int angleInc_q16 = (diffAngle_q8 << 8)/40;
         int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-        for (size_t pos = 0; pos < _countof(_cached_previous_dense_capsuledata.cabins); ++pos)
-        {
-            int dist_q2;
-            int angle_q6;
-            int syncBit;
-            const int dist = static_cast<const int>(_cached_previous_dense_capsuledata.cabins[pos].distance);
-            dist_q2 = dist << 2;
-            angle_q6 = (currentAngle_raw_q16 >> 10);
-            syncBit = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
-            currentAngle_raw_q16 += angleInc_q16;
-
-            if (angle_q6 < 0) angle_q6 += (360 << 6);
-            if (angle_q6 >= (360 << 6)) angle_q6 -= (360 << 6);
 
-            
-
-            rplidar_response_measurement_node_hq_t node;
-
-            node.angle_z_q14 = _u16((angle_q6 << 8) / 90);
-            node.flag = (syncBit | ((!syncBit) << 1));
-            node.quality = dist_q2 ? (0x2f << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
-            node.dist_mm_q2 = dist_q2;
-
-            nodebuffer[nodeCount++] = node;
-            
+        const size_t cabinCount = _countof(_cached_previous_dense_capsuledata.cabins);
+        static const int angleOffset_q16[cabinCount] = { 0 };
+        _u32 dist_q2[cabinCount];
 
+        for (size_t pos = 0; pos < cabinCount; ++pos)
+        {
+            dist_q2[pos] = static_cast<_u32>(_cached_previous_dense_capsuledata.cabins[pos].distance) << 2;
         }
+
+        capsule_decoder::decode(currentAngle_raw_q16, angleInc_q16, angleOffset_q16, dist_q2, cabinCount, nodebuffer);
+        nodeCount = cabinCount;
     }
 
     _cached_previous_dense_capsuledata = *dense_capsule;
@@ -890,196 +1068,20 @@ void     RPlidarDriverImplCommon::_dense_capsuleToNormal(const rplidar_response_
 
 u_result RPlidarDriverImplCommon::_cacheHqScanData()
 {
-    rplidar_response_hq_capsule_measurement_nodes_t    hq_node;
-    rplidar_response_measurement_node_hq_t   local_buf[128];
-    size_t                                   count = 128;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-    size_t                                   scan_count = 0;
-    u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
-    _waitHqNode(hq_node);
-    while (_isScanning) {
-        if (IS_FAIL(ans = _waitHqNode(hq_node))) {
-            if (ans != RESULT_OPERATION_TIMEOUT && ans != RESULT_INVALID_DATA) {
-                _isScanning = false;
-                return RESULT_OPERATION_FAIL;
-            }
-            else {
-				// current data is invalid, do not use it.
-				continue;
-            }
-        }
-
-        _HqToNormal(hq_node, local_buf, count);
-        for (size_t pos = 0; pos < count; ++pos)
-        {
-            if (local_buf[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
-            {
-				// only publish the data when it contains a full 360 degree scan 
-                if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count * sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
-                    _dataEvt.set();
-                    _lock.unlock();
-                }
-                scan_count = 0;
-            }
-            local_scan[scan_count++] = local_buf[pos];
-            if (scan_count == _countof(local_scan)) scan_count -= 1; // prevent overflow
-																	 //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                if (_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve -= 1; // prevent overflow
-            }
-        }
-
-    }
-    return RESULT_OK;
-}
-
-//CRC calculate
-static _u32 table[256];//crc32_table
-
-//reflect
-static _u32 _bitrev(_u32 input, _u16 bw)
-{
-    _u16 i;
-    _u32 var;
-    var = 0;
-    for (i = 0; i<bw; i++){
-        if (input & 0x01)
-        {
-            var |= 1 << (bw - 1 - i);
-        }
-        input >>= 1;
-    }
-    return var;
-}
-
-// crc32_table init
-static void _crc32_init(_u32 poly)
-{
-    _u16 i;
-    _u16 j;
-    _u32 c;
-    
-    poly = _bitrev(poly, 32);
-    for (i = 0; i<256; i++){
-        c = i;
-        for (j = 0; j<8; j++){
-            if (c & 1)
-                c = poly ^ (c >> 1);
-            else
-                c = c >> 1;
-        }
-        table[i] = c;
-    }
-}
-
-static _u32 _crc32cal(_u32 crc, void* input, _u16 len)
-{
-    _u16 i;
-    _u8 index;
-    _u8* pch;
-    pch = (unsigned char*)input;
-    _u8 leftBytes = 4 - len & 0x3;
-
-    for (i = 0; i<len; i++){
-        index = (unsigned char)(crc^*pch);
-        crc = (crc >> 8) ^ table[index];
-        pch++;
-    }
-
-    for (i = 0; i < leftBytes; i++) {//zero padding
-        index = (unsigned char)(crc^0);
-        crc = (crc >> 8) ^ table[index];
-    }
-    return crc^0xffffffff;
-}
-
-//crc32cal
-static u_result _crc32(_u8 *ptr, _u32 len) {
-	static _u8 tmp;
-	if (tmp != 1) {
-		_crc32_init(0x4C11DB7);
-		tmp = 1;
-	}
-	
-	return _crc32cal(0xFFFFFFFF, ptr,len);
+    return _cacheScanDataT<rplidar_response_hq_capsule_measurement_nodes_t>();
 }
 
-u_result RPlidarDriverImplCommon::_waitHqNode(rplidar_response_hq_capsule_measurement_nodes_t & node, _u32 timeout)
+u_result RPlidarDriverImplCommon::_waitHqNode(rplidar_response_hq_capsule_measurement_nodes_t & node, _u64 deadline_us)
 {
     if (!_isConnected) {
         return RESULT_OPERATION_FAIL;
     }
 
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_hq_capsule_measurement_nodes_t)];
-    _u8 *nodeBuffer = (_u8*)&node;
-    _u32 waitTime;
-    
-    while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - recvPos;
-        size_t recvSize;
-        
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans)
-        {
-            return RESULT_OPERATION_TIMEOUT;
-        }
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-    
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
-            switch (recvPos) {
-            case 0: // expect the sync byte
-                {
-                    _u8 tmp = (currentByte);
-                    if ( tmp == RPLIDAR_RESP_MEASUREMENT_HQ_SYNC ) {
-                    // pass
-                    }
-                    else {
-                        recvPos = 0;
-                        _is_previous_HqdataRdy = false;
-                        continue;
-                    }
-                }
-           break;
-           case sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - 1 - 4: 
-            {
-
-            }
-           break;
-           case sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - 1: 
-            {				
-
-            }
-           break;
-           }
-           nodeBuffer[recvPos++] = currentByte;
-           if (recvPos == sizeof(rplidar_response_hq_capsule_measurement_nodes_t)) {
-                _u32 crcCalc2 = _crc32(nodeBuffer, sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - 4);
-
-                if(crcCalc2 == node.crc32){
-                    _is_previous_HqdataRdy = true;
-                    return RESULT_OK;
-                }
-                else {
-                    _is_previous_HqdataRdy = false;
-                    return RESULT_INVALID_DATA;
-                }
+    bool resynced;
+    u_result ans = _waitStreamFrame<HqCapsuleFrameSpec>(reinterpret_cast<_u8 *>(&node), deadline_us, resynced);
 
-            }
-        }
-    }
-    _is_previous_HqdataRdy = false;
-    return RESULT_OPERATION_TIMEOUT;
+    _is_previous_HqdataRdy = IS_OK(ans);
+    return ans;
 }
 
 void RPlidarDriverImplCommon::_HqToNormal(const rplidar_response_hq_capsule_measurement_nodes_t & node_hq, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount) 
@@ -1097,47 +1099,63 @@ void RPlidarDriverImplCommon::_HqToNormal(const rplidar_response_hq_capsule_meas
 }
 //*******************************************HQ support********************************//
 
-static _u32 _varbitscale_decode(_u32 scaled, _u32 & scaleLevel)
+static const _u32 VBS_SCALED_BASE[] = {
+    0,
+    RPLIDAR_VARBITSCALE_X2_DEST_VAL,
+    RPLIDAR_VARBITSCALE_X4_DEST_VAL,
+    RPLIDAR_VARBITSCALE_X8_DEST_VAL,
+    RPLIDAR_VARBITSCALE_X16_DEST_VAL,
+};
+
+static const _u32 VBS_TARGET_BASE[] = {
+    0,
+    (0x1 << RPLIDAR_VARBITSCALE_X2_SRC_BIT),
+    (0x1 << RPLIDAR_VARBITSCALE_X4_SRC_BIT),
+    (0x1 << RPLIDAR_VARBITSCALE_X8_SRC_BIT),
+    (0x1 << RPLIDAR_VARBITSCALE_X16_SRC_BIT),
+};
+
+static inline _u32 _varbitscale_decode(_u32 scaled, _u32 & scaleLevel)
 {
-    static const _u32 VBS_SCALED_BASE[] = {
-        RPLIDAR_VARBITSCALE_X16_DEST_VAL,
-        RPLIDAR_VARBITSCALE_X8_DEST_VAL,
-        RPLIDAR_VARBITSCALE_X4_DEST_VAL,
-        RPLIDAR_VARBITSCALE_X2_DEST_VAL,
-        0,
-    };
+    // the scale level is the number of segment bases reached, no search needed
+    scaleLevel = (scaled >= RPLIDAR_VARBITSCALE_X2_DEST_VAL) + (scaled >= RPLIDAR_VARBITSCALE_X4_DEST_VAL)
+               + (scaled >= RPLIDAR_VARBITSCALE_X8_DEST_VAL) + (scaled >= RPLIDAR_VARBITSCALE_X16_DEST_VAL);
+    return VBS_TARGET_BASE[scaleLevel] + ((scaled - VBS_SCALED_BASE[scaleLevel]) << scaleLevel);
+}
 
-    static const _u32 VBS_SCALED_LVL[] = {
-        4,
-        3,
-        2,
-        1,
-        0,
-    };
+// The angle compensation of an ultra capsule sample only depends on its distance:
+// it is constant below 50mm and a function of k2 = 98361 / dist_q2 above.
+// The table holds the final offset (q16, in degree) for every k2, the near value comes last.
+enum {
+    ULTRA_OFFSET_K1         = 98361,
+    ULTRA_OFFSET_MIN_DIST   = 50 * 4,
+    ULTRA_OFFSET_NEAR_INDEX = ULTRA_OFFSET_K1 / ULTRA_OFFSET_MIN_DIST + 1,
+};
 
-    static const _u32 VBS_TARGET_BASE[] = {
-        (0x1 << RPLIDAR_VARBITSCALE_X16_SRC_BIT),
-        (0x1 << RPLIDAR_VARBITSCALE_X8_SRC_BIT),
-        (0x1 << RPLIDAR_VARBITSCALE_X4_SRC_BIT),
-        (0x1 << RPLIDAR_VARBITSCALE_X2_SRC_BIT),
-        0,
-    };
+static int _ultra_angle_offset_q16[ULTRA_OFFSET_NEAR_INDEX + 1];
 
-    for (size_t i = 0; i < _countof(VBS_SCALED_BASE); ++i)
-    {
-        int remain = ((int)scaled - (int)VBS_SCALED_BASE[i]);
-        if (remain >= 0) {
-            scaleLevel = VBS_SCALED_LVL[i];
-            return VBS_TARGET_BASE[i] + (remain << scaleLevel);
-        }
+BEGIN_STATIC_CODE(ultra_angle_offset)
+{
+    for (int k2 = 0; k2 < ULTRA_OFFSET_NEAR_INDEX; ++k2) {
+        int offsetAngleMean_q16 = (int)(8 * 3.1415926535 * (1 << 16) / 180) - (k2 << 6) - (k2 * k2 * k2) / 98304;
+        _ultra_angle_offset_q16[k2] = int(offsetAngleMean_q16 * 180 / 3.14159265);
     }
-    return 0;
+
+    int offsetAngleMean_q16 = (int)(7.5 * 3.1415926535 * (1 << 16) / 180.0);
+    _ultra_angle_offset_q16[ULTRA_OFFSET_NEAR_INDEX] = int(offsetAngleMean_q16 * 180 / 3.14159265);
+}END_STATIC_CODE(ultra_angle_offset)
+
+static inline int _ultraAngleOffset_q16(int dist_q2)
+{
+    if (dist_q2 < ULTRA_OFFSET_MIN_DIST) return _ultra_angle_offset_q16[ULTRA_OFFSET_NEAR_INDEX];
+    return _ultra_angle_offset_q16[dist_q2 > ULTRA_OFFSET_K1 ? 0 : ULTRA_OFFSET_K1 / dist_q2];
 }
 
 void RPlidarDriverImplCommon::_ultraCapsuleToNormal(const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
 {
     nodeCount = 0;
     if (_is_previous_capsuledataRdy) {
+        const size_t cabinCount = _countof(_cached_previous_ultracapsuledata.ultra_cabins);
         int diffAngle_q8;
         int currentStartAngle_q8 = ((capsule.start_angle_sync_q6 & 0x7FFF) << 2);
         int prevStartAngle_q8 = ((_cached_previous_ultracapsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
@@ -1149,100 +1167,62 @@ void RPlidarDriverImplCommon::_ultraCapsuleToNormal(const rplidar_response_ultra
 
         int angleInc_q16 = (diffAngle_q8 << 3) / 3;
         int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-        for (size_t pos = 0; pos < _countof(_cached_previous_ultracapsuledata.ultra_cabins); ++pos)
+
+        // decode every major distance once, the last cabin predicts from the first one of the current capsule
+        int  dist_major[cabinCount + 1];
+        _u32 scalelvl[cabinCount + 1];
+        for (size_t pos = 0; pos < cabinCount; ++pos) {
+            dist_major[pos] = _varbitscale_decode(_cached_previous_ultracapsuledata.ultra_cabins[pos].combined_x3 & 0xFFF, scalelvl[pos]);
+        }
+        dist_major[cabinCount] = _varbitscale_decode(capsule.ultra_cabins[0].combined_x3 & 0xFFF, scalelvl[cabinCount]);
+
+        int  angleOffset_q16[cabinCount * 3];
+        _u32 node_dist_q2[cabinCount * 3];
+
+        for (size_t pos = 0; pos < cabinCount; ++pos)
         {
             int dist_q2[3];
-            int angle_q6[3];
-            int syncBit[3];
-
 
             _u32 combined_x3 = _cached_previous_ultracapsuledata.ultra_cabins[pos].combined_x3;
 
-            // unpack ...
-            int dist_major = (combined_x3 & 0xFFF);
-
             // signed partical integer, using the magic shift here
             // DO NOT TOUCH
 
             int dist_predict1 = (((int)(combined_x3 << 10)) >> 22);
             int dist_predict2 = (((int)combined_x3) >> 22);
 
-            int dist_major2;
-
-            _u32 scalelvl1, scalelvl2;
-
-            // prefetch next ...
-            if (pos == _countof(_cached_previous_ultracapsuledata.ultra_cabins) - 1)
-            {
-                dist_major2 = (capsule.ultra_cabins[0].combined_x3 & 0xFFF);
-            }
-            else {
-                dist_major2 = (_cached_previous_ultracapsuledata.ultra_cabins[pos + 1].combined_x3 & 0xFFF);
-            }
-
-            // decode with the var bit scale ...
-            dist_major = _varbitscale_decode(dist_major, scalelvl1);
-            dist_major2 = _varbitscale_decode(dist_major2, scalelvl2);
-
+            int dist_base1 = dist_major[pos];
+            int dist_base2 = dist_major[pos + 1];
+            _u32 scalelvl1 = scalelvl[pos];
+            _u32 scalelvl2 = scalelvl[pos + 1];
 
-            int dist_base1 = dist_major;
-            int dist_base2 = dist_major2;
-
-            if ((!dist_major) && dist_major2) {
-                dist_base1 = dist_major2;
+            if ((!dist_base1) && dist_base2) {
+                dist_base1 = dist_base2;
                 scalelvl1 = scalelvl2;
             }
 
-           
-            dist_q2[0] = (dist_major << 2);
-            if ((dist_predict1 == 0xFFFFFE00) || (dist_predict1 == 0x1FF)) {
+            dist_q2[0] = (dist_major[pos] << 2);
+            if ((dist_predict1 == (int)0xFFFFFE00) || (dist_predict1 == 0x1FF)) {
                 dist_q2[1] = 0;
             } else {
-                dist_predict1 = (dist_predict1 << scalelvl1);
-                dist_q2[1] = (dist_predict1 + dist_base1) << 2;
-
+                dist_q2[1] = ((dist_predict1 << scalelvl1) + dist_base1) << 2;
             }
 
-            if ((dist_predict2 == 0xFFFFFE00) || (dist_predict2 == 0x1FF)) {
+            if ((dist_predict2 == (int)0xFFFFFE00) || (dist_predict2 == 0x1FF)) {
                 dist_q2[2] = 0;
             } else {
-                dist_predict2 = (dist_predict2 << scalelvl2);
-                dist_q2[2] = (dist_predict2 + dist_base2) << 2;
+                dist_q2[2] = ((dist_predict2 << scalelvl2) + dist_base2) << 2;
             }
-           
 
             for (int cpos = 0; cpos < 3; ++cpos)
             {
-
-                syncBit[cpos] = (((currentAngle_raw_q16 + angleInc_q16) % (360 << 16)) < angleInc_q16) ? 1 : 0;
-
-                int offsetAngleMean_q16 = (int)(7.5 * 3.1415926535 * (1 << 16) / 180.0);
-
-                if (dist_q2[cpos] >= (50 * 4))
-                {
-                    const int k1 = 98361;
-                    const int k2 = int(k1 / dist_q2[cpos]);
-
-                    offsetAngleMean_q16 = (int)(8 * 3.1415926535 * (1 << 16) / 180) - (k2 << 6) - (k2 * k2 * k2) / 98304;
-                }
-
-                angle_q6[cpos] = ((currentAngle_raw_q16 - int(offsetAngleMean_q16 * 180 / 3.14159265)) >> 10);
-                currentAngle_raw_q16 += angleInc_q16;
-
-                if (angle_q6[cpos] < 0) angle_q6[cpos] += (360 << 6);
-                if (angle_q6[cpos] >= (360 << 6)) angle_q6[cpos] -= (360 << 6);
-
-                rplidar_response_measurement_node_hq_t node;
-
-                node.flag = (syncBit[cpos] | ((!syncBit[cpos]) << 1));
-                node.quality = dist_q2[cpos] ? (0x2F << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT) : 0;
-                node.angle_z_q14 = _u16((angle_q6[cpos] << 8) / 90);
-                node.dist_mm_q2 = dist_q2[cpos];
-
-                nodebuffer[nodeCount++] = node;
+                angleOffset_q16[pos * 3 + cpos] = _ultraAngleOffset_q16(dist_q2[cpos]);
+                node_dist_q2[pos * 3 + cpos] = dist_q2[cpos];
             }
-
         }
+
+        capsule_decoder::decode(currentAngle_raw_q16, angleInc_q16, angleOffset_q16, node_dist_q2, cabinCount * 3, nodebuffer);
+        nodeCount = cabinCount * 3;
     }
 
     _cached_previous_ultracapsuledata = capsule;
@@ -1285,8 +1265,9 @@ u_result RPlidarDriverImplCommon::getLidarConf(_u32 type, std::vector<_u8> &outp
         }
 
         // waiting for confirmation
+        _u64 deadline_us = deadlineAfter(timeout);
         rplidar_ans_header_t response_header;
-        if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
+        if (IS_FAIL(ans = _waitResponseHeader(&response_header, deadline_us))) {
             return ans;
         }
 
@@ -1300,13 +1281,13 @@ u_result RPlidarDriverImplCommon::getLidarConf(_u32 type, std::vector<_u8> &outp
             return RESULT_INVALID_DATA;
         }
 
-        if (!_chanDev->waitfordata(header_size, timeout)) {
+        if (!_chanDev->waitfordataUntil(header_size, deadline_us)) {
             return RESULT_OPERATION_TIMEOUT;
         }
 
         std::vector<_u8> dataBuf;
         dataBuf.resize(header_size);
-        _chanDev->recvdata(reinterpret_cast<_u8 *>(&dataBuf[0]), header_size);
+        _recvChannel(reinterpret_cast<_u8 *>(&dataBuf[0]), header_size);
 
         //check if returned type is same as asked type
         _u32 replyType = -1;
@@ -1618,6 +1599,10 @@ u_result RPlidarDriverImplCommon::startScan(bool force, bool useTypicalScan, _u3
         }
     }
 
+    if (outUsedScanMode) {
+        // keep the accurate duration of the mode to time the samples
+        _cached_sampleduration_std = (_u16)(outUsedScanMode->us_per_sample + 0.5f);
+    }
     return startScanNormal(force);
 }
 
@@ -1628,6 +1613,7 @@ u_result RPlidarDriverImplCommon::startScanExpress(bool force, _u16 scanMode, _u
     if (_isScanning) return RESULT_ALREADY_DONE;
 
     stop(); //force the previous operation to stop
+    if (_cachethread.getHandle()) return RESULT_OPERATION_TIMEOUT;
 
     if (scanMode == RPLIDAR_CONF_SCAN_COMMAND_STD)
     {
@@ -1694,6 +1680,17 @@ u_result RPlidarDriverImplCommon::startScanExpress(bool force, _u16 scanMode, _u
         scanAnsType = RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED;
     }
 
+    //get the sample duration to time the samples
+    float usPerSample = _cached_sampleduration_express;
+    if (outUsedScanMode)
+    {
+        usPerSample = outUsedScanMode->us_per_sample;
+    }
+    else if (ifSupportLidarConf)
+    {
+        getLidarSampleDuration(usPerSample, scanMode);
+    }
+
     {
         rp::hal::AutoLocker l(_lock);
 
@@ -1702,14 +1699,19 @@ u_result RPlidarDriverImplCommon::startScanExpress(bool force, _u16 scanMode, _u
         if (scanMode != RPLIDAR_CONF_SCAN_COMMAND_STD && scanMode != RPLIDAR_CONF_SCAN_COMMAND_EXPRESS)
             scanReq.working_mode = _u8(scanMode);
         scanReq.working_flags = options;
+        if (IS_FAIL(ans = _setupScanArena(usPerSample))) {
+            return ans;
+        }
+        _cached_scan_us_per_sample = usPerSample;
 
         if (IS_FAIL(ans = _sendCommand(RPLIDAR_CMD_EXPRESS_SCAN, &scanReq, sizeof(scanReq)))) {
             return ans;
         }
 
         // waiting for confirmation
+        _u64 deadline_us = deadlineAfter(timeout);
         rplidar_ans_header_t response_header;
-        if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
+        if (IS_FAIL(ans = _waitResponseHeader(&response_header, deadline_us))) {
             return ans;
         }
 
@@ -1742,139 +1744,529 @@ u_result RPlidarDriverImplCommon::startScanExpress(bool force, _u16 scanMode, _u
             if (header_size < sizeof(rplidar_response_hq_capsule_measurement_nodes_t)) {
                 return RESULT_INVALID_DATA;
             }
-            _isScanning = true;
-            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheHqScanData);
-        }
-        else
-        {
-            if (header_size < sizeof(rplidar_response_ultra_capsule_measurement_nodes_t)) {
-                return RESULT_INVALID_DATA;
+            _isScanning = true;
+            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheHqScanData);
+        }
+        else
+        {
+            if (header_size < sizeof(rplidar_response_ultra_capsule_measurement_nodes_t)) {
+                return RESULT_INVALID_DATA;
+            }
+            _isScanning = true;
+            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheUltraCapsuledScanData);
+        }
+
+        if (_cachethread.getHandle() == 0) {
+            return RESULT_OPERATION_FAIL;
+        }
+        _applyRealtimeProfile();
+    }
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::stop(_u32 timeout)
+{
+    u_result ans;
+    // the device is told to stop even when the cache thread could not be joined in time
+    u_result joined = _disableDataGrabbing();
+
+    {
+        rp::hal::AutoLocker l(_lock);
+
+        if (IS_FAIL(ans = _sendCommand(RPLIDAR_CMD_STOP))) {
+            return ans;
+        }
+    }
+
+    return joined;
+}
+
+u_result RPlidarDriverImplCommon::grabScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout)
+{
+    DEPRECATED_WARN("grabScanData()", "grabScanDataHq()");
+
+    switch (_dataEvt.wait(timeout))
+    {
+    case rp::hal::Event::EVENT_TIMEOUT:
+        count = 0;
+        return RESULT_OPERATION_TIMEOUT;
+    case rp::hal::Event::EVENT_OK:
+        {
+            RplidarScanLease scan;
+            if (!_acquireLatestScan(scan)) return RESULT_OPERATION_TIMEOUT; //consider as timeout
+
+            size_t size_to_copy = min(count, scan.count());
+
+            for (size_t i = 0; i < size_to_copy; i++)
+                convert(scan.nodes()[i], nodebuffer[i]);
+
+            count = size_to_copy;
+        }
+        return RESULT_OK;
+
+    default:
+        count = 0;
+        return RESULT_OPERATION_FAIL;
+    }
+}
+
+u_result RPlidarDriverImplCommon::grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u32 timeout)
+{
+    switch (_dataEvt.wait(timeout))
+    {
+    case rp::hal::Event::EVENT_TIMEOUT:
+        count = 0;
+        return RESULT_OPERATION_TIMEOUT;
+    case rp::hal::Event::EVENT_OK:
+    {
+        RplidarScanLease scan;
+        if (!_acquireLatestScan(scan)) return RESULT_OPERATION_TIMEOUT; //consider as timeout
+
+        size_t size_to_copy = min(count, scan.count());
+        memcpy(nodebuffer, scan.nodes(), size_to_copy * sizeof(rplidar_response_measurement_node_hq_t));
+
+        count = size_to_copy;
+    }
+    return RESULT_OK;
+
+    default:
+        count = 0;
+        return RESULT_OPERATION_FAIL;
+    }
+}
+
+u_result RPlidarDriverImplCommon::grabScanDataTimestamped(RplidarTimestampedNode * nodebuffer, size_t & count, _u32 timeout)
+{
+    RplidarScanLease scan;
+    u_result ans = grabScanLease(scan, timeout);
+    if (IS_FAIL(ans)) {
+        count = 0;
+        return ans;
+    }
+
+    size_t size_to_copy = min(count, scan.count());
+    for (size_t i = 0; i < size_to_copy; i++)
+    {
+        nodebuffer[i].node = scan.nodes()[i];
+        nodebuffer[i].host_timestamp_us = scan.hostTimestamp_uS(i);
+        nodebuffer[i].device_timestamp = scan.deviceTimestamp(i);
+    }
+
+    count = size_to_copy;
+    return RESULT_OK;
+}
+
+bool RPlidarDriverImplCommon::_acquireLatestScan(RplidarScanLease & lease)
+{
+    rp::hal::AutoLocker l(_scan_reader_lock);
+    return _scan_pool.acquireLatest(lease);
+}
+
+u_result RPlidarDriverImplCommon::grabScanLease(RplidarScanLease & lease, _u32 timeout)
+{
+    lease.release();
+
+    switch (_dataEvt.wait(timeout))
+    {
+    case rp::hal::Event::EVENT_TIMEOUT:
+        return RESULT_OPERATION_TIMEOUT;
+    case rp::hal::Event::EVENT_OK:
+        if (!_acquireLatestScan(lease)) return RESULT_OPERATION_TIMEOUT; //consider as timeout
+        return RESULT_OK;
+
+    default:
+        return RESULT_OPERATION_FAIL;
+    }
+}
+
+u_result RPlidarDriverImplCommon::subscribeScan(_u32 & subscriberId)
+{
+    for (_u32 id = 0; id < MAX_SCAN_SUBSCRIBERS; ++id) {
+        ScanSubscriber & subscriber = _scan_subscribers[id];
+        if (!rp::hal::atomic_compare_exchange(&subscriber.active, 0, 1)) continue;
+
+        // start with the scans published from now on
+        subscriber.cursor = _scan_pool.getPublishedSequence();
+        subscriber.dataEvt.set(false);
+        subscriberId = id;
+        return RESULT_OK;
+    }
+    return RESULT_INSUFFICIENT_MEMORY;
+}
+
+u_result RPlidarDriverImplCommon::unsubscribeScan(_u32 subscriberId)
+{
+    if (subscriberId >= MAX_SCAN_SUBSCRIBERS) return RESULT_INVALID_DATA;
+    if (!rp::hal::atomic_exchange(&_scan_subscribers[subscriberId].active, 0)) return RESULT_INVALID_DATA;
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::grabSubscribedScan(_u32 subscriberId, RplidarScanLease & lease, _u32 & missedCount, _u32 timeout)
+{
+    if (subscriberId >= MAX_SCAN_SUBSCRIBERS) return RESULT_INVALID_DATA;
+    ScanSubscriber & subscriber = _scan_subscribers[subscriberId];
+    if (!rp::hal::atomic_load(&subscriber.active)) return RESULT_INVALID_DATA;
+
+    lease.release();
+    _u64 deadline_us = deadlineAfter(timeout);
+    for (;;) {
+        _u32 published = _scan_pool.getPublishedSequence();
+        if (published != subscriber.cursor) {
+            _u32 first = subscriber.cursor + 1;
+            if (published - subscriber.cursor > RplidarScanPool::HISTORY_DEPTH) {
+                first = published - RplidarScanPool::HISTORY_DEPTH + 1;
+            }
+
+            // revolutions dropped by the pool never made it to the history
+            rp::hal::AutoLocker l(_scan_reader_lock);
+            for (_u32 sequence = first; sequence != published + 1; ++sequence) {
+                if (_scan_pool.acquireSequence(sequence, lease)) {
+                    missedCount = sequence - subscriber.cursor - 1;
+                    subscriber.cursor = sequence;
+                    return RESULT_OK;
+                }
             }
-            _isScanning = true;
-            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheUltraCapsuledScanData);
+            // the history moved on meanwhile, look again
+            continue;
         }
 
-        if (_cachethread.getHandle() == 0) {
+        if (getus() >= deadline_us) return RESULT_OPERATION_TIMEOUT;
+
+        switch (subscriber.dataEvt.waitUntil(deadline_us))
+        {
+        case rp::hal::Event::EVENT_TIMEOUT:
+            return RESULT_OPERATION_TIMEOUT;
+        case rp::hal::Event::EVENT_OK:
+            break;
+        default:
             return RESULT_OPERATION_FAIL;
         }
     }
-    return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::stop(_u32 timeout)
+u_result RPlidarDriverImplCommon::getScanDataWithInterval(rplidar_response_measurement_node_t * nodebuffer, size_t & count)
 {
-    u_result ans;
-    _disableDataGrabbing();
+    DEPRECATED_WARN("getScanDataWithInterval(rplidar_response_measurement_node_t*, size_t&)", "getScanDataWithInterval(rplidar_response_measurement_node_hq_t*, size_t&)");
 
+    rplidar_response_measurement_node_hq_t chunk[256];
+    size_t size_copied = 0;
     {
-        rp::hal::AutoLocker l(_lock);
+        rp::hal::AutoLocker l(_scan_reader_lock);
+        while (size_copied < MAX_SCAN_NODES)
+        {
+            size_t chunk_count = _interval_ring.drain(chunk, min(_countof(chunk), MAX_SCAN_NODES - size_copied));
+            if (!chunk_count) break;
 
-        if (IS_FAIL(ans = _sendCommand(RPLIDAR_CMD_STOP))) {
-            return ans;
+            for (size_t i = 0; i < chunk_count; i++)
+            {
+                convert(chunk[i], nodebuffer[size_copied + i]);
+            }
+            size_copied += chunk_count;
         }
     }
+    if (!size_copied) return RESULT_OPERATION_TIMEOUT;
 
+    count = size_copied;
     return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::grabScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout)
+u_result RPlidarDriverImplCommon::getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count)
 {
-    DEPRECATED_WARN("grabScanData()", "grabScanDataHq()");
+    // the legacy interface expects the caller buffer to hold a full revolution
+    size_t size_to_copy = MAX_SCAN_NODES;
+    u_result ans = drainScanDataWithIntervalHq(nodebuffer, size_to_copy);
+    if (IS_OK(ans)) count = size_to_copy;
+    return ans;
+}
 
-    switch (_dataEvt.wait(timeout))
+u_result RPlidarDriverImplCommon::drainScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count)
+{
+    size_t size_copied;
     {
-    case rp::hal::Event::EVENT_TIMEOUT:
-        count = 0;
-        return RESULT_OPERATION_TIMEOUT;
-    case rp::hal::Event::EVENT_OK:
-        {
-            if(_cached_scan_node_hq_count == 0) return RESULT_OPERATION_TIMEOUT; //consider as timeout
+        rp::hal::AutoLocker l(_scan_reader_lock);
+        size_copied = _interval_ring.drain(nodebuffer, count);
+    }
+    if (!size_copied) return RESULT_OPERATION_TIMEOUT;
 
-            rp::hal::AutoLocker l(_lock);
+    count = size_copied;
+    return RESULT_OK;
+}
 
-            size_t size_to_copy = min(count, _cached_scan_node_hq_count);
+u_result RPlidarDriverImplCommon::getScanDataWithIntervalStats(RplidarIntervalBufferStats & stats)
+{
+    _interval_ring.getStats(stats);
+    return RESULT_OK;
+}
 
-            for (size_t i = 0; i < size_to_copy; i++)
-                convert(_cached_scan_node_hq_buf[i], nodebuffer[i]);
+u_result RPlidarDriverImplCommon::getScanHistory(_u64 startTs_uS, _u64 endTs_uS, rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps, size_t & count)
+{
+    size_t size_copied;
+    {
+        rp::hal::AutoLocker l(_scan_reader_lock);
+        size_copied = _point_history.queryTimeRange(startTs_uS, endTs_uS, nodebuffer, timestamps, count);
+    }
+    if (!size_copied) return RESULT_OPERATION_TIMEOUT;
 
-            count = size_to_copy;
-            _cached_scan_node_hq_count = 0;
-        }
-        return RESULT_OK;
+    count = size_copied;
+    return RESULT_OK;
+}
 
-    default:
-        count = 0;
-        return RESULT_OPERATION_FAIL;
+u_result RPlidarDriverImplCommon::getLatestRevolutionFromHistory(rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps, size_t & count)
+{
+    size_t size_copied;
+    {
+        rp::hal::AutoLocker l(_scan_reader_lock);
+        size_copied = _point_history.queryLatestRevolution(nodebuffer, timestamps, count);
     }
+    if (!size_copied) return RESULT_OPERATION_TIMEOUT;
+
+    count = size_copied;
+    return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u32 timeout)
+u_result RPlidarDriverImplCommon::getLowLatencyStatus(_u32 & status)
 {
-    switch (_dataEvt.wait(timeout))
-    {
-    case rp::hal::Event::EVENT_TIMEOUT:
-        count = 0;
-        return RESULT_OPERATION_TIMEOUT;
-    case rp::hal::Event::EVENT_OK:
-    {
-        if (_cached_scan_node_hq_count == 0) return RESULT_OPERATION_TIMEOUT; //consider as timeout
+    status = 0;
+    if (!isConnected()) return RESULT_OPERATION_FAIL;
+    // same bits as serial_rxtx::LOW_LATENCY_xxx
+    status = _chanDev->getLowLatencyStatus();
+    return RESULT_OK;
+}
 
-        rp::hal::AutoLocker l(_lock);
+u_result RPlidarDriverImplCommon::setSerialRingSize(size_t size)
+{
+    if (!size || size > 0x40000000) return RESULT_INVALID_DATA;
+    size_t roundedSize = 1;
+    while (roundedSize < size) roundedSize <<= 1;
+    _serial_ring_size = roundedSize;
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::setTcpOptions(const RplidarTcpOptions & options)
+{
+    _tcp_options = options;
+    return RESULT_OK;
+}
 
-        size_t size_to_copy = min(count, _cached_scan_node_hq_count);
-        memcpy(nodebuffer, _cached_scan_node_hq_buf, size_to_copy * sizeof(rplidar_response_measurement_node_hq_t));
+u_result RPlidarDriverImplCommon::setRealtimeProfile(const RplidarRealtimeProfile & profile)
+{
+    if (profile.sched_policy > RT_SCHED_RR || profile.cpu_core < -1) return RESULT_INVALID_DATA;
+    // well within the smallest default thread stack (1MB on Windows)
+    if (profile.prefault_stack_size > MAX_PREFAULT_STACK_SIZE) return RESULT_INVALID_DATA;
 
-        count = size_to_copy;
-        _cached_scan_node_hq_count = 0;
+    if (profile.sched_policy != RT_SCHED_DEFAULT) {
+        int minPriority, maxPriority;
+        rp::hal::Thread::sched_policy_t policy = (profile.sched_policy == RT_SCHED_FIFO) ? rp::hal::Thread::SCHED_POLICY_FIFO : rp::hal::Thread::SCHED_POLICY_RR;
+        if (!rp::hal::Thread::getRealtimePriorityRange(policy, minPriority, maxPriority)) return RESULT_OPERATION_NOT_SUPPORT;
+        if (profile.sched_priority < minPriority || profile.sched_priority > maxPriority) return RESULT_INVALID_DATA;
     }
+    _rt_profile = profile;
     return RESULT_OK;
+}
 
-    default:
-        count = 0;
-        return RESULT_OPERATION_FAIL;
+u_result RPlidarDriverImplCommon::getRealtimeStats(RplidarRealtimeStats & stats)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    // a consistent copy, the cache thread may update the counters meanwhile
+    _u32 seq;
+    _u64 latencySum;
+    bool stackPrefaulted;
+    do {
+        seq = rp::hal::atomic_load(&_rt_stats_seq);
+        stackPrefaulted = _rt_stack_prefaulted;
+        stats.frame_count = _rt_frame_count;
+        latencySum = _rt_latency_sum;
+        stats.min_latency_us = _rt_latency_min;
+        stats.max_latency_us = _rt_latency_max;
+        stats.over_100us_count = _rt_over_100us_count;
+        stats.over_1ms_count = _rt_over_1ms_count;
+    } while ((seq & 1) || seq != rp::hal::atomic_load(&_rt_stats_seq));
+
+    stats.applied = rp::hal::atomic_load(&_rt_applied) | (stackPrefaulted ? RT_PROFILE_STACK : 0);
+    if (stats.frame_count) {
+        stats.mean_latency_us = (_u32)(latencySum / stats.frame_count);
+    } else {
+        stats.min_latency_us = 0;
+        stats.max_latency_us = 0;
     }
+    return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::getScanDataWithInterval(rplidar_response_measurement_node_t * nodebuffer, size_t & count)
+u_result RPlidarDriverImplCommon::getSerialRingStats(RplidarSerialRingStats & stats)
 {
-    DEPRECATED_WARN("getScanDataWithInterval(rplidar_response_measurement_node_t*, size_t&)", "getScanDataWithInterval(rplidar_response_measurement_node_hq_t*, size_t&)");
+    memset(&stats, 0, sizeof(stats));
+    if (!isConnected()) return RESULT_OPERATION_FAIL;
+    if (!_chanDev->getRingStats(stats)) return RESULT_OPERATION_NOT_SUPPORT;
+    return RESULT_OK;
+}
 
-    size_t size_to_copy = 0;
-    {
-        rp::hal::AutoLocker l(_lock);
-        if(_cached_scan_node_hq_count_for_interval_retrieve == 0)
-        {
-            return RESULT_OPERATION_TIMEOUT; 
-        }
-        //copy all the nodes(_cached_scan_node_count_for_interval_retrieve nodes) in _cached_scan_node_buf_for_interval_retrieve
-        size_to_copy = _cached_scan_node_hq_count_for_interval_retrieve;
-        for (size_t i = 0; i < size_to_copy; i++)
-        {
-            convert(_cached_scan_node_hq_buf_for_interval_retrieve[i], nodebuffer[i]);
-        }
-        _cached_scan_node_hq_count_for_interval_retrieve = 0;
+void RPlidarDriverImplCommon::_snapshotLinkCounters(RplidarLinkStats & stats)
+{
+    memset(&stats, 0, sizeof(stats));
+    stats.baudrate = _link_baudrate;
+    stats.received_size = _link_received_size;
+    stats.read_count = _link_read_count;
+    stats.node_frame_count = _link_frame_count[LINK_FRAME_NODE];
+    stats.capsule_frame_count = _link_frame_count[LINK_FRAME_CAPSULE];
+    stats.ultra_capsule_frame_count = _link_frame_count[LINK_FRAME_ULTRA_CAPSULE];
+    stats.hq_capsule_frame_count = _link_frame_count[LINK_FRAME_HQ_CAPSULE];
+    stats.resync_count = _rx_resync_count;
+    stats.discarded_size = _link_discarded_size;
+    stats.checksum_error_count = _link_checksum_error_count;
+    stats.lost_datagram_count = _rx_loss_count;
+
+    // the channel may read ahead on its own, then its reads are the ones that count
+    if (_chanDev) _chanDev->getReadCount(stats.read_count);
+}
+
+u_result RPlidarDriverImplCommon::getLinkStats(RplidarLinkStats & stats)
+{
+    rp::hal::AutoLocker l(_link_stats_lock);
+    _u64 now = getus();
+
+    _snapshotLinkCounters(stats);
+    stats.interval_us = (_u32)(now - _link_previous_ts);
+
+    _u32 frames = (stats.node_frame_count - _link_previous.node_frame_count)
+        + (stats.capsule_frame_count - _link_previous.capsule_frame_count)
+        + (stats.ultra_capsule_frame_count - _link_previous.ultra_capsule_frame_count)
+        + (stats.hq_capsule_frame_count - _link_previous.hq_capsule_frame_count);
+    _u32 reads = stats.read_count - _link_previous.read_count;
+    _u32 received = stats.received_size - _link_previous.received_size;
+
+    stats.reads_per_frame = frames ? (float)reads / frames : 0;
+    if (stats.baudrate && stats.interval_us) {
+        stats.link_utilization = (float)((double)received * 10 * 1000000 / ((double)stats.baudrate * stats.interval_us));
     }
-    count = size_to_copy;
 
+    _link_previous = stats;
+    _link_previous_ts = now;
     return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count)
+u_result RPlidarDriverImplCommon::setMinScanFrequency(float frequency)
 {
-    size_t size_to_copy = 0;
-    {
-        rp::hal::AutoLocker l(_lock);
-        if (_cached_scan_node_hq_count_for_interval_retrieve == 0)
-        {
-            return RESULT_OPERATION_TIMEOUT;
-        }
-        //copy all the nodes(_cached_scan_node_count_for_interval_retrieve nodes) in _cached_scan_node_buf_for_interval_retrieve
-        size_to_copy = _cached_scan_node_hq_count_for_interval_retrieve;
-        memcpy(nodebuffer, _cached_scan_node_hq_buf_for_interval_retrieve, size_to_copy * sizeof(rplidar_response_measurement_node_hq_t));
-        _cached_scan_node_hq_count_for_interval_retrieve = 0;
+    if (frequency <= 0) return RESULT_INVALID_DATA;
+    _min_scan_frequency = frequency;
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::getScanBufferStats(RplidarScanBufferStats & stats)
+{
+    rp::hal::AutoLocker l(_scan_reader_lock);
+    stats.max_nodes_per_scan = (_u32)_scan_pool.getMaxNodes();
+    stats.history_capacity = (_u32)_point_history.getCapacity();
+    stats.arena_size = (_u32)_scan_arena_size;
+    stats.truncated_scan_count = rp::hal::atomic_load(&_truncated_scan_count);
+    stats.dropped_scan_count = _scan_pool.getDroppedCount();
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::enableScanSoA(bool enable)
+{
+    if (enable) {
+        _scan_arrays |= RplidarScanPool::ARRAY_SOA;
+    } else {
+        _scan_arrays &= ~(_u32)RplidarScanPool::ARRAY_SOA;
+    }
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::grabScanDataSoA(float * angles, float * distances, _u8 * qualities, _u8 * flags, size_t & count, _u32 timeout)
+{
+    RplidarScanLease scan;
+    u_result ans = grabScanLease(scan, timeout);
+    if (IS_FAIL(ans)) {
+        count = 0;
+        return ans;
+    }
+
+    size_t size_to_copy = min(count, scan.count());
+    if (scan.angles()) {
+        memcpy(angles, scan.angles(), size_to_copy * sizeof(float));
+        memcpy(distances, scan.distances(), size_to_copy * sizeof(float));
+        memcpy(qualities, scan.qualities(), size_to_copy);
+        memcpy(flags, scan.flags(), size_to_copy);
+    } else {
+        capsule_decoder::unpack(scan.nodes(), size_to_copy, angles, distances, qualities, flags);
     }
     count = size_to_copy;
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::setSensorPose(float x_mm, float y_mm, float yaw_deg)
+{
+    cartesian::makeTransform(x_mm, y_mm, yaw_deg, _sensor_pose);
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::enableScanCartesian(bool enable)
+{
+    if (enable) {
+        _scan_arrays |= RplidarScanPool::ARRAY_CARTESIAN;
+    } else {
+        _scan_arrays &= ~(_u32)RplidarScanPool::ARRAY_CARTESIAN;
+    }
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::convertScanToCartesian(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, float * x_mm, float * y_mm)
+{
+    cartesian::convert(nodebuffer, count, _sensor_pose, x_mm, y_mm);
+    return RESULT_OK;
+}
+
+static inline size_t _roundUpPow2(size_t value)
+{
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+u_result RPlidarDriverImplCommon::_setupScanArena(float usPerSample)
+{
+    if (usPerSample <= 0) usPerSample = LEGACY_SAMPLE_DURATION;
+
+    // a revolution at the lowest rotation frequency expected, and the history covers 2 seconds
+    size_t maxNodes = (size_t)(1000000.0f / (usPerSample * _min_scan_frequency)) + 1;
+    if (maxNodes > MAX_SCAN_NODES) maxNodes = MAX_SCAN_NODES;
+    size_t ringCapacity = _roundUpPow2(maxNodes);
+    size_t historyCapacity = _roundUpPow2((size_t)(2000000.0f / usPerSample));
+    if (historyCapacity < RplidarPointHistory::MIN_CAPACITY) historyCapacity = RplidarPointHistory::MIN_CAPACITY;
+    if (historyCapacity > RplidarPointHistory::MAX_CAPACITY) historyCapacity = RplidarPointHistory::MAX_CAPACITY;
+
+    // the cache thread is stopped, the pose can change even when the buffers are kept
+    _scan_pool.setTransform(_sensor_pose);
+
+    if (maxNodes == _scan_pool.getMaxNodes() && _scan_arrays == _scan_pool.getArrays()
+        && ringCapacity == _interval_ring.getCapacity() && historyCapacity == _point_history.getCapacity()) {
+        return RESULT_OK;
+    }
+
+    rp::hal::AutoLocker l(_scan_reader_lock);
+    if (_scan_arena && _scan_pool.isLeased()) {
+        // keep the current buffers, revolutions that do not fit are reported as truncated
+        return RESULT_OK;
+    }
 
+    size_t poolSize = RplidarScanPool::getStorageSize(maxNodes, _scan_arrays);
+    size_t ringSize = RplidarNodeRing::getStorageSize(ringCapacity);
+    // room to move the pool to a SOA_ALIGNMENT boundary
+    size_t alignPad = _scan_arrays ? RplidarScanPool::SOA_ALIGNMENT - 1 : 0;
+    size_t arenaSize = alignPad + poolSize + ringSize + RplidarPointHistory::getStorageSize(historyCapacity);
+    _u8 * arena = new (std::nothrow) _u8[arenaSize];
+    if (!arena) return RESULT_INSUFFICIENT_MEMORY;
+
+    // every part is a multiple of 8 bytes long, which keeps the next one aligned
+    _u8 * poolBuffer = arena + ((RplidarScanPool::SOA_ALIGNMENT - ((size_t)arena & alignPad)) & alignPad);
+    _scan_pool.attach(poolBuffer, maxNodes, _scan_arrays);
+    _interval_ring.attach(poolBuffer + poolSize, ringCapacity);
+    _point_history.attach(poolBuffer + poolSize + ringSize, historyCapacity);
+
+    delete [] _scan_arena;
+    _scan_arena = arena;
+    _scan_arena_size = arenaSize;
     return RESULT_OK;
 }
 
@@ -1984,43 +2376,42 @@ u_result RPlidarDriverImplCommon::ascendScanData(rplidar_response_measurement_no
 
 u_result RPlidarDriverImplCommon::_sendCommand(_u8 cmd, const void * payload, size_t payloadsize)
 {
-    _u8 pkt_header[10];
-    rplidar_cmd_packet_t * header = reinterpret_cast<rplidar_cmd_packet_t * >(pkt_header);
+    // sync and cmd, then size, payload (255 bytes at most) and checksum
+    _u8 pkt[2 + 1 + 255 + 1];
+    rplidar_cmd_packet_t * header = reinterpret_cast<rplidar_cmd_packet_t * >(pkt);
+    size_t pktSize = 2;
     _u8 checksum = 0;
 
     if (!_isConnected) return RESULT_OPERATION_FAIL;
 
     if (payloadsize && payload) {
+        if (payloadsize > 255) return RESULT_INVALID_DATA;
         cmd |= RPLIDAR_CMDFLAG_HAS_PAYLOAD;
     }
 
     header->syncByte = RPLIDAR_CMD_SYNC_BYTE;
     header->cmd_flag = cmd;
 
-    // send header first
-    _chanDev->senddata(pkt_header, 2) ;
-
     if (cmd & RPLIDAR_CMDFLAG_HAS_PAYLOAD) {
         checksum ^= RPLIDAR_CMD_SYNC_BYTE;
         checksum ^= cmd;
         checksum ^= (payloadsize & 0xFF);
 
-        // calc checksum
+        // size, payload and checksum follow the header
+        pkt[pktSize++] = (_u8)payloadsize;
         for (size_t pos = 0; pos < payloadsize; ++pos) {
-            checksum ^= ((_u8 *)payload)[pos];
+            _u8 byte = ((const _u8 *)payload)[pos];
+            checksum ^= byte;
+            pkt[pktSize++] = byte;
         }
-
-        // send size
-        _u8 sizebyte = payloadsize;
-        _chanDev->senddata(&sizebyte, 1);
-
-        // send payload
-        _chanDev->senddata((const _u8 *)payload, sizebyte);
-
-        // send checksum
-        _chanDev->senddata(&checksum, 1);
+        pkt[pktSize++] = checksum;
     }
 
+    // a single write, bounded in time by the channel: a wedged adapter fails the command
+    // instead of holding _lock
+    if (_chanDev->senddata(pkt, pktSize) != (int)pktSize) {
+        return RESULT_OPERATION_TIMEOUT;
+    }
     return RESULT_OK;
 }
 
@@ -2030,11 +2421,12 @@ u_result RPlidarDriverImplCommon::getSampleDuration_uS(rplidar_response_sample_r
 
     if (!isConnected()) return RESULT_OPERATION_FAIL;
     
-    _disableDataGrabbing();
+    u_result ans = _disableDataGrabbing();
+    if (IS_FAIL(ans)) return ans;
     
     rplidar_response_device_info_t devinfo;
     // 1. fetch the device version first...
-    u_result ans = getDeviceInfo(devinfo, timeout);
+    ans = getDeviceInfo(devinfo, timeout);
 
     rateInfo.express_sample_duration_us = _cached_sampleduration_express;
     rateInfo.std_sample_duration_us = _cached_sampleduration_std;
@@ -2053,8 +2445,9 @@ u_result RPlidarDriverImplCommon::getSampleDuration_uS(rplidar_response_sample_r
             return ans;
         }
 
+        _u64 deadline_us = deadlineAfter(timeout);
         rplidar_ans_header_t response_header;
-        if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
+        if (IS_FAIL(ans = _waitResponseHeader(&response_header, deadline_us))) {
             return ans;
         }
 
@@ -2068,10 +2461,10 @@ u_result RPlidarDriverImplCommon::getSampleDuration_uS(rplidar_response_sample_r
             return RESULT_INVALID_DATA;
         }
 
-        if (!_chanDev->waitfordata(header_size, timeout)) {
+        if (!_chanDev->waitfordataUntil(header_size, deadline_us)) {
             return RESULT_OPERATION_TIMEOUT;
         }
-        _chanDev->recvdata(reinterpret_cast<_u8 *>(&rateInfo), sizeof(rateInfo));
+        _recvChannel(reinterpret_cast<_u8 *>(&rateInfo), sizeof(rateInfo));
     }
     return RESULT_OK;
 }
@@ -2083,7 +2476,7 @@ u_result RPlidarDriverImplCommon::checkMotorCtrlSupport(bool & support, _u32 tim
     
     if (!isConnected()) return RESULT_OPERATION_FAIL;
     
-    _disableDataGrabbing();
+    if (IS_FAIL(ans = _disableDataGrabbing())) return ans;
 
     {
         rp::hal::AutoLocker l(_lock);
@@ -2095,8 +2488,9 @@ u_result RPlidarDriverImplCommon::checkMotorCtrlSupport(bool & support, _u32 tim
             return ans;
         }
 
+        _u64 deadline_us = deadlineAfter(timeout);
         rplidar_ans_header_t response_header;
-        if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
+        if (IS_FAIL(ans = _waitResponseHeader(&response_header, deadline_us))) {
             return ans;
         }
         
@@ -2110,11 +2504,11 @@ u_result RPlidarDriverImplCommon::checkMotorCtrlSupport(bool & support, _u32 tim
             return RESULT_INVALID_DATA;
         }
 
-        if (!_chanDev->waitfordata(header_size, timeout)) {
+        if (!_chanDev->waitfordataUntil(header_size, deadline_us)) {
             return RESULT_OPERATION_TIMEOUT;
         }
         rplidar_response_acc_board_flag_t acc_board_flag;
-        _chanDev->recvdata(reinterpret_cast<_u8 *>(&acc_board_flag), sizeof(acc_board_flag));
+        _recvChannel(reinterpret_cast<_u8 *>(&acc_board_flag), sizeof(acc_board_flag));
 
         if (acc_board_flag.support_flag & RPLIDAR_RESP_ACC_BOARD_FLAG_MOTOR_CTRL_SUPPORT_MASK) {
             support = true;
@@ -2168,10 +2562,108 @@ u_result RPlidarDriverImplCommon::stopMotor()
     }
 }
 
-void RPlidarDriverImplCommon::_disableDataGrabbing()
+u_result RPlidarDriverImplCommon::_disableDataGrabbing(unsigned long timeout)
 {
     _isScanning = false;
-    _cachethread.join();
+    if (!_cachethread.getHandle()) return RESULT_OK;
+
+    // a wait the channel cannot end runs to its timeout, the join is only bounded
+    // for a cache thread woken out of its wait
+    if (!_chanDev->canCancelWait()) return _cachethread.join();
+
+    _chanDev->cancelWait();
+    u_result ans = _cachethread.join(timeout);
+    // a thread still running keeps the channel cancelled until the next attempt joins it
+    if (IS_FAIL(ans)) return ans;
+    _chanDev->resumeWait();
+    return RESULT_OK;
+}
+
+// Serial Channel Reader Thread
+
+bool SerialChannelDevice::_startReader()
+{
+    _u8 * storage = new (std::nothrow) _u8[RplidarByteRing::getStorageSize(_reader_ring_size)];
+    if (!storage) return false;
+    _rx_ring.attach(storage, _reader_ring_size);
+    _reader_storage = storage;
+
+    _reader_stop = false;
+    _reader_thread = CLASS_THREAD(SerialChannelDevice, _readerProc);
+    if (_reader_thread.getHandle() == 0) {
+        _rx_ring.attach(NULL, 0);
+        delete [] _reader_storage;
+        _reader_storage = NULL;
+        return false;
+    }
+    rp::hal::atomic_store(&_reader_running, 1);
+    return true;
+}
+
+void SerialChannelDevice::_stopReader()
+{
+    if (!_reader_storage) return;
+    _reader_stop = true;
+    _rxtxSerial->cancelOperation();
+    _reader_thread.join();
+    rp::hal::atomic_store(&_reader_running, 0);
+    _rx_event.set();
+
+    _rx_ring.attach(NULL, 0);
+    delete [] _reader_storage;
+    _reader_storage = NULL;
+}
+
+u_result SerialChannelDevice::_readerProc()
+{
+    _u8 overflow[512];
+
+    while (!_reader_stop) {
+        size_t available = 0;
+        int ans = _rxtxSerial->waitfordata(1, READER_WAIT_TIMEOUT, &available);
+        if (_reader_stop) break;
+        if (ans == rp::hal::serial_rxtx::ANS_DEV_ERR) {
+            delay(READER_ERROR_DELAY);
+            continue;
+        }
+        if (ans != rp::hal::serial_rxtx::ANS_OK) continue;
+
+        // one timestamp for everything that is there now, read with as few read() as the ring allows
+        _u64 arrivalTs = getus();
+        while (available) {
+            size_t room;
+            _u8 * buffer = _rx_ring.getWriteBuffer(room);
+            size_t received;
+            if (room) {
+                received = _rxtxSerial->recvdata(buffer, min(room, available));
+                _rx_ring.commit(received, arrivalTs);
+            } else {
+                // keep draining the port, the decoder loses the newest bytes rather than the kernel
+                received = _rxtxSerial->recvdata(overflow, min(sizeof(overflow), available));
+                _rx_ring.drop(received);
+            }
+            if (!received) break;
+            available -= min(received, available);
+        }
+
+        if (_rx_ring.pending() >= rp::hal::atomic_load(&_rx_wanted)) _rx_event.set();
+    }
+    return RESULT_OK;
+}
+
+bool SerialChannelDevice::_waitRing(size_t data_count, _u64 deadline_us, size_t * returned_size)
+{
+    // the reader thread only signals once data_count bytes are there
+    rp::hal::atomic_store(&_rx_wanted, (_u32)data_count);
+    for (;;) {
+        size_t pending = _rx_ring.pending();
+        if (returned_size) *returned_size = pending;
+        if (pending >= data_count) return true;
+        if (_closePending || _waitCancelled || !rp::hal::atomic_load(&_reader_running)) return false;
+
+        if (getus() >= deadline_us) return false;
+        _rx_event.waitUntil(deadline_us);
+    }
 }
 
 // Serial Driver Impl
@@ -2193,6 +2685,8 @@ RPlidarDriverSerial::~RPlidarDriverSerial()
 void RPlidarDriverSerial::disconnect()
 {
     if (!_isConnected) return ;
+    // no bound on the join here, the channel goes away under the cache thread
+    _disableDataGrabbing((unsigned long)-1);
     stop();
 }
 
@@ -2206,12 +2700,22 @@ u_result RPlidarDriverSerial::connect(const char * port_path, _u32 baudrate, _u3
         rp::hal::AutoLocker l(_lock);
 
         // establish the serial connection...
-        if (!_chanDev->bind(port_path, baudrate)  ||  !_chanDev->open()) {
+        SerialChannelDevice * serialDev = static_cast<SerialChannelDevice *>(_chanDev);
+        _u32 serialFlags = (flag & CONNECT_FLAG_LOW_LATENCY) ? rp::hal::serial_rxtx::FLAG_LOW_LATENCY : 0;
+        serialDev->setReaderRingSize((flag & CONNECT_FLAG_READER_THREAD) ? _serial_ring_size : 0);
+        if (!serialDev->bind(port_path, baudrate, serialFlags)  ||  !_chanDev->open()) {
             return RESULT_INVALID_DATA;
         }
         _chanDev->flush();
     }
 
+    {
+        rp::hal::AutoLocker l(_link_stats_lock);
+        _link_baudrate = baudrate;
+        _snapshotLinkCounters(_link_previous);
+        _link_previous_ts = getus();
+    }
+
     _isConnected = true;
 
     checkMotorCtrlSupport(_isSupportingMotorCtrl);
@@ -2234,6 +2738,7 @@ RPlidarDriverTCP::~RPlidarDriverTCP()
 void RPlidarDriverTCP::disconnect()
 {
     if (!_isConnected) return ;
+    _disableDataGrabbing((unsigned long)-1);
     stop();
     _chanDev->close();
 }
@@ -2248,8 +2753,69 @@ u_result RPlidarDriverTCP::connect(const char * ipStr, _u32 port, _u32 flag)
         rp::hal::AutoLocker l(_lock);
 
         // establish the serial connection...
+        static_cast<TCPChannelDevice *>(_chanDev)->setOptions(_tcp_options);
+        if(!_chanDev->bind(ipStr, port))
+            return RESULT_INVALID_DATA;
+    }
+
+    {
+        rp::hal::AutoLocker l(_link_stats_lock);
+        _link_baudrate = 0;
+        _snapshotLinkCounters(_link_previous);
+        _link_previous_ts = getus();
+    }
+
+    _isConnected = true;
+
+    checkMotorCtrlSupport(_isSupportingMotorCtrl);
+    stopMotor();
+
+    return RESULT_OK;
+}
+
+RPlidarDriverUDP::RPlidarDriverUDP()
+{
+    _chanDev = new UDPChannelDevice();
+}
+
+RPlidarDriverUDP::~RPlidarDriverUDP()
+{
+    // force disconnection
+    disconnect();
+    delete static_cast<UDPChannelDevice *>(_chanDev);
+    _chanDev = NULL;
+}
+
+void RPlidarDriverUDP::disconnect()
+{
+    if (!_isConnected) return ;
+    _disableDataGrabbing((unsigned long)-1);
+    stop();
+    _chanDev->close();
+    _isConnected = false;
+}
+
+u_result RPlidarDriverUDP::connect(const char * ipStr, _u32 port, _u32 )
+{
+    if (isConnected()) return RESULT_ALREADY_DONE;
+
+    if (!_chanDev) return RESULT_INSUFFICIENT_MEMORY;
+
+    {
+        rp::hal::AutoLocker l(_lock);
+
+        // no connection as such, the bridge learns our address from the first command
         if(!_chanDev->bind(ipStr, port))
             return RESULT_INVALID_DATA;
+        _rx_loss_count = 0;
+        _rx_gap = false;
+    }
+
+    {
+        rp::hal::AutoLocker l(_link_stats_lock);
+        _link_baudrate = 0;
+        _snapshotLinkCounters(_link_previous);
+        _link_previous_ts = getus();
     }
 
     _isConnected = true;
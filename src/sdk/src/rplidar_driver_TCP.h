@@ -36,15 +36,43 @@
 
 namespace rp { namespace standalone{ namespace rplidar {
 
+// Receives into a user space buffer with large recv()s: waitfordata reports the bytes
+// actually available, and a frame costs one recv at most as it does on the serial port.
 class TCPChannelDevice :public ChannelDevice
 {
 public:
+    enum {
+        RX_BUFFER_SIZE = 16384,
+    };
+
     rp::net::StreamSocket * _binded_socket;
-    TCPChannelDevice():_binded_socket(rp::net::StreamSocket::CreateSocket()){}
+    TCPChannelDevice()
+        : _binded_socket(rp::net::StreamSocket::CreateSocket())
+        , _rx_pos(0)
+        , _rx_end(0)
+        , _recv_count(0)
+        , _wait_cancelled(false)
+    {
+        _options.receive_buffer_size = 0;
+        _options.no_delay = true;
+        _options.busy_poll_us = 0;
+    }
+
+    // socket options applied by the next bind()
+    void setOptions(const RplidarTcpOptions & options)
+    {
+        _options = options;
+    }
 
     bool bind(const char * ipStr, uint32_t port)
     {
         rp::net::SocketAddress socket(ipStr, port);
+        _rx_pos = _rx_end = 0;
+
+        // best effort, the connection works the same without them
+        if (_options.receive_buffer_size) _binded_socket->setReceiveBufferSize(_options.receive_buffer_size);
+        if (_options.busy_poll_us) _binded_socket->setBusyPoll(_options.busy_poll_us);
+        _binded_socket->enableNoDelay(_options.no_delay);
         return IS_OK(_binded_socket->connect(socket));
     }
     void close()
@@ -54,20 +82,90 @@ public:
     }
     bool waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL)
     {
-        if(returned_size)
-            *returned_size = data_count;
-        return (_binded_socket->waitforData(timeout) == RESULT_OK);
+        return waitfordataUntil(data_count, deadlineAfter(timeout), returned_size);
+    }
+    bool waitfordataUntil(size_t data_count, _u64 deadline_us, size_t * returned_size = NULL)
+    {
+        if (data_count > RX_BUFFER_SIZE) data_count = RX_BUFFER_SIZE;
+
+        while (_rx_end - _rx_pos < data_count && !_wait_cancelled) {
+            if (_binded_socket->waitforDataUntil(deadline_us) != RESULT_OK || !_fillRxBuffer()) break;
+            if (getus() >= deadline_us) break;
+        }
+
+        if (returned_size) *returned_size = _rx_end - _rx_pos;
+        return _rx_end - _rx_pos >= data_count;
+    }
+    bool canCancelWait()
+    {
+        return _binded_socket && _binded_socket->canCancelOperation();
+    }
+    void cancelWait()
+    {
+        _wait_cancelled = true;
+        if (_binded_socket) _binded_socket->cancelOperation();
+    }
+    void resumeWait()
+    {
+        _wait_cancelled = false;
+        if (_binded_socket) _binded_socket->resumeOperation();
     }
     int senddata(const _u8 * data, size_t size)
     {
-        return _binded_socket->send(data, size) ;
+        // the socket sends all or nothing, report the bytes sent like the serial channel
+        return IS_OK(_binded_socket->send(data, size)) ? (int)size : 0;
     }
     int recvdata(unsigned char * data, size_t size)
     {
         size_t lenRec = 0;
-        _binded_socket->recv(data, size, lenRec);
+        size_t buffered = _rx_end - _rx_pos;
+        if (!buffered) {
+            // nothing waited for, read straight from the socket
+            _binded_socket->recv(data, size, lenRec);
+            if (lenRec) ++_recv_count;
+            return lenRec;
+        }
+
+        lenRec = (size < buffered) ? size : buffered;
+        memcpy(data, _rxbuf + _rx_pos, lenRec);
+        _rx_pos += lenRec;
         return lenRec;
     }
+    bool getReadCount(_u32 & count)
+    {
+        count = _recv_count;
+        return true;
+    }
+
+protected:
+    bool _fillRxBuffer()
+    {
+        // move the pending bytes back to the head once the free room gets short
+        size_t buffered = _rx_end - _rx_pos;
+        if (!buffered) {
+            _rx_pos = _rx_end = 0;
+        } else if (_rx_pos && RX_BUFFER_SIZE - _rx_end < RX_BUFFER_SIZE / 2) {
+            memmove(_rxbuf, _rxbuf + _rx_pos, buffered);
+            _rx_pos = 0;
+            _rx_end = buffered;
+        }
+
+        size_t received = 0;
+        if (IS_FAIL(_binded_socket->recv(_rxbuf + _rx_end, RX_BUFFER_SIZE - _rx_end, received)) || !received) {
+            // a readable socket with nothing to read has been closed by the peer
+            return false;
+        }
+        _rx_end += received;
+        ++_recv_count;
+        return true;
+    }
+
+    RplidarTcpOptions   _options;
+    _u8                 _rxbuf[RX_BUFFER_SIZE];
+    size_t              _rx_pos;        // first byte not handed out by recvdata
+    size_t              _rx_end;        // one past the last byte received
+    _u32                _recv_count;    // recv calls that returned data
+    volatile bool       _wait_cancelled;
 };
 
 
@@ -0,0 +1,275 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Datagrams to and from a serial bridge (DRIVER_TYPE_UDP). Each one carries a 32-bit sequence
+// number then the bytes of the serial link. The queued datagrams are received in batches, their
+// payloads joined into the byte stream the frame parser reads as it does from the serial port.
+// A gap in the sequence is counted as lost datagrams and reported by getLossCount. recvdata never
+// returns bytes from both sides of a gap: it stops right before it, and getLossCount grows with
+// the read that starts right after it.
+class UDPChannelDevice :public ChannelDevice
+{
+public:
+    enum {
+        HEADER_SIZE = 4,
+        DATAGRAM_SLOT_SIZE = 2048,     // above the payload of an ethernet frame
+        BATCH_SIZE = 32,
+        RX_BUFFER_SIZE = 2 * BATCH_SIZE * DATAGRAM_SLOT_SIZE,
+        LATE_WINDOW = 64,              // datagrams up to that far behind are late, further behind the bridge restarted
+        GAP_SLOTS = 256,               // gaps in the buffer, each one followed by payload bytes
+    };
+
+    rp::net::DGramSocket * _binded_socket;
+    UDPChannelDevice()
+        : _binded_socket(NULL)
+        , _rx_pos(0)
+        , _rx_end(0)
+        , _recv_count(0)
+        , _tx_sequence(0)
+        , _rx_sequence(0)
+        , _rx_started(false)
+        , _loss_count(0)
+        , _gap_count(0)
+        , _gap_pending(0)
+        , _wait_cancelled(false)
+    {
+    }
+
+    virtual ~UDPChannelDevice()
+    {
+        close();
+    }
+
+    bool bind(const char * ipStr, uint32_t port)
+    {
+        close();
+        if (IS_FAIL(_bridge.setAddressFromString(ipStr)) || IS_FAIL(_bridge.setPort(port))) return false;
+
+        _binded_socket = rp::net::DGramSocket::CreateSocket();
+        if (!_binded_socket) return false;
+
+        // any local port, the bridge replies to the one the commands come from
+        rp::net::SocketAddress local;
+        local.setAnyAddress();
+        local.setPort(0);
+        if (IS_FAIL(_binded_socket->bind(local))) {
+            close();
+            return false;
+        }
+
+        _rx_pos = _rx_end = 0;
+        _rx_started = false;
+        _loss_count = 0;
+        _gap_count = 0;
+        _gap_pending = 0;
+        return true;
+    }
+    void close()
+    {
+        if (!_binded_socket) return;
+        _binded_socket->dispose();
+        _binded_socket = NULL;
+    }
+    bool waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL)
+    {
+        return waitfordataUntil(data_count, deadlineAfter(timeout), returned_size);
+    }
+    bool waitfordataUntil(size_t data_count, _u64 deadline_us, size_t * returned_size = NULL)
+    {
+        // leave room for a whole batch
+        if (data_count > RX_BUFFER_SIZE / 2) data_count = RX_BUFFER_SIZE / 2;
+
+        // with the gap table full, the bytes buffered (a payload after each gap) are read first
+        while (_rx_end - _rx_pos < data_count && !_wait_cancelled && _gap_count < GAP_SLOTS) {
+            if (_binded_socket->waitforDataUntil(deadline_us) != RESULT_OK || !_fillRxBuffer()) break;
+            if (getus() >= deadline_us) break;
+        }
+
+        if (returned_size) *returned_size = _rx_end - _rx_pos;
+        return _rx_end - _rx_pos >= data_count;
+    }
+    bool canCancelWait()
+    {
+        return _binded_socket && _binded_socket->canCancelOperation();
+    }
+    void cancelWait()
+    {
+        _wait_cancelled = true;
+        if (_binded_socket) _binded_socket->cancelOperation();
+    }
+    void resumeWait()
+    {
+        _wait_cancelled = false;
+        if (_binded_socket) _binded_socket->resumeOperation();
+    }
+    int senddata(const _u8 * data, size_t size)
+    {
+        _u8 datagram[HEADER_SIZE + DATAGRAM_SLOT_SIZE];
+        if (size > DATAGRAM_SLOT_SIZE) return 0;
+
+        memcpy(datagram, &_tx_sequence, HEADER_SIZE);
+        memcpy(datagram + HEADER_SIZE, data, size);
+        if (IS_FAIL(_binded_socket->sendTo(_bridge, datagram, HEADER_SIZE + size))) return 0;
+        ++_tx_sequence;
+        return (int)size;
+    }
+    int recvdata(unsigned char * data, size_t size)
+    {
+        // nothing waited for, take whatever is queued
+        if (_rx_end == _rx_pos) _fillRxBuffer();
+
+        // the read that starts right after a gap accounts for it, the one before stops there
+        size_t limit = _rx_end;
+        if (_gap_count && _gaps[0].pos == _rx_pos) {
+            _loss_count += _gaps[0].lost;
+            --_gap_count;
+            memmove(_gaps, _gaps + 1, _gap_count * sizeof(_gaps[0]));
+        }
+        if (_gap_count) limit = _gaps[0].pos;
+
+        size_t lenRec = limit - _rx_pos;
+        if (size < lenRec) lenRec = size;
+        memcpy(data, _rxbuf + _rx_pos, lenRec);
+        _rx_pos += lenRec;
+        return lenRec;
+    }
+    bool getReadCount(_u32 & count)
+    {
+        count = _recv_count;
+        return true;
+    }
+    bool getLossCount(_u32 & count)
+    {
+        count = _loss_count;
+        return true;
+    }
+
+protected:
+    // receives the queued datagrams with one call and appends their payloads, false on a socket error
+    bool _fillRxBuffer()
+    {
+        size_t buffered = _rx_end - _rx_pos;
+        if (!buffered) {
+            _rx_pos = _rx_end = 0;
+        } else if (RX_BUFFER_SIZE - _rx_end < BATCH_SIZE * DATAGRAM_SLOT_SIZE) {
+            memmove(_rxbuf, _rxbuf + _rx_pos, buffered);
+            for (size_t pos = 0; pos < _gap_count; ++pos) _gaps[pos].pos -= _rx_pos;
+            _rx_pos = 0;
+            _rx_end = buffered;
+        }
+
+        size_t count = (RX_BUFFER_SIZE - _rx_end) / DATAGRAM_SLOT_SIZE;
+        if (count > BATCH_SIZE) count = BATCH_SIZE;
+        // each datagram received may open a gap
+        if (count > GAP_SLOTS - _gap_count) count = GAP_SLOTS - _gap_count;
+        if (!count) return true;
+        if (IS_FAIL(_binded_socket->recvBatch(_batch, DATAGRAM_SLOT_SIZE, _batch_sizes, count))) return false;
+        if (count) ++_recv_count;
+
+        for (size_t pos = 0; pos < count; ++pos) {
+            const _u8 * datagram = _batch[pos];
+            size_t size = _batch_sizes[pos];
+            if (size < HEADER_SIZE || size > DATAGRAM_SLOT_SIZE) {
+                // runt or cut: its sequence number, if any, shows up as a gap with the next one
+                continue;
+            }
+
+            _u32 sequence;
+            memcpy(&sequence, datagram, HEADER_SIZE);
+            _u32 ahead = sequence - _rx_sequence;
+            if (_rx_started && ahead) {
+                // late or duplicated, its place in the stream has passed
+                if (ahead >= (_u32)-LATE_WINDOW) continue;
+                // a gap, unless the sequence went far back when the bridge restarted
+                if (ahead < 0x80000000) _gap_pending += ahead;
+            }
+            _rx_started = true;
+            _rx_sequence = sequence + 1;
+            if (size == HEADER_SIZE) continue;
+
+            // the gap is placed right before the next payload, so that one read never spans it
+            if (_gap_pending) {
+                if (_gap_count && _gaps[_gap_count - 1].pos == _rx_end) {
+                    _gaps[_gap_count - 1].lost += _gap_pending;
+                } else {
+                    _gaps[_gap_count].pos = _rx_end;
+                    _gaps[_gap_count].lost = _gap_pending;
+                    ++_gap_count;
+                }
+                _gap_pending = 0;
+            }
+            memcpy(_rxbuf + _rx_end, datagram + HEADER_SIZE, size - HEADER_SIZE);
+            _rx_end += size - HEADER_SIZE;
+        }
+        return true;
+    }
+
+    rp::net::SocketAddress  _bridge;
+    _u8                 _rxbuf[RX_BUFFER_SIZE];
+    size_t              _rx_pos;        // first byte not handed out by recvdata
+    size_t              _rx_end;        // one past the last byte received
+    _u8                 _batch[BATCH_SIZE][DATAGRAM_SLOT_SIZE];
+    size_t              _batch_sizes[BATCH_SIZE];
+    _u32                _recv_count;    // batches received
+    _u32                _tx_sequence;
+    _u32                _rx_sequence;   // expected next
+    bool                _rx_started;    // no datagram received since bind, any sequence number is the first
+    _u32                _loss_count;    // datagrams missing from the sequence before _rx_pos (wraps around)
+
+    struct Gap {
+        size_t          pos;            // in _rxbuf, of the first byte after the gap
+        _u32            lost;           // datagrams
+    };
+    Gap                 _gaps[GAP_SLOTS];   // ahead of _rx_pos, in stream order
+    size_t              _gap_count;
+    _u32                _gap_pending;   // datagrams lost since the last payload, for the gap before the next one
+    volatile bool       _wait_cancelled;
+};
+
+
+class RPlidarDriverUDP : public RPlidarDriverImplCommon
+{
+public:
+
+    RPlidarDriverUDP();
+    virtual ~RPlidarDriverUDP();
+    virtual u_result connect(const char * ipStr, _u32 port, _u32 flag = 0);
+    virtual void disconnect();
+};
+
+
+}}}
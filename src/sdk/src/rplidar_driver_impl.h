@@ -35,9 +35,26 @@
 #pragma once
 
 namespace rp { namespace standalone{ namespace rplidar {
+
+// The waits inside the driver run to absolute deadlines on the getus() clock, 64-bit
+// microseconds that never wrap. (_u64)-1 is no deadline, like a timeout of -1.
+static inline _u64 deadlineAfter(_u32 timeout)
+{
+    if (timeout == (_u32)-1) return (_u64)-1;
+    return getus() + (_u64)timeout * 1000;
+}
+
     class RPlidarDriverImplCommon : public RPlidarDriver
 {
 public:
+    // frame types counted by the link telemetry, see the FrameSpec structs
+    enum {
+        LINK_FRAME_NODE = 0,
+        LINK_FRAME_CAPSULE,
+        LINK_FRAME_ULTRA_CAPSULE,
+        LINK_FRAME_HQ_CAPSULE,
+        LINK_FRAME_TYPE_COUNT,
+    };
 
     virtual bool isConnected();     
     virtual u_result reset(_u32 timeout = DEFAULT_TIMEOUT);
@@ -71,47 +88,121 @@ public:
     virtual u_result stop(_u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result grabScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result grabScanDataTimestamped(RplidarTimestampedNode * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result grabScanLease(RplidarScanLease & lease, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result subscribeScan(_u32 & subscriberId);
+    virtual u_result unsubscribeScan(_u32 subscriberId);
+    virtual u_result grabSubscribedScan(_u32 subscriberId, RplidarScanLease & lease, _u32 & missedCount, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result ascendScanData(rplidar_response_measurement_node_t * nodebuffer, size_t count);
     virtual u_result ascendScanData(rplidar_response_measurement_node_hq_t * nodebuffer, size_t count);
     virtual u_result getScanDataWithInterval(rplidar_response_measurement_node_t * nodebuffer, size_t & count);
     virtual u_result getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count);
+    virtual u_result drainScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count);
+    virtual u_result getScanDataWithIntervalStats(RplidarIntervalBufferStats & stats);
+    virtual u_result getScanHistory(_u64 startTs_uS, _u64 endTs_uS, rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps, size_t & count);
+    virtual u_result getLatestRevolutionFromHistory(rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps, size_t & count);
+    virtual u_result setMinScanFrequency(float frequency);
+    virtual u_result getScanBufferStats(RplidarScanBufferStats & stats);
+    virtual u_result getLowLatencyStatus(_u32 & status);
+    virtual u_result setSerialRingSize(size_t size);
+    virtual u_result getSerialRingStats(RplidarSerialRingStats & stats);
+    virtual u_result getLinkStats(RplidarLinkStats & stats);
+    virtual u_result setTcpOptions(const RplidarTcpOptions & options);
+    virtual u_result setRealtimeProfile(const RplidarRealtimeProfile & profile);
+    virtual u_result getRealtimeStats(RplidarRealtimeStats & stats);
+    virtual u_result enableScanSoA(bool enable);
+    virtual u_result grabScanDataSoA(float * angles, float * distances, _u8 * qualities, _u8 * flags, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result setSensorPose(float x_mm, float y_mm, float yaw_deg);
+    virtual u_result enableScanCartesian(bool enable);
+    virtual u_result convertScanToCartesian(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, float * x_mm, float * y_mm);
 
 protected:
 
     virtual u_result _sendCommand(_u8 cmd, const void * payload = NULL, size_t payloadsize = 0);
-    void     _disableDataGrabbing();
+    u_result _disableDataGrabbing(unsigned long timeout = CACHE_THREAD_JOIN_TIMEOUT);
+
+    virtual u_result _waitResponseHeader(rplidar_ans_header_t * header, _u64 deadline_us);
+
+    // all the reads from the channel, counted for the link telemetry
+    int      _recvChannel(_u8 * data, size_t size);
+    void     _snapshotLinkCounters(RplidarLinkStats & stats);
+
+    // streaming parser shared by all the measurement answer types
+    void     _resetRxStream();
+    u_result _fillRxStream(size_t frameSize, _u64 deadline_us);
+    template <class TFrameSpec>
+    u_result _waitStreamFrame(_u8 * frame, _u64 deadline_us, bool & resynced);
+    _u64     _rxFrameTimestamp();
+
+    // applied to the cache thread by the thread starting the scan, then by the cache thread itself
+    void     _applyRealtimeProfile();
+    void     _enterRealtimeProfile();
+
+    // scan caching engine shared by all the answer types, see ScanAnswerTraits
+    template <class TAnswer>
+    u_result _cacheScanDataT();
+    template <class TAnswer>
+    friend struct ScanAnswerTraits;
+    u_result _setupScanArena(float usPerSample);
+    bool     _acquireLatestScan(RplidarScanLease & lease);
 
-    virtual u_result _waitResponseHeader(rplidar_ans_header_t * header, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result _cacheScanData();
-    virtual u_result _waitScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
-    virtual u_result _waitNode(rplidar_response_measurement_node_t * node, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result _waitScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u64 deadline_us);
+    virtual u_result _waitNode(rplidar_response_measurement_node_t * node, _u64 deadline_us);
     virtual u_result  _cacheCapsuledScanData();
-    virtual u_result _waitCapsuledNode(rplidar_response_capsule_measurement_nodes_t & node, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result _waitCapsuledNode(rplidar_response_capsule_measurement_nodes_t & node, _u64 deadline_us);
     virtual void     _capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
     virtual void     _dense_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
     
     //FW1.23
     virtual u_result  _cacheUltraCapsuledScanData();
-    virtual u_result _waitUltraCapsuledNode(rplidar_response_ultra_capsule_measurement_nodes_t & node, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result _waitUltraCapsuledNode(rplidar_response_ultra_capsule_measurement_nodes_t & node, _u64 deadline_us);
     virtual void     _ultraCapsuleToNormal(const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
 
     virtual u_result  _cacheHqScanData();
-    virtual u_result _waitHqNode(rplidar_response_hq_capsule_measurement_nodes_t & node, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result _waitHqNode(rplidar_response_hq_capsule_measurement_nodes_t & node, _u64 deadline_us);
     virtual void     _HqToNormal(const rplidar_response_hq_capsule_measurement_nodes_t & node_hq, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
 
     bool     _isConnected; 
     bool     _isScanning;
     bool     _isSupportingMotorCtrl;
 
-    rplidar_response_measurement_node_hq_t   _cached_scan_node_hq_buf[8192];
-    size_t                                   _cached_scan_node_hq_count;
+    // Completed revolutions are handed over to the readers through a pool of
+    // reference counted buffers, nobody waits on the other side and a revolution
+    // is copied at most once (never when it is leased with grabScanLease).
+    RplidarScanPool                          _scan_pool;
 
-    rplidar_response_measurement_node_hq_t   _cached_scan_node_hq_buf_for_interval_retrieve[8192];
-    size_t                                   _cached_scan_node_hq_count_for_interval_retrieve;
+    // each subscriber follows the published sequence numbers with its own cursor,
+    // the cache thread only signals the events of the active ones
+    struct ScanSubscriber {
+        volatile _u32   active;
+        _u32            cursor;     // sequence of the last scan handed out, owned by the subscriber
+        rp::hal::Event  dataEvt;
+    };
+    ScanSubscriber                           _scan_subscribers[MAX_SCAN_SUBSCRIBERS];
+
+    // nodes for getScanDataWithInterval
+    RplidarNodeRing                          _interval_ring;
+
+    // the latest points received, searchable by time
+    RplidarPointHistory                      _point_history;
+
+    // The scan pool, the interval ring and the history share one allocation sized
+    // at scan start (see _setupScanArena). Readers take _scan_reader_lock while they
+    // touch them, which keeps a single consumer on the interval ring and lets the
+    // arena be swapped while the cache thread is stopped. The cache thread never takes it.
+    _u8 *                                    _scan_arena;
+    size_t                                   _scan_arena_size;
+    float                                    _min_scan_frequency;
+    _u32                                     _scan_arrays;      // RplidarScanPool::ARRAY_xxx enabled from the next scan start
+    cartesian::Transform                     _sensor_pose;
+    volatile _u32                            _truncated_scan_count;
+    rp::hal::Locker                          _scan_reader_lock;
 
     _u16                    _cached_sampleduration_std;
     _u16                    _cached_sampleduration_express;
     _u8                     _cached_express_flag;
+    float                   _cached_scan_us_per_sample;     // of the scan mode running, used to time the samples
 
     rplidar_response_capsule_measurement_nodes_t _cached_previous_capsuledata;
     rplidar_response_dense_capsule_measurement_nodes_t _cached_previous_dense_capsuledata;
@@ -120,6 +211,44 @@ protected:
     bool                                         _is_previous_capsuledataRdy;
     bool                                         _is_previous_HqdataRdy;
 
+    enum {
+        RX_STREAM_BUFFER_SIZE = 4096,
+        CACHE_THREAD_JOIN_TIMEOUT = 500,    // ms, for a cache thread already woken out of its wait
+    };
+
+    _u8                     _rxbuf[RX_STREAM_BUFFER_SIZE];
+    size_t                  _rxbuf_pos;         // first byte not consumed by the parser yet
+    size_t                  _rxbuf_end;         // one past the last byte received
+    _u32                    _rx_resync_count;   // times the parser dropped bytes to find a frame again
+    _u32                    _rx_loss_count;     // losses of the channel already seen
+    bool                    _rx_gap;            // the channel lost data ahead of the bytes buffered last
+    size_t                  _serial_ring_size;  // of the reader thread ring, from the next connection
+    RplidarTcpOptions       _tcp_options;       // from the next connection
+    RplidarRealtimeProfile  _rt_profile;        // from the next scan
+    volatile _u32           _rt_applied;        // RT_PROFILE_xxx, but RT_PROFILE_STACK
+
+    // frame latency of the cache thread, only written by it.
+    // _rt_stats_seq is odd while it updates them, getRealtimeStats retries until it reads an even, unchanged value.
+    volatile _u32           _rt_stats_seq;
+    volatile bool           _rt_stack_prefaulted;
+    volatile _u32           _rt_frame_count;
+    volatile _u64           _rt_latency_sum;
+    volatile _u32           _rt_latency_min;
+    volatile _u32           _rt_latency_max;
+    volatile _u32           _rt_over_100us_count;
+    volatile _u32           _rt_over_1ms_count;
+
+    // link telemetry, plain counters only written by the thread reading the channel
+    _u32                    _link_received_size;
+    _u32                    _link_read_count;
+    _u32                    _link_frame_count[LINK_FRAME_TYPE_COUNT];
+    _u32                    _link_discarded_size;
+    _u32                    _link_checksum_error_count;
+    _u32                    _link_baudrate;         // 0 over TCP and UDP
+    RplidarLinkStats        _link_previous;         // returned by the previous getLinkStats, for the rates
+    _u64                    _link_previous_ts;
+    rp::hal::Locker         _link_stats_lock;
+
 	
 
     rp::hal::Locker         _lock;
@@ -128,6 +257,6 @@ protected:
 
 protected:
     RPlidarDriverImplCommon();
-    virtual ~RPlidarDriverImplCommon() {}
+    virtual ~RPlidarDriverImplCommon();
 };
 }}}
\ No newline at end of file
@@ -36,37 +36,92 @@
 
 namespace rp { namespace standalone{ namespace rplidar {
 
+// Reads the serial port either on demand from the thread calling waitfordata/recvdata,
+// or, when a reader ring size is set, from a dedicated thread that drains the port into
+// a RplidarByteRing as soon as data comes in. The caller then only reads from the ring.
 class SerialChannelDevice :public ChannelDevice
 {
 public:
+    enum {
+        READER_WAIT_TIMEOUT = 100,  // ms, the reader thread is woken up by cancelOperation anyway
+        READER_ERROR_DELAY = 10,    // ms between two attempts when the port fails
+    };
+
     rp::hal::serial_rxtx  * _rxtxSerial;
     bool _closePending;
+    volatile bool _waitCancelled;
+
+    SerialChannelDevice()
+        : _rxtxSerial(rp::hal::serial_rxtx::CreateRxTx())
+        , _closePending(false)
+        , _waitCancelled(false)
+        , _reader_ring_size(0)
+        , _reader_storage(NULL)
+        , _reader_stop(false)
+        , _reader_running(0)
+        , _rx_wanted(0)
+    {}
 
-    SerialChannelDevice():_rxtxSerial(rp::hal::serial_rxtx::CreateRxTx()){}
+    // ring size of the reader thread started by the next open(), 0 reads the port on demand
+    void setReaderRingSize(size_t size)
+    {
+        _reader_ring_size = size;
+    }
 
     bool bind(const char * portname, uint32_t baudrate)
+    {
+        return bind(portname, baudrate, 0);
+    }
+    bool bind(const char * portname, uint32_t baudrate, uint32_t flags)
     {
         _closePending = false;
-        return _rxtxSerial->bind(portname, baudrate);
+        return _rxtxSerial->bind(portname, baudrate, flags);
     }
     bool open()
     {
-        return _rxtxSerial->open();
+        if (!_rxtxSerial->open()) return false;
+        // without the reader thread the port is still read on demand
+        if (_reader_ring_size && !_reader_storage) _startReader();
+        return true;
     }
     void close()
     {
         _closePending = true;
+        _stopReader();
         _rxtxSerial->cancelOperation();
         _rxtxSerial->close();
     }
     void flush()
     {
         _rxtxSerial->flush(0);
+        if (_reader_storage) _rx_ring.discard();
     }
     bool waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL)
     {
-        if (_closePending) return false;
-        return (_rxtxSerial->waitfordata(data_count, timeout, returned_size) == rp::hal::serial_rxtx::ANS_OK);
+        return waitfordataUntil(data_count, deadlineAfter(timeout), returned_size);
+    }
+    bool waitfordataUntil(size_t data_count, _u64 deadline_us, size_t * returned_size = NULL)
+    {
+        if (_closePending || _waitCancelled) return false;
+        if (_reader_storage) return _waitRing(data_count, deadline_us, returned_size);
+        return (_rxtxSerial->waitfordataUntil(data_count, deadline_us, returned_size) == rp::hal::serial_rxtx::ANS_OK);
+    }
+    bool canCancelWait()
+    {
+        // the ring event wakes the consumer whatever the port
+        return _reader_storage || _rxtxSerial->canCancelOperation();
+    }
+    void cancelWait()
+    {
+        _waitCancelled = true;
+        // the reader thread keeps reading the port, only the consumer is woken
+        if (_reader_storage) _rx_event.set();
+        else _rxtxSerial->cancelOperation();
+    }
+    void resumeWait()
+    {
+        _waitCancelled = false;
+        if (!_reader_storage) _rxtxSerial->resumeOperation();
     }
     int senddata(const _u8 * data, size_t size)
     {
@@ -75,6 +130,7 @@ public:
     int recvdata(unsigned char * data, size_t size)
     {
         size_t lenRec = 0;
+        if (_reader_storage) return (int)_rx_ring.read(data, size);
         lenRec = _rxtxSerial->recvdata(data, size);
         return lenRec;
     }
@@ -90,6 +146,51 @@ public:
     {
         rp::hal::serial_rxtx::ReleaseRxTx(_rxtxSerial);
     }
+    _u32 getLowLatencyStatus()
+    {
+        return _rxtxSerial->getLowLatencyStatus();
+    }
+    bool getArrivalTimestamp(size_t bytesAfter, _u64 & ts)
+    {
+        if (!_reader_storage) return false;
+        return _rx_ring.getArrivalTimestamp(bytesAfter, ts);
+    }
+    bool getRingStats(RplidarSerialRingStats & stats)
+    {
+        if (!_reader_storage) return false;
+        _rx_ring.getStats(stats);
+        return true;
+    }
+    bool getLossCount(_u32 & count)
+    {
+        // bytes the reader thread dropped with the ring full
+        if (!_reader_storage) return false;
+        count = _rx_ring.getLostSize();
+        return true;
+    }
+    bool getReadCount(_u32 & count)
+    {
+        // the reads from the port are done by the reader thread, one per chunk
+        RplidarSerialRingStats stats;
+        if (!getRingStats(stats)) return false;
+        count = stats.chunk_count;
+        return true;
+    }
+
+protected:
+    bool     _startReader();
+    void     _stopReader();
+    u_result _readerProc();
+    bool     _waitRing(size_t data_count, _u64 deadline_us, size_t * returned_size);
+
+    size_t           _reader_ring_size;
+    _u8 *            _reader_storage;   // set while the reader thread runs, only changed by open/close
+    volatile bool    _reader_stop;
+    volatile _u32    _reader_running;
+    volatile _u32    _rx_wanted;        // bytes the consumer waits for
+    RplidarByteRing  _rx_ring;
+    rp::hal::Event   _rx_event;
+    rp::hal::Thread  _reader_thread;
 };
 
 class RPlidarDriverSerial : public RPlidarDriverImplCommon
@@ -0,0 +1,114 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "hal/atomic.h"
+#include "rplidar_node_ring.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+RplidarNodeRing::RplidarNodeRing()
+    : _nodes(NULL)
+    , _capacity(0)
+    , _head(0)
+    , _tail(0)
+    , _pushed_count(0)
+    , _dropped_count(0)
+    , _overflow_count(0)
+{
+}
+
+void RplidarNodeRing::attach(void * storage, size_t capacity)
+{
+    _nodes = (rplidar_response_measurement_node_hq_t *)storage;
+    _capacity = storage ? (_u32)capacity : 0;
+    rp::hal::atomic_store(&_tail, _head);
+}
+
+size_t RplidarNodeRing::push(const rplidar_response_measurement_node_hq_t * nodes, size_t count)
+{
+    _u32 head = _head;
+    size_t space = _capacity - (head - rp::hal::atomic_load(&_tail));
+
+    if (count > space) {
+        rp::hal::atomic_store(&_dropped_count, _dropped_count + (_u32)(count - space));
+        rp::hal::atomic_store(&_overflow_count, _overflow_count + 1);
+        count = space;
+    }
+    if (!count) return 0;
+
+    size_t offset = head & (_capacity - 1);
+    size_t firstPart = std::min((size_t)_capacity - offset, count);
+    memcpy(_nodes + offset, nodes, firstPart * sizeof(rplidar_response_measurement_node_hq_t));
+    memcpy(_nodes, nodes + firstPart, (count - firstPart) * sizeof(rplidar_response_measurement_node_hq_t));
+
+    // publishing the new head also publishes the nodes written before it
+    rp::hal::atomic_store(&_head, head + (_u32)count);
+    rp::hal::atomic_store(&_pushed_count, _pushed_count + (_u32)count);
+    return count;
+}
+
+size_t RplidarNodeRing::drain(rplidar_response_measurement_node_hq_t * nodebuffer, size_t capacity)
+{
+    _u32 tail = _tail;
+    size_t count = std::min((size_t)(rp::hal::atomic_load(&_head) - tail), capacity);
+    if (!count) return 0;
+
+    size_t offset = tail & (_capacity - 1);
+    size_t firstPart = std::min((size_t)_capacity - offset, count);
+    memcpy(nodebuffer, _nodes + offset, firstPart * sizeof(rplidar_response_measurement_node_hq_t));
+    memcpy(nodebuffer + firstPart, _nodes, (count - firstPart) * sizeof(rplidar_response_measurement_node_hq_t));
+
+    rp::hal::atomic_store(&_tail, tail + (_u32)count);
+    return count;
+}
+
+size_t RplidarNodeRing::pending() const
+{
+    return rp::hal::atomic_load(&_head) - rp::hal::atomic_load(&_tail);
+}
+
+void RplidarNodeRing::getStats(RplidarIntervalBufferStats & stats) const
+{
+    stats.capacity = _capacity;
+    stats.pending_count = (_u32)pending();
+    stats.pushed_count = rp::hal::atomic_load(&_pushed_count);
+    stats.dropped_count = rp::hal::atomic_load(&_dropped_count);
+    stats.overflow_count = rp::hal::atomic_load(&_overflow_count);
+}
+
+}}}
@@ -0,0 +1,79 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Wait-free single producer / single consumer ring of measurement nodes.
+//
+// The cache thread appends whole capsules with push(), a reader takes them out
+// with drain(). Each side only writes its own index, so neither of them ever
+// blocks the other. When the ring is full the newest nodes are dropped and
+// accounted for, the ones not read yet are never overwritten.
+//
+// The nodes live in storage provided by the driver.
+class RplidarNodeRing
+{
+public:
+    RplidarNodeRing();
+
+    // bytes of storage needed for capacity nodes, capacity must be a power of 2
+    static size_t getStorageSize(size_t capacity) { return capacity * sizeof(rplidar_response_measurement_node_hq_t); }
+    // only allowed while neither side runs, NULL detaches. Nodes not read yet are lost.
+    void attach(void * storage, size_t capacity);
+    size_t getCapacity() const { return _capacity; }
+
+    // producer side, returns the number of nodes actually stored
+    size_t push(const rplidar_response_measurement_node_hq_t * nodes, size_t count);
+
+    // consumer side, returns the number of nodes copied to nodebuffer
+    size_t drain(rplidar_response_measurement_node_hq_t * nodebuffer, size_t capacity);
+    size_t pending() const;
+
+    void getStats(RplidarIntervalBufferStats & stats) const;
+
+private:
+    rplidar_response_measurement_node_hq_t * _nodes;
+    _u32          _capacity;
+
+    // free running indexes, only their low bits address _nodes
+    volatile _u32 _head;    // written by the producer
+    volatile _u32 _tail;    // written by the consumer
+
+    volatile _u32 _pushed_count;
+    volatile _u32 _dropped_count;
+    volatile _u32 _overflow_count;
+};
+
+}}}
@@ -0,0 +1,166 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "hal/atomic.h"
+#include "rplidar_point_history.h"
+
+#include <string.h>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+RplidarPointHistory::RplidarPointHistory()
+    : _timestamps(NULL)
+    , _nodes(NULL)
+    , _capacity(0)
+    , _readerGuard(0)
+    , _head(0)
+    , _full(0)
+{
+}
+
+void RplidarPointHistory::attach(void * storage, size_t capacity)
+{
+    _timestamps = (_u64 *)storage;
+    _nodes = storage ? (rplidar_response_measurement_node_hq_t *)(_timestamps + capacity) : NULL;
+    _capacity = storage ? (_u32)capacity : 0;
+    _readerGuard = _capacity / 8;
+    _head = 0;
+    _full = 0;
+}
+
+void RplidarPointHistory::push(const rplidar_response_measurement_node_hq_t * nodes, const _u64 * timestamps, size_t count)
+{
+    while (count) {
+        _u32 head = _head;
+        size_t batch = count < (size_t)WRITE_MARGIN ? count : (size_t)WRITE_MARGIN;
+
+        for (size_t pos = 0; pos < batch; ++pos) {
+            _u32 index = (head + (_u32)pos) & (_capacity - 1);
+            _nodes[index] = nodes[pos];
+            _timestamps[index] = timestamps[pos];
+        }
+
+        if (!_full && head + batch >= _capacity) {
+            rp::hal::atomic_store(&_full, 1);
+        }
+        rp::hal::atomic_store(&_head, head + (_u32)batch);
+
+        nodes += batch;
+        timestamps += batch;
+        count -= batch;
+    }
+}
+
+_u32 RplidarPointHistory::_windowFirst(_u32 head, _u32 guard) const
+{
+    if (!rp::hal::atomic_load(&_full) && head <= _capacity - guard) return 0;
+    return head - _capacity + guard;
+}
+
+_u32 RplidarPointHistory::_searchTimestamp(_u32 first, _u32 end, _u64 ts, bool upper) const
+{
+    // binary search on the offsets from first, the indexes themselves wrap around
+    _u32 low = 0, high = end - first;
+    while (low < high) {
+        _u32 mid = low + (high - low) / 2;
+        _u64 midTs = _timestamps[(first + mid) & (_capacity - 1)];
+        if (upper ? (midTs <= ts) : (midTs < ts)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return first + low;
+}
+
+size_t RplidarPointHistory::_copyOut(_u32 first, _u32 end, rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps) const
+{
+    size_t count = end - first;
+    for (size_t pos = 0; pos < count; ++pos) {
+        _u32 index = (first + (_u32)pos) & (_capacity - 1);
+        nodebuffer[pos] = _nodes[index];
+        if (timestamps) timestamps[pos] = _timestamps[index];
+    }
+
+    // the cache thread may have wrapped around onto the oldest points during the copy
+    _u32 validFirst = _windowFirst(rp::hal::atomic_load(&_head), WRITE_MARGIN);
+    _u32 dropped = validFirst - first;
+    if ((_s32)dropped <= 0) return count;
+    if (dropped >= count) return 0;
+
+    count -= dropped;
+    memmove(nodebuffer, nodebuffer + dropped, count * sizeof(rplidar_response_measurement_node_hq_t));
+    if (timestamps) memmove(timestamps, timestamps + dropped, count * sizeof(_u64));
+    return count;
+}
+
+size_t RplidarPointHistory::queryTimeRange(_u64 startTs, _u64 endTs, rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps, size_t capacity) const
+{
+    if (!_capacity) return 0;
+    _u32 head = rp::hal::atomic_load(&_head);
+    _u32 first = _windowFirst(head, _readerGuard);
+
+    _u32 rangeFirst = _searchTimestamp(first, head, startTs, false);
+    _u32 rangeEnd = _searchTimestamp(rangeFirst, head, endTs, true);
+    if (rangeEnd - rangeFirst > capacity) rangeFirst = rangeEnd - (_u32)capacity;
+
+    return _copyOut(rangeFirst, rangeEnd, nodebuffer, timestamps);
+}
+
+size_t RplidarPointHistory::queryLatestRevolution(rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps, size_t capacity) const
+{
+    if (!_capacity) return 0;
+    _u32 head = rp::hal::atomic_load(&_head);
+    _u32 first = _windowFirst(head, _readerGuard);
+    if (head == first) return 0;
+
+    // walk back from the latest point until the angle covered reaches a full turn (65536 in q14),
+    // small backward steps caused by the angle jitter count as negative
+    _s32 covered = 0;
+    _u32 revolutionFirst = head - 1;
+    while (revolutionFirst != first) {
+        _u16 newer = _nodes[revolutionFirst & (_capacity - 1)].angle_z_q14;
+        _u16 older = _nodes[(revolutionFirst - 1) & (_capacity - 1)].angle_z_q14;
+        covered += (_s16)(_u16)(newer - older);
+        if (covered >= 65536) break;
+        --revolutionFirst;
+    }
+    if (covered < 65536) return 0;
+
+    if (head - revolutionFirst > capacity) revolutionFirst = head - (_u32)capacity;
+    return _copyOut(revolutionFirst, head, nodebuffer, timestamps);
+}
+
+}}}
@@ -0,0 +1,93 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Time-indexed history of the latest decoded points, across revolutions.
+//
+// The cache thread appends every capsule with push() and never waits: the
+// oldest points are simply overwritten. Readers search and copy the points
+// they need, then check the cache thread did not overwrite them in the
+// meantime, dropping the ones it did (they were the oldest ones anyway).
+//
+// The points live in storage provided by the driver.
+class RplidarPointHistory
+{
+public:
+    enum {
+        MIN_CAPACITY = 4096,
+        MAX_CAPACITY = 65536,   // 2 seconds at the fastest sample rate (32k/s)
+    };
+
+    RplidarPointHistory();
+
+    // bytes of storage needed for capacity points, capacity must be a power of 2 within the bounds above
+    static size_t getStorageSize(size_t capacity) { return capacity * (sizeof(_u64) + sizeof(rplidar_response_measurement_node_hq_t)); }
+    // only allowed while neither side runs, NULL detaches. The points already stored are lost.
+    void attach(void * storage, size_t capacity);
+    size_t getCapacity() const { return _capacity; }
+
+    // producer side, the timestamps must not go backward
+    void push(const rplidar_response_measurement_node_hq_t * nodes, const _u64 * timestamps, size_t count);
+
+    // reader side, both return the number of points copied (the most recent ones if more than capacity match)
+    // points with startTs <= timestamp <= endTs
+    size_t queryTimeRange(_u64 startTs, _u64 endTs, rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps, size_t capacity) const;
+    // the points covering the last 360 degree, 0 if the history does not hold a full turn yet
+    size_t queryLatestRevolution(rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps, size_t capacity) const;
+
+private:
+    enum {
+        // max points written before _head is published, push() splits larger batches
+        WRITE_MARGIN = 256,
+    };
+
+    // first point of the readable window for a given _head
+    _u32 _windowFirst(_u32 head, _u32 guard) const;
+
+    // index of the first point in [first, end) whose timestamp is > ts (upper) or >= ts (lower)
+    _u32 _searchTimestamp(_u32 first, _u32 end, _u64 ts, bool upper) const;
+    // copies [first, end) and drops the points overwritten meanwhile, returns the number of points kept
+    size_t _copyOut(_u32 first, _u32 end, rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamps) const;
+
+    _u64 *                                 _timestamps;
+    rplidar_response_measurement_node_hq_t * _nodes;
+    _u32                                   _capacity;
+    _u32                                   _readerGuard;  // points this close to being overwritten are not considered by the readers
+    volatile _u32                          _head;   // free running count of points pushed
+    volatile _u32                          _full;   // set once the oldest points started to be overwritten
+};
+
+}}}
@@ -0,0 +1,298 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "hal/atomic.h"
+#include "rplidar_cartesian.h"
+#include "rplidar_scan_pool.h"
+#include "rplidar_capsule_decode.h"
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+RplidarScanPool::RplidarScanPool()
+    : _maxNodes(0)
+    , _arrays(0)
+    , _writing(0)
+    , _latest(SLOT_NONE)
+    , _published(0)
+    , _sequence(0)
+    , _dropped(0)
+{
+    cartesian::makeIdentity(_transform);
+    attach(NULL, 0, 0);
+}
+
+// nodes held by each optional array, a whole number of SIMD registers
+static inline size_t _getSoALength(size_t maxNodes)
+{
+    return (maxNodes + RplidarScanPool::SOA_ALIGNMENT - 1) & ~(size_t)(RplidarScanPool::SOA_ALIGNMENT - 1);
+}
+
+// the optional arrays go first, then the 64-bit ones, so that every array of every slot stays aligned
+static inline size_t _getSlotStride(size_t maxNodes, _u32 arrays)
+{
+    size_t stride = maxNodes * (sizeof(_u64) + sizeof(rplidar_response_measurement_node_hq_t) + sizeof(_u32));
+    if (!arrays) {
+        return (stride + sizeof(_u64) - 1) & ~(sizeof(_u64) - 1);
+    }
+    if (arrays & RplidarScanPool::ARRAY_SOA) stride += _getSoALength(maxNodes) * (2 * sizeof(float) + 2 * sizeof(_u8));
+    if (arrays & RplidarScanPool::ARRAY_CARTESIAN) stride += _getSoALength(maxNodes) * 2 * sizeof(float);
+    return (stride + RplidarScanPool::SOA_ALIGNMENT - 1) & ~(size_t)(RplidarScanPool::SOA_ALIGNMENT - 1);
+}
+
+size_t RplidarScanPool::getStorageSize(size_t maxNodes, _u32 arrays)
+{
+    return SLOT_COUNT * _getSlotStride(maxNodes, arrays);
+}
+
+void RplidarScanPool::attach(void * storage, size_t maxNodes, _u32 arrays)
+{
+    _u8 * buffer = (_u8 *)storage;
+    size_t stride = _getSlotStride(maxNodes, arrays);
+    size_t soaLength = _getSoALength(maxNodes);
+
+    _maxNodes = storage ? maxNodes : 0;
+    _arrays = storage ? arrays : 0;
+    for (_u32 pos = 0; pos < HISTORY_DEPTH; ++pos) {
+        _history[pos] = SLOT_NONE;
+    }
+    for (_u32 pos = 0; pos < SLOT_COUNT; ++pos) {
+        Slot & slot = _slots[pos];
+        slot.angles = NULL;
+        slot.distances = NULL;
+        slot.qualities = NULL;
+        slot.flags = NULL;
+        slot.xs = NULL;
+        slot.ys = NULL;
+        if (buffer) {
+            _u8 * slotBuffer = buffer + pos * stride;
+            if (_arrays & ARRAY_CARTESIAN) {
+                slot.xs = (float *)slotBuffer;
+                slot.ys = slot.xs + soaLength;
+                slotBuffer = (_u8 *)(slot.ys + soaLength);
+            }
+            if (_arrays & ARRAY_SOA) {
+                slot.angles = (float *)slotBuffer;
+                slot.distances = slot.angles + soaLength;
+                slot.qualities = (_u8 *)(slot.distances + soaLength);
+                slot.flags = slot.qualities + soaLength;
+                slotBuffer = slot.flags + soaLength;
+            }
+            slot.deviceTs = (_u64 *)slotBuffer;
+            slot.nodes = (rplidar_response_measurement_node_hq_t *)(slot.deviceTs + maxNodes);
+            slot.hostOffsets = (_u32 *)(slot.nodes + maxNodes);
+        } else {
+            slot.deviceTs = NULL;
+            slot.nodes = NULL;
+            slot.hostOffsets = NULL;
+        }
+        slot.count = 0;
+        slot.droppedNodes = 0;
+        slot.sequence = 0;
+        slot.startTs = 0;
+        slot.endTs = 0;
+        slot.refcount = 0;
+    }
+    _writing = 0;
+    _slots[_writing].refcount = REF_WRITER;
+    rp::hal::atomic_store(&_latest, SLOT_NONE);
+}
+
+void RplidarScanPool::writeArrays(size_t begin, size_t end)
+{
+    Slot & current = _slots[_writing];
+    if (!_arrays || begin >= end) return;
+    if (current.angles) {
+        capsule_decoder::unpack(current.nodes + begin, end - begin, current.angles + begin,
+            current.distances + begin, current.qualities + begin, current.flags + begin);
+    }
+    if (current.xs) {
+        cartesian::convert(current.nodes + begin, end - begin, _transform, current.xs + begin, current.ys + begin);
+    }
+}
+
+bool RplidarScanPool::isLeased() const
+{
+    for (_u32 pos = 0; pos < SLOT_COUNT; ++pos) {
+        // references held by the pool itself
+        _u32 ownRefs = (pos == _writing) ? (_u32)REF_WRITER : 0;
+        for (_u32 depth = 0; depth < HISTORY_DEPTH; ++depth) {
+            if (rp::hal::atomic_load(&_history[depth]) == pos) ++ownRefs;
+        }
+        _u32 latest = rp::hal::atomic_load(&_latest);
+        if (latest != SLOT_NONE && (latest & LATEST_SLOT_MASK) == pos) ++ownRefs;
+
+        if (rp::hal::atomic_load(&_slots[pos].refcount) != ownRefs) return true;
+    }
+    return false;
+}
+
+rplidar_response_measurement_node_hq_t * RplidarScanPool::publish(size_t count, size_t droppedNodes, _u64 startTs, _u64 endTs)
+{
+    Slot & current = _slots[_writing];
+    current.count = count;
+    current.droppedNodes = droppedNodes;
+    current.sequence = ++_sequence;
+    current.startTs = startTs;
+    current.endTs = endTs;
+
+    _u32 next = _writing;
+    for (_u32 pos = 1; pos < SLOT_COUNT; ++pos) {
+        _u32 candidate = (_writing + pos) % SLOT_COUNT;
+        if (rp::hal::atomic_compare_exchange(&_slots[candidate].refcount, 0, REF_WRITER)) {
+            next = candidate;
+            break;
+        }
+    }
+
+    if (next == _writing) {
+        // every other slot is leased out, overwrite this revolution
+        ++_dropped;
+        return current.nodes;
+    }
+
+    // the writer reference becomes the references held by the history and _latest
+    rp::hal::atomic_fetch_add(&current.refcount, 2 - (_u32)REF_WRITER);
+
+    _u32 previous = rp::hal::atomic_exchange(&_history[(_u32)current.sequence % HISTORY_DEPTH], _writing);
+    if (previous != SLOT_NONE) {
+        release(previous);
+    }
+    rp::hal::atomic_store(&_published, (_u32)current.sequence);
+
+    previous = rp::hal::atomic_exchange(&_latest, _writing | LATEST_FRESH);
+    if (previous != SLOT_NONE) {
+        release(previous & LATEST_SLOT_MASK);
+    }
+
+    _writing = next;
+    return _slots[_writing].nodes;
+}
+
+bool RplidarScanPool::acquireLatest(RplidarScanLease & lease)
+{
+    for (;;) {
+        _u32 latest = rp::hal::atomic_load(&_latest);
+        if (!(latest & LATEST_FRESH)) return false;
+
+        _u32 slot = latest & LATEST_SLOT_MASK;
+        _u32 previousRef = rp::hal::atomic_fetch_add(&_slots[slot].refcount, 1);
+        if (previousRef == 0 || (previousRef & REF_WRITER)) {
+            // the slot was recycled since _latest was read
+            release(slot);
+            continue;
+        }
+
+        // a newer revolution or another reader may have come in between
+        if (!rp::hal::atomic_compare_exchange(&_latest, latest, slot)) {
+            release(slot);
+            continue;
+        }
+
+        _fillLease(slot, lease);
+        return true;
+    }
+}
+
+_u32 RplidarScanPool::getPublishedSequence() const
+{
+    return rp::hal::atomic_load(&_published);
+}
+
+bool RplidarScanPool::acquireSequence(_u32 sequence, RplidarScanLease & lease)
+{
+    _u32 slot = rp::hal::atomic_load(&_history[sequence % HISTORY_DEPTH]);
+    if (slot == SLOT_NONE) return false;
+
+    _u32 previousRef = rp::hal::atomic_fetch_add(&_slots[slot].refcount, 1);
+    if (previousRef == 0 || (previousRef & REF_WRITER)) {
+        release(slot);
+        return false;
+    }
+
+    // the slot cannot be recycled while referenced, its sequence is stable now
+    if ((_u32)_slots[slot].sequence != sequence) {
+        release(slot);
+        return false;
+    }
+
+    _fillLease(slot, lease);
+    return true;
+}
+
+void RplidarScanPool::_fillLease(_u32 slot, RplidarScanLease & lease)
+{
+    const Slot & leased = _slots[slot];
+    lease._pool = this;
+    lease._slot = slot;
+    lease._nodes = leased.nodes;
+    lease._hostOffsets = leased.hostOffsets;
+    lease._deviceTs = leased.deviceTs;
+    lease._angles = leased.angles;
+    lease._distances = leased.distances;
+    lease._qualities = leased.qualities;
+    lease._flags = leased.flags;
+    lease._xs = leased.xs;
+    lease._ys = leased.ys;
+    lease._count = leased.count;
+    lease._droppedNodes = leased.droppedNodes;
+    lease._sequence = leased.sequence;
+    lease._startTs = leased.startTs;
+    lease._endTs = leased.endTs;
+}
+
+void RplidarScanPool::release(_u32 slot)
+{
+    rp::hal::atomic_fetch_add(&_slots[slot].refcount, (_u32)-1);
+}
+
+void RplidarScanLease::release()
+{
+    if (!_pool) return;
+    _pool->release(_slot);
+    _pool = NULL;
+    _nodes = NULL;
+    _hostOffsets = NULL;
+    _deviceTs = NULL;
+    _angles = NULL;
+    _distances = NULL;
+    _qualities = NULL;
+    _flags = NULL;
+    _xs = NULL;
+    _ys = NULL;
+    _count = 0;
+    _droppedNodes = 0;
+}
+
+}}}
@@ -0,0 +1,141 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Pool of revolution buffers shared between the cache thread and the readers.
+//
+// The cache thread always owns one slot (flagged WRITER) and fills it; publishing
+// makes it the latest revolution and picks any other slot nobody references.
+// Readers lease a revolution by taking a reference on its slot. The pool itself
+// keeps one reference on the latest slot until a newer one replaces it, and one
+// on each of the last HISTORY_DEPTH revolutions so that subscribers reading at
+// their own pace can still find the ones published since their last read.
+// Nobody waits on the other side: when every slot is leased out, the revolution
+// being written is dropped and its buffer reused.
+//
+// The slots are carved out of storage provided by the driver, sized for the
+// longest revolution expected from the scan mode. Optionally each slot also
+// holds the revolution as separate angle, distance, quality and flag arrays
+// (ARRAY_SOA) and as x/y coordinates (ARRAY_CARTESIAN), filled by the cache
+// thread and aligned on SOA_ALIGNMENT bytes when the storage is.
+class RplidarScanPool
+{
+public:
+    enum {
+        HISTORY_DEPTH = 3,
+        SLOT_COUNT = 8,     // writer + history + up to 4 leases held at the same time
+        SOA_ALIGNMENT = 32,
+    };
+
+    enum {
+        ARRAY_SOA       = 0x1,
+        ARRAY_CARTESIAN = 0x2,
+    };
+
+    RplidarScanPool();
+
+    // bytes of storage needed for revolutions of up to maxNodes nodes
+    static size_t getStorageSize(size_t maxNodes, _u32 arrays);
+    // (re)build the slots on top of storage, NULL to detach. Only allowed while the
+    // cache thread is stopped and nothing is leased, the sequence numbers carry on.
+    void attach(void * storage, size_t maxNodes, _u32 arrays);
+    size_t getMaxNodes() const { return _maxNodes; }
+    _u32 getArrays() const { return _arrays; }
+    // pose of the sensor for ARRAY_CARTESIAN, only while the cache thread is stopped
+    void setTransform(const cartesian::Transform & transform) { _transform = transform; }
+    // whether any reader holds a lease
+    bool isLeased() const;
+
+    // cache thread side
+    rplidar_response_measurement_node_hq_t * writeBuffer() { return _slots[_writing].nodes; }
+    _u32 * writeHostOffsets() { return _slots[_writing].hostOffsets; }
+    _u64 * writeDeviceTimestamps() { return _slots[_writing].deviceTs; }
+    // fill the optional arrays of nodes [begin, end) from writeBuffer()
+    void writeArrays(size_t begin, size_t end);
+    // droppedNodes are the nodes of the revolution that did not fit
+    rplidar_response_measurement_node_hq_t * publish(size_t count, size_t droppedNodes, _u64 startTs, _u64 endTs);
+    _u32 getDroppedCount() const { return _dropped; }
+
+    // reader side, fails when the latest revolution was already leased or nothing was published yet
+    bool acquireLatest(RplidarScanLease & lease);
+    void release(_u32 slot);
+
+    // subscriber side, sequence numbers are compared on their low 32 bits
+    _u32 getPublishedSequence() const;
+    // fails when that revolution was dropped or already left the history
+    bool acquireSequence(_u32 sequence, RplidarScanLease & lease);
+
+private:
+    void _fillLease(_u32 slot, RplidarScanLease & lease);
+
+    enum {
+        REF_WRITER  = 0x80000000,
+        SLOT_NONE   = 0xFF,
+        LATEST_SLOT_MASK = 0xFF,
+        LATEST_FRESH = 0x100,      // set in _latest until a reader leases it
+    };
+
+    struct Slot {
+        rplidar_response_measurement_node_hq_t * nodes;
+        _u32 *        hostOffsets;     // host time of each node, from startTs
+        _u64 *        deviceTs;
+        float *       angles;          // optional arrays, NULL when disabled
+        float *       distances;
+        _u8 *         qualities;
+        _u8 *         flags;
+        float *       xs;
+        float *       ys;
+        size_t        count;
+        size_t        droppedNodes;
+        _u64          sequence;
+        _u64          startTs;
+        _u64          endTs;
+        volatile _u32 refcount;
+    };
+
+    Slot          _slots[SLOT_COUNT];
+    size_t        _maxNodes;
+    _u32          _arrays;
+    cartesian::Transform _transform;
+    _u32          _writing;     // owned by the cache thread
+    volatile _u32 _latest;
+    volatile _u32 _history[HISTORY_DEPTH];     // slot of each revolution, indexed by sequence
+    volatile _u32 _published;                   // sequence of the last revolution published
+    _u64          _sequence;
+    _u32          _dropped;
+};
+
+}}}